@@ -24,8 +24,22 @@ pub fn build(b: *std.Build) void {
         "Should the per function slang diagnostic text be automatically logged using std.log (default: only_for_null)",
     ) orelse .only_for_null;
 
+    const abi_test_iterations = b.option(
+        u32,
+        "abi_test_iterations",
+        "How many times the ABI test calls every vtable function with random arguments (default: 1000)",
+    ) orelse 1000;
+
+    const track_com_lifetimes = b.option(
+        bool,
+        "track_com_lifetimes",
+        "Track every reference the bindings hand out and report the objects still alive at `shutdown` (default: false)",
+    ) orelse false;
+
     const options = b.addOptions();
     options.addOption(LogDiagnostics, "log_diagnostics", log_diagnostics);
+    options.addOption(bool, "track_com_lifetimes", track_com_lifetimes);
+    options.addOption(u32, "abi_test_iterations", abi_test_iterations);
     mod.addOptions("options", options);
 
     // Dependencies
@@ -33,17 +47,290 @@ pub fn build(b: *std.Build) void {
         @tagName(target.result.os.tag),
         @tagName(target.result.cpu.arch),
     });
-    if (b.lazyDependency(slang_dep_name, .{})) |slang| {
+    const slang_dep = b.lazyDependency(slang_dep_name, .{});
+    if (slang_dep) |slang| {
         mod.addSystemIncludePath(slang.path("include"));
         mod.addLibraryPath(slang.path("lib"));
         mod.linkSystemLibrary("slang", .{});
     }
 
+    // Tools
+    const slangc = b.addExecutable(.{
+        .name = "slangc",
+        .root_module = b.createModule(.{
+            .target = target,
+            .optimize = optimize,
+            .root_source_file = b.path("tools/slangc.zig"),
+            .imports = &.{.{ .name = "slang", .module = mod }},
+        }),
+    });
+    b.installArtifact(slangc);
+
+    const run_slangc = b.addRunArtifact(slangc);
+    if (b.args) |args| run_slangc.addArgs(args);
+    const slangc_step = b.step("slangc", "Run the slangc front end");
+    slangc_step.dependOn(&run_slangc.step);
+
+    const bindgen = b.addExecutable(.{
+        .name = "bindgen",
+        .root_module = b.createModule(.{
+            .target = target,
+            .optimize = optimize,
+            .root_source_file = b.path("tools/bindgen.zig"),
+            .imports = &.{.{ .name = "slang", .module = mod }},
+        }),
+    });
+    b.installArtifact(bindgen);
+
+    const cache_server = b.addExecutable(.{
+        .name = "cache_server",
+        .root_module = b.createModule(.{
+            .target = target,
+            .optimize = optimize,
+            .root_source_file = b.path("tools/cache_server.zig"),
+            .imports = &.{.{ .name = "slang", .module = mod }},
+        }),
+    });
+    b.installArtifact(cache_server);
+
+    const run_cache_server = b.addRunArtifact(cache_server);
+    if (b.args) |args| run_cache_server.addArgs(args);
+    const cache_server_step = b.step("cache_server", "Run the reference remote compile cache server");
+    cache_server_step.dependOn(&run_cache_server.step);
+
+    const bench_sessions = b.addExecutable(.{
+        .name = "bench_sessions",
+        .root_module = b.createModule(.{
+            .target = target,
+            // Benchmarks are only meaningful with optimizations
+            .optimize = if (optimize == .Debug) .ReleaseFast else optimize,
+            .root_source_file = b.path("tools/bench_sessions.zig"),
+            .imports = &.{.{ .name = "slang", .module = mod }},
+        }),
+    });
+    b.installArtifact(bench_sessions);
+
+    const run_bench_sessions = b.addRunArtifact(bench_sessions);
+    if (b.args) |args| run_bench_sessions.addArgs(args);
+    const bench_sessions_step = b.step("bench_sessions", "Benchmark compile throughput over thread counts and global session sharing");
+    bench_sessions_step.dependOn(&run_bench_sessions.step);
+
+    const option_sweep = b.addExecutable(.{
+        .name = "option_sweep",
+        .root_module = b.createModule(.{
+            .target = target,
+            .optimize = if (optimize == .Debug) .ReleaseFast else optimize,
+            .root_source_file = b.path("tools/option_sweep.zig"),
+            .imports = &.{.{ .name = "slang", .module = mod }},
+        }),
+    });
+    b.installArtifact(option_sweep);
+
+    const run_option_sweep = b.addRunArtifact(option_sweep);
+    if (b.args) |args| run_option_sweep.addArgs(args);
+    const option_sweep_step = b.step("option_sweep", "Compare compile time and code size across compiler option combinations");
+    option_sweep_step.dependOn(&run_option_sweep.step);
+
+    // Lets the tools run straight from the build, like in `compileShader`. Only the tools get it,
+    // so executables of packages depending on this one don't point into this cache.
+    if (slang_dep) |slang| {
+        if (target.result.os.tag != .windows) {
+            for ([_]*std.Build.Step.Compile{ slangc, bindgen, cache_server, bench_sessions, option_sweep }) |tool| {
+                tool.root_module.addRPath(slang.path("lib"));
+            }
+        }
+    }
+
+    const test_bindings = addGenerateShaderBindings(b, bindgen, .{
+        .source = b.path("shaders/test.slang"),
+        .profile = "spirv_1_5",
+    });
+    const bindings_step = b.step("bindings", "Generate the Zig bindings of shaders/test.slang");
+    bindings_step.dependOn(&b.addInstallFile(test_bindings, "bindings/test.zig").step);
+
     // Tests
     const unit_tests = b.addTest(.{ .root_module = mod });
     unit_tests.root_module.addCSourceFile(.{ .file = b.path("src/abi_test.cpp") });
 
+    // The generator only emits names, so it runs on the host even when cross compiling
+    const abi_gen = b.addExecutable(.{
+        .name = "abi_gen",
+        .root_module = b.createModule(.{
+            .target = b.graph.host,
+            .root_source_file = b.path("src/abi_gen.zig"),
+        }),
+    });
+    abi_gen.root_module.addOptions("options", options);
+
+    const run_abi_gen = b.addRunArtifact(abi_gen);
+    const abi_check_source = run_abi_gen.addOutputFileArg("abi_check.cpp");
+    unit_tests.root_module.addCSourceFile(.{ .file = abi_check_source, .flags = &.{"-std=c++20"} });
+
+    // Two libraries exporting the same symbol with different results, loaded from memory by the
+    // test of `MemoryLibraryLoader`
+    if (target.result.os.tag == .linux) {
+        for ([_]u32{ 1, 2 }) |value| {
+            const library_options = b.addOptions();
+            library_options.addOption(u32, "value", value);
+            const library = b.addLibrary(.{
+                .name = b.fmt("test_library_{d}", .{value}),
+                .linkage = .dynamic,
+                .root_module = b.createModule(.{
+                    .target = target,
+                    .optimize = optimize,
+                    .root_source_file = b.path("src/testdata/shared_library.zig"),
+                }),
+            });
+            library.root_module.addOptions("options", library_options);
+            unit_tests.root_module.addAnonymousImport(b.fmt("test_library_{d}.so", .{value}), .{
+                .root_source_file = library.getEmittedBin(),
+            });
+        }
+    }
+
+    // Checks the layouts bindgen generates for a fixture against the reflection of slang
+    const bindgen_tests = b.addTest(.{ .root_module = b.createModule(.{
+        .target = target,
+        .optimize = optimize,
+        .root_source_file = b.path("tools/bindgen.zig"),
+        .imports = &.{.{ .name = "slang", .module = mod }},
+    }) });
+    bindgen_tests.root_module.addAnonymousImport("bindgen.slang", .{ .root_source_file = b.path("src/testdata/bindgen.slang") });
+    bindgen_tests.root_module.addAnonymousImport("bindgen_fixture", .{
+        .root_source_file = addGenerateShaderBindings(b, bindgen, .{
+            .source = b.path("src/testdata/bindgen.slang"),
+            .profile = "spirv_1_5",
+        }),
+    });
+
     const run_tests = b.addRunArtifact(unit_tests);
+    const run_bindgen_tests = b.addRunArtifact(bindgen_tests);
     const test_step = b.step("test", "Run tests");
     test_step.dependOn(&run_tests.step);
+    test_step.dependOn(&run_bindgen_tests.step);
+}
+
+pub const ShaderTarget = enum {
+    spirv,
+    hlsl,
+    glsl,
+    metal,
+    wgsl,
+    dxil,
+
+    fn extension(self: ShaderTarget) []const u8 {
+        return switch (self) {
+            .spirv => ".spv",
+            .hlsl => ".hlsl",
+            .glsl => ".glsl",
+            .metal => ".metal",
+            .wgsl => ".wgsl",
+            .dxil => ".dxil",
+        };
+    }
+};
+
+pub const ShaderEntryPoint = struct {
+    name: []const u8,
+    /// Needed for entry points without a `[shader(...)]` attribute
+    stage: ?[]const u8 = null,
+};
+
+pub const CompileShaderOptions = struct {
+    /// Has to have a `.slang` or `.hlsl` extension
+    source: std.Build.LazyPath,
+    target: ShaderTarget = .spirv,
+    profile: ?[]const u8 = null,
+    /// Defaults to every entry point with a `[shader(...)]` attribute
+    entry_points: []const ShaderEntryPoint = &.{},
+    include_paths: []const std.Build.LazyPath = &.{},
+    /// Either `NAME` or `NAME=VALUE`
+    defines: []const []const u8 = &.{},
+    /// Passed to the tool as is
+    extra_args: []const []const u8 = &.{},
+    /// Basename of the output file, defaults to the name of the source with the extension of
+    /// the target, or `.zig` for `generateShaderBindings`
+    output_name: ?[]const u8 = null,
+};
+
+/// Adds a step that compiles a shader with the slangc tool of this package, built for the host.
+/// The step is cached by the build system, every file the shader includes or imports is tracked
+/// through a depfile. Independent shaders compile in parallel.
+///
+/// ```zig
+/// const slang_zig = @import("slang_zig");
+/// const spirv = slang_zig.compileShader(b, .{ .source = b.path("shaders/sky.slang") });
+/// exe.root_module.addAnonymousImport("sky.spv", .{ .root_source_file = spirv });
+/// // then `@embedFile("sky.spv")` in the code of exe
+/// ```
+pub fn compileShader(b: *std.Build, options: CompileShaderOptions) std.Build.LazyPath {
+    const this_dep = b.dependencyFromBuildZig(@This(), .{
+        .target = b.graph.host,
+        .optimize = .ReleaseSafe,
+    });
+    return addCompileShader(b, this_dep.artifact("slangc"), options);
+}
+
+/// Like `compileShader`, but runs the given slangc artifact.
+pub fn addCompileShader(b: *std.Build, slangc: *std.Build.Step.Compile, options: CompileShaderOptions) std.Build.LazyPath {
+    const run = b.addRunArtifact(slangc);
+    run.setName(b.fmt("slangc {s}", .{options.source.getDisplayName()}));
+    addShaderArgs(run, options);
+
+    run.addArg("-depfile");
+    _ = run.addDepFileOutputArg("shader.d");
+    run.addArg("-o");
+    const output_name = options.output_name orelse b.fmt("{s}{s}", .{
+        std.fs.path.stem(options.source.getDisplayName()),
+        options.target.extension(),
+    });
+    return run.addOutputFileArg(output_name);
+}
+
+/// Adds a step that generates Zig declarations for the parameters of a shader with the bindgen
+/// tool of this package: an `extern struct` with explicit padding for every struct of uniform
+/// data, and the descriptor set and binding indices of every parameter. The layouts are the ones
+/// of `options.target`. Like `compileShader`, the step reruns when an imported file changes.
+///
+/// ```zig
+/// const bindings = slang_zig.generateShaderBindings(b, .{ .source = b.path("shaders/sky.slang") });
+/// exe.root_module.addAnonymousImport("sky_bindings", .{ .root_source_file = bindings });
+/// ```
+pub fn generateShaderBindings(b: *std.Build, options: CompileShaderOptions) std.Build.LazyPath {
+    const this_dep = b.dependencyFromBuildZig(@This(), .{
+        .target = b.graph.host,
+        .optimize = .ReleaseSafe,
+    });
+    return addGenerateShaderBindings(b, this_dep.artifact("bindgen"), options);
+}
+
+/// Like `generateShaderBindings`, but runs the given bindgen artifact.
+pub fn addGenerateShaderBindings(b: *std.Build, bindgen: *std.Build.Step.Compile, options: CompileShaderOptions) std.Build.LazyPath {
+    const run = b.addRunArtifact(bindgen);
+    run.setName(b.fmt("bindgen {s}", .{options.source.getDisplayName()}));
+    addShaderArgs(run, options);
+
+    run.addArg("-depfile");
+    _ = run.addDepFileOutputArg("bindings.d");
+    run.addArg("-o");
+    const output_name = options.output_name orelse b.fmt("{s}.zig", .{
+        std.fs.path.stem(options.source.getDisplayName()),
+    });
+    return run.addOutputFileArg(output_name);
+}
+
+fn addShaderArgs(run: *std.Build.Step.Run, options: CompileShaderOptions) void {
+    run.addFileArg(options.source);
+    run.addArgs(&.{ "-target", @tagName(options.target) });
+    if (options.profile) |profile| run.addArgs(&.{ "-profile", profile });
+    for (options.entry_points) |entry_point| {
+        run.addArgs(&.{ "-entry", entry_point.name });
+        if (entry_point.stage) |stage| run.addArgs(&.{ "-stage", stage });
+    }
+    for (options.include_paths) |path| {
+        run.addArg("-I");
+        run.addDirectoryArg(path);
+    }
+    for (options.defines) |define| run.addArgs(&.{ "-D", define });
+    run.addArgs(options.extra_args);
 }
@@ -45,7 +45,7 @@ fn compileAndReflectProgram(gpa: std.mem.Allocator, session: *slang.ISession, so
     printQuotedString(source_file_name);
 
     const source_file_path = resolveResource(source_file_name);
-    const module = session.loadModule(source_file_path, null) orelse return error.LoadModuleFailed;
+    var module = session.loadModule(source_file_path, null) orelse return error.LoadModuleFailed;
     defer module.release();
 
     var components_to_link: std.ArrayList(*slang.IComponentType) = .empty;
@@ -55,7 +55,7 @@ fn compileAndReflectProgram(gpa: std.mem.Allocator, session: *slang.ISession, so
     key("global constants");
 
     beginArray();
-    var childern = module.getModuleReflection().getChildern();
+    var childern = module.borrow().getModuleReflection().getChildern();
     while (childern.next()) |decl| {
         if (decl.asVariable()) |var_decl| {
             if (var_decl.findModifier(.@"const") and var_decl.findModifier(.static)) {
@@ -68,28 +68,28 @@ fn compileAndReflectProgram(gpa: std.mem.Allocator, session: *slang.ISession, so
 
     // Finding Entry Points
     key("defined entry points");
-    const defined_entry_point_count = module.getDefinedEntryPointCount();
+    const defined_entry_point_count = module.borrow().getDefinedEntryPointCount();
 
     beginArray();
     for (0..defined_entry_point_count) |i| {
-        const entry_point = try module.getDefinedEntryPoint(i);
+        var entry_point = try module.borrow().getDefinedEntryPoint(i);
         defer entry_point.release();
 
         element();
         beginObject();
         key("name");
-        printQuotedString(entry_point.getFunctionReflection().getName());
+        printQuotedString(entry_point.borrow().getFunctionReflection().getName());
         endObject();
 
-        try components_to_link.append(gpa, @ptrCast(entry_point));
+        try components_to_link.append(gpa, @ptrCast(entry_point.borrow()));
     }
     endArray();
 
     // Composing and Linking
-    const composed = try session.createCompositeComponentType(components_to_link.items, null);
+    var composed = try session.createCompositeComponentType(components_to_link.items, null);
     defer composed.release();
 
-    const program = try composed.link(null);
+    var program = try composed.borrow().link(null);
     defer program.release();
 
     key("layouts");
@@ -100,11 +100,11 @@ fn compileAndReflectProgram(gpa: std.mem.Allocator, session: *slang.ISession, so
         element();
 
         // Getting the Program Layout
-        const program_layout = program.getLayout(target_index, null) orelse {
+        const program_layout = program.borrow().getLayout(target_index, null) orelse {
             failed = true;
             continue;
         };
-        try collectEntryPointMetadata(program, target_index, defined_entry_point_count);
+        try collectEntryPointMetadata(program.borrow(), target_index, defined_entry_point_count);
         printProgramLayout(program_layout, target.format);
     }
     endArray();
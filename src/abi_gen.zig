@@ -0,0 +1,319 @@
+//! Generates a C++ translation unit that evaluates the sizes, field offsets and enum values from
+//! slang.h that the extern types in root.zig have to agree with. The values end up in the
+//! `slang_abi_values` array in the same order as `checks`, and the "struct layouts and enum
+//! values" test compares them with what the Zig compiler computes for the test target.
+//!
+//! Only names go into the generated file, so the generator can run on the host when cross
+//! compiling. The C++ names are derived from the Zig ones, with overrides for the places where
+//! slang.h is not consistent. Missing struct fields and scoped enum values are reported by the
+//! test instead of breaking the build. Flags that slang.h declares as global names can't be
+//! looked up that way, C++ has no lookup that falls back when a global name is missing, so a
+//! missing flag fails to compile the generated file.
+
+const std = @import("std");
+const slang = @import("root.zig");
+
+pub const Check = struct {
+    /// Zig side description used in failure messages
+    name: []const u8,
+    /// C++ expression that evaluates to `value` when the bindings match slang.h
+    cpp: []const u8,
+    value: i64,
+};
+
+/// What the C++ side reports when it can't find the name of a field or enum value
+pub const missing = std.math.minInt(i64);
+
+const Case = enum {
+    /// `compiler_option_entries` -> `compilerOptionEntries`
+    camel,
+    /// `entry_point_name` -> `EntryPointName`
+    pascal,
+    /// `ray_generation` -> `RAY_GENERATION`
+    upper,
+    /// Used as is
+    verbatim,
+};
+
+const Override = struct { []const u8, []const u8 };
+
+/// Words that slang.h spells in all caps when converting to camel or pascal case
+const acronyms = [_][]const u8{ "glsl", "hlsl", "json", "msvc" };
+
+const StructInfo = struct {
+    type: type,
+    cpp_name: []const u8,
+    overrides: []const Override = &.{},
+};
+
+const EnumInfo = struct {
+    type: type,
+    cpp_name: []const u8,
+    case: Case = .upper,
+    prefix: []const u8 = "",
+    overrides: []const Override = &.{},
+};
+
+const FlagsInfo = struct {
+    type: type,
+    /// The flags are looked up as members of this type if set, otherwise as global names, which
+    /// breaks the build instead of failing the test when one of them is missing
+    scope: ?[]const u8 = null,
+    case: Case = .upper,
+    prefix: []const u8 = "",
+};
+
+const structs = [_]StructInfo{
+    .{ .type = slang.UUID, .cpp_name = "SlangUUID" },
+    .{ .type = slang.CompilerOptionValue, .cpp_name = "slang::CompilerOptionValue" },
+    .{ .type = slang.CompilerOptionEntry, .cpp_name = "slang::CompilerOptionEntry" },
+    .{ .type = slang.TargetDesc, .cpp_name = "slang::TargetDesc" },
+    .{ .type = slang.PreprocessorMacroDesc, .cpp_name = "slang::PreprocessorMacroDesc" },
+    .{ .type = slang.SessionDescExtern, .cpp_name = "slang::SessionDesc", .overrides = &.{
+        .{ "preprpcessor_macros", "preprocessorMacros" },
+        .{ "compiler_options_entries", "compilerOptionEntries" },
+        .{ "skip_spirv_validation", "skipSPIRVValidation" },
+    } },
+    .{ .type = slang.SpecializationArg, .cpp_name = "slang::SpecializationArg", .overrides = &.{
+        // Anonymous union in C++
+        .{ "data", "type" },
+    } },
+    .{ .type = slang.GlobalSessionDesc, .cpp_name = "SlangGlobalSessionDesc" },
+};
+
+const enums = [_]EnumInfo{
+    .{ .type = slang.Severity, .cpp_name = "SlangSeverity", .prefix = "SLANG_SEVERITY_" },
+    .{ .type = slang.BindableResourceType, .cpp_name = "SlangBindableResourceType", .prefix = "SLANG_" },
+    .{ .type = slang.CompileTarget, .cpp_name = "SlangCompileTarget", .prefix = "SLANG_", .overrides = &.{
+        .{ "unknown", "SLANG_TARGET_UNKNOWN" },
+        .{ "none", "SLANG_TARGET_NONE" },
+        .{ "cpp_pytorch_bindings", "SLANG_CPP_PYTORCH_BINDING" },
+    } },
+    .{ .type = slang.ContainerFormat, .cpp_name = "SlangContainerFormat", .prefix = "SLANG_CONTAINER_FORMAT_" },
+    .{ .type = slang.PassThrough, .cpp_name = "SlangPassThrough", .prefix = "SLANG_PASS_THROUGH_" },
+    .{ .type = slang.ArchiveType, .cpp_name = "SlangArchiveType", .prefix = "SLANG_ARCHIVE_TYPE_" },
+    .{ .type = slang.FloatingPointMode, .cpp_name = "SlangFloatingPointMode", .prefix = "SLANG_FLOATING_POINT_MODE_" },
+    .{ .type = slang.FpDenormalMode, .cpp_name = "SlangFpDenormalMode", .prefix = "SLANG_FP_DENORM_MODE_" },
+    .{ .type = slang.LineDirectiveMode, .cpp_name = "SlangLineDirectiveMode", .prefix = "SLANG_LINE_DIRECTIVE_MODE_" },
+    .{ .type = slang.SourceLanguage, .cpp_name = "SlangSourceLanguage", .prefix = "SLANG_SOURCE_LANGUAGE_" },
+    .{ .type = slang.ProfileID, .cpp_name = "SlangProfileID", .prefix = "SLANG_PROFILE_" },
+    .{ .type = slang.CapabilityID, .cpp_name = "SlangCapabilityID", .prefix = "SLANG_CAPABILITY_" },
+    .{ .type = slang.MatrixLayoutMode, .cpp_name = "SlangMatrixLayoutMode", .prefix = "SLANG_MATRIX_LAYOUT_", .overrides = &.{
+        .{ "unknown", "SLANG_MATRIX_LAYOUT_MODE_UNKNOWN" },
+    } },
+    .{ .type = slang.Stage, .cpp_name = "SlangStage", .prefix = "SLANG_STAGE_" },
+    .{ .type = slang.DebugInfoLevel, .cpp_name = "SlangDebugInfoLevel", .prefix = "SLANG_DEBUG_INFO_LEVEL_" },
+    .{ .type = slang.DebugInfoFormat, .cpp_name = "SlangDebugInfoFormat", .prefix = "SLANG_DEBUG_INFO_FORMAT_" },
+    .{ .type = slang.OptimizationLevel, .cpp_name = "SlangOptimizationLevel", .prefix = "SLANG_OPTIMIZATION_LEVEL_" },
+    .{ .type = slang.EmitSpirvMethod, .cpp_name = "SlangEmitSpirvMethod", .prefix = "SLANG_EMIT_SPIRV_" },
+    .{ .type = slang.CompilerOptionName, .cpp_name = "slang::CompilerOptionName", .case = .pascal, .overrides = &.{
+        .{ "skip_spirv_validation", "SkipSPIRVValidation" },
+        .{ "spirv_core_grammar_json", "SPIRVCoreGrammarJSON" },
+        .{ "vulkan_use_gl_layout", "VulkanUseGLLayout" },
+        .{ "embed_downstream_ir", "EmbedDownstreamIR" },
+        .{ "force_dx_layout", "ForceDXLayout" },
+    } },
+    .{ .type = slang.CompilerOptionValueKind, .cpp_name = "slang::CompilerOptionValueKind", .case = .pascal },
+    .{ .type = slang.PathType, .cpp_name = "SlangPathType", .prefix = "SLANG_PATH_TYPE_" },
+    .{ .type = slang.OSPathKind, .cpp_name = "OSPathKind", .case = .pascal },
+    .{ .type = slang.PathKind, .cpp_name = "PathKind", .case = .pascal },
+    .{ .type = slang.WriterChannel, .cpp_name = "SlangWriterChannel", .prefix = "SLANG_WRITER_CHANNEL_" },
+    .{ .type = slang.WriterMode, .cpp_name = "SlangWriterMode", .prefix = "SLANG_WRITER_MODE_" },
+    .{ .type = slang.GenericArgType, .cpp_name = "SlangReflectionGenericArgType", .prefix = "SLANG_GENERIC_ARG_" },
+    .{ .type = slang.TypeKind, .cpp_name = "SlangTypeKind", .prefix = "SLANG_TYPE_KIND_" },
+    .{ .type = slang.ScalarType, .cpp_name = "SlangScalarType", .prefix = "SLANG_SCALAR_TYPE_" },
+    .{ .type = slang.DeclKind, .cpp_name = "SlangDeclKind", .prefix = "SLANG_DECL_KIND_" },
+    .{ .type = slang.ResourceShape, .cpp_name = "SlangResourceShape", .prefix = "SLANG_", .overrides = &.{
+        .{ "none", "SLANG_RESOURCE_NONE" },
+    } },
+    .{ .type = slang.ResourceAccess, .cpp_name = "SlangResourceAccess", .prefix = "SLANG_RESOURCE_ACCESS_" },
+    .{ .type = slang.LayoutRules, .cpp_name = "SlangLayoutRules", .prefix = "SLANG_LAYOUT_RULES_" },
+    .{ .type = slang.ImageFormat, .cpp_name = "SlangImageFormat", .case = .verbatim, .prefix = "SLANG_IMAGE_FORMAT_" },
+    .{ .type = slang.ParameterCategory, .cpp_name = "SlangParameterCategory", .prefix = "SLANG_PARAMETER_CATEGORY_" },
+    .{ .type = slang.BindingType, .cpp_name = "SlangBindingType", .prefix = "SLANG_BINDING_TYPE_" },
+    .{ .type = slang.ModifierID, .cpp_name = "SlangModifierID", .prefix = "SLANG_MODIFIER_" },
+    .{ .type = slang.BuiltinModuleName, .cpp_name = "slang::BuiltinModuleName", .case = .pascal },
+    .{ .type = slang.ContainerType, .cpp_name = "slang::ContainerType", .case = .pascal, .overrides = &.{
+        .{ "unsizedarray", "UnsizedArray" },
+        .{ "structuredbuffer", "StructuredBuffer" },
+        .{ "constantbuffer", "ConstantBuffer" },
+        .{ "parameterblock", "ParameterBlock" },
+    } },
+    .{ .type = slang.LanguageVersion, .cpp_name = "SlangLanguageVersion", .prefix = "SLANG_LANGUAGE_VERSION_" },
+    .{ .type = @FieldType(slang.SpecializationArg, "kind"), .cpp_name = "slang::SpecializationArg::Kind", .case = .pascal },
+};
+
+const flags = [_]FlagsInfo{
+    .{ .type = slang.DiagnosticFlags, .prefix = "SLANG_DIAGNOSTIC_FLAG_" },
+    .{ .type = slang.CompileFlags, .prefix = "SLANG_COMPILE_FLAG_" },
+    .{ .type = slang.TargetFlags, .prefix = "SLANG_TARGET_FLAG_" },
+    .{ .type = slang.CompileCoreModuleFlags, .scope = "slang::CompileCoreModuleFlag", .case = .pascal },
+};
+
+pub const checks: []const Check = blk: {
+    @setEvalBranchQuota(1_000_000);
+    var list: []const Check = &.{};
+    for (structs) |info| list = list ++ structChecks(info);
+    for (enums) |info| list = list ++ enumChecks(info);
+    for (flags) |info| list = list ++ flagsChecks(info);
+    const final = list[0..list.len].*;
+    break :blk &final;
+};
+
+fn structChecks(comptime info: StructInfo) []const Check {
+    const S = info.type;
+    const name = shortTypeName(S);
+    var list: []const Check = &.{
+        .{ .name = name ++ " size", .cpp = "sizeof(" ++ info.cpp_name ++ ")", .value = @sizeOf(S) },
+        .{ .name = name ++ " alignment", .cpp = "alignof(" ++ info.cpp_name ++ ")", .value = @alignOf(S) },
+    };
+    for (std.meta.fields(S)) |field| {
+        const cpp_field = convertName(field.name, .camel, "", info.overrides);
+        list = list ++ &[_]Check{.{
+            .name = name ++ "." ++ field.name ++ " offset",
+            .cpp = "SLANG_ABI_OFFSET(" ++ info.cpp_name ++ ", " ++ cpp_field ++ ")",
+            .value = @offsetOf(S, field.name),
+        }};
+    }
+    return list;
+}
+
+fn enumChecks(comptime info: EnumInfo) []const Check {
+    const E = info.type;
+    const name = shortTypeName(E);
+    var list: []const Check = &.{};
+    for (std.meta.fields(E)) |field| {
+        const cpp_value = convertName(field.name, info.case, info.prefix, info.overrides);
+        list = list ++ &[_]Check{.{
+            .name = name ++ "." ++ field.name,
+            .cpp = "SLANG_ABI_ENUM(" ++ info.cpp_name ++ ", " ++ cpp_value ++ ")",
+            .value = field.value,
+        }};
+    }
+    return list;
+}
+
+fn flagsChecks(comptime info: FlagsInfo) []const Check {
+    const F = info.type;
+    const Bits = std.meta.Int(.unsigned, @bitSizeOf(F));
+    const name = shortTypeName(F);
+    var list: []const Check = &.{};
+    for (std.meta.fields(F)) |field| {
+        if (field.type != bool) continue;
+
+        var value: F = .{};
+        @field(value, field.name) = true;
+        const cpp_value = convertName(field.name, info.case, info.prefix, &.{});
+        list = list ++ &[_]Check{.{
+            .name = name ++ "." ++ field.name,
+            .cpp = if (info.scope) |scope| "SLANG_ABI_ENUM(" ++ scope ++ ", " ++ cpp_value ++ ")" else "int64_t(" ++ cpp_value ++ ")",
+            .value = @as(Bits, @bitCast(value)),
+        }};
+    }
+    return list;
+}
+
+fn shortTypeName(comptime T: type) []const u8 {
+    const full_name = @typeName(T);
+    return full_name[if (std.mem.lastIndexOfScalar(u8, full_name, '.')) |i| i + 1 else 0..];
+}
+
+fn convertName(comptime name: []const u8, comptime case: Case, comptime prefix: []const u8, comptime overrides: []const Override) []const u8 {
+    for (overrides) |override| {
+        if (std.mem.eql(u8, override[0], name)) return override[1];
+    }
+    if (case == .verbatim) return prefix ++ name;
+
+    var result: []const u8 = prefix;
+    var words = std.mem.tokenizeScalar(u8, name, '_');
+    var first = true;
+    while (words.next()) |word| : (first = false) {
+        result = result ++ switch (case) {
+            .upper => (if (first) "" else "_") ++ upper(word),
+            .camel => if (first) word else capitalize(word),
+            .pascal => capitalize(word),
+            .verbatim => unreachable,
+        };
+    }
+    return result;
+}
+
+fn capitalize(comptime word: []const u8) []const u8 {
+    for (acronyms) |acronym| {
+        if (std.mem.eql(u8, acronym, word)) return upper(word);
+    }
+    return upper(word[0..1]) ++ word[1..];
+}
+
+fn upper(comptime word: []const u8) []const u8 {
+    var buffer: [word.len]u8 = undefined;
+    for (&buffer, word) |*c, w| c.* = std.ascii.toUpper(w);
+    const final = buffer;
+    return &final;
+}
+
+const preamble =
+    \\// Generated by src/abi_gen.zig, do not edit.
+    \\#include "slang.h"
+    \\#include <cstddef>
+    \\#include <cstdint>
+    \\
+    \\#define SLANG_ABI_MISSING INT64_MIN
+    \\
+    \\// Names are looked up through a dependent type, so a name that is missing
+    \\// from slang.h fails the test instead of the build. Global flag names are
+    \\// used directly and fail the build.
+    \\#define SLANG_ABI_ENUM(E, NAME)                                                \
+    \\  []<typename T = E>() -> int64_t {                                            \
+    \\    if constexpr (requires { T::NAME; })                                       \
+    \\      return int64_t(T::NAME);                                                 \
+    \\    else                                                                       \
+    \\      return SLANG_ABI_MISSING;                                                \
+    \\  }()
+    \\
+    \\#define SLANG_ABI_OFFSET(S, FIELD)                                             \
+    \\  []<typename T = S>() -> int64_t {                                            \
+    \\    if constexpr (requires { T::FIELD; })                                      \
+    \\      return int64_t(offsetof(T, FIELD));                                      \
+    \\    else                                                                       \
+    \\      return SLANG_ABI_MISSING;                                                \
+    \\  }()
+    \\
+    \\extern "C" const int64_t slang_abi_values[] = {
+    \\
+;
+
+const postamble =
+    \\};
+    \\
+    \\extern "C" const uint32_t slang_abi_value_count =
+    \\    sizeof(slang_abi_values) / sizeof(slang_abi_values[0]);
+    \\
+;
+
+pub fn writeCpp(writer: *std.Io.Writer) !void {
+    try writer.writeAll(preamble);
+    for (checks) |check| {
+        try writer.print("    {s}, // {s}\n", .{ check.cpp, check.name });
+    }
+    try writer.writeAll(postamble);
+}
+
+pub fn main() !void {
+    var arena_state = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena_state.deinit();
+
+    const args = try std.process.argsAlloc(arena_state.allocator());
+    if (args.len != 2) {
+        std.log.err("usage: {s} <output.cpp>", .{args[0]});
+        return error.InvalidArguments;
+    }
+
+    const file = try std.fs.cwd().createFile(args[1], .{});
+    defer file.close();
+
+    var buffer: [4096]u8 = undefined;
+    var file_writer = file.writer(&buffer);
+    try writeCpp(&file_writer.interface);
+    try file_writer.interface.flush();
+}
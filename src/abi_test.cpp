@@ -1,11 +1,20 @@
 #include "slang.h"
 #include <cassert>
+#include <cstdint>
 #include <iostream>
 #include <string.h>
 #include <string>
+#include <type_traits>
 
-extern "C" char slang_args_buffer[1024] = {0};
-extern "C" uint32_t slang_args_buffer_end = 0;
+// Every thread records into its own buffer, so the interfaces can be fuzzed in
+// parallel
+static thread_local char slang_args_buffer[4096] = {0};
+static thread_local uint32_t slang_args_buffer_end = 0;
+
+extern "C" const char *slang_args_buffer_get(uint32_t *out_len) {
+  *out_len = slang_args_buffer_end;
+  return slang_args_buffer;
+}
 
 namespace test {
 
@@ -16,16 +25,55 @@ static void appendArgImpl(const void *data, uint32_t len) {
   slang_args_buffer_end += len;
 }
 
+// Writes a pattern derived from the current buffer offset through out-params,
+// so the caller can verify that the pointee types agree in size on both sides.
+static void writeOutParam(void *data, size_t len) {
+  uint8_t *bytes = static_cast<uint8_t *>(data);
+  for (size_t i = 0; i < len; i++) {
+    bytes[i] = uint8_t(0x5a ^ slang_args_buffer_end ^ i);
+  }
+}
+
 template <typename T> static void appendArg(const T &value) {
   appendArgImpl(&value, sizeof(T));
 }
 
+template <typename T> static void appendArg(T *const &value) {
+  appendArgImpl(&value, sizeof(value));
+  if constexpr (!std::is_const_v<T> && !std::is_void_v<T> &&
+                !std::is_function_v<T> && !std::is_polymorphic_v<T> &&
+                !std::is_empty_v<T>) {
+    writeOutParam(value, sizeof(T));
+  }
+}
+
 static void beginArgs(std::string_view func_name) {
   memset(slang_args_buffer, 0, slang_args_buffer_end);
   slang_args_buffer_end = 0;
   appendArgImpl(func_name.data(), func_name.size());
 }
 
+// The return value of every mocked method is derived from the FNV-1a hash of
+// the recorded arguments. Pointers keep the low byte clear and are never null,
+// bools and enums only use the lowest bit so they stay in range, other scalars
+// are the truncated hash.
+struct ReturnValue {
+  template <typename T> operator T() const {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (uint32_t i = 0; i < slang_args_buffer_end; i++) {
+      hash = (hash ^ uint8_t(slang_args_buffer[i])) * 0x100000001b3;
+    }
+
+    if constexpr (std::is_pointer_v<T>) {
+      return reinterpret_cast<T>(uintptr_t((hash & ~uint64_t(0xff)) | 0x100));
+    } else if constexpr (std::is_same_v<T, bool> || std::is_enum_v<T>) {
+      return static_cast<T>(hash & 1);
+    } else {
+      return static_cast<T>(hash);
+    }
+  }
+};
+
 #define OVERRIDE(name, foo, bar)                                               \
   struct name : foo {                                                          \
     bar                                                                        \
@@ -38,17 +86,17 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(&uuid);                                                          \
     appendArg(outObject);                                                      \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
   SLANG_NO_THROW uint32_t SLANG_MCALL addRef() override {                      \
     beginArgs(class_name ".addRef");                                           \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
   SLANG_NO_THROW uint32_t SLANG_MCALL release() override {                     \
     beginArgs(class_name ".release");                                          \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_ICASTABLE(class_name)                                         \
@@ -57,7 +105,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".castAs");                                           \
     appendArg(this);                                                           \
     appendArg(&guid);                                                          \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_ICLONABLE(class_name)                                         \
@@ -66,7 +114,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".clone");                                            \
     appendArg(this);                                                           \
     appendArg(&guid);                                                          \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_IBLOB(class_name)                                             \
@@ -74,12 +122,12 @@ static void beginArgs(std::string_view func_name) {
   SLANG_NO_THROW void const *SLANG_MCALL getBufferPointer() override {         \
     beginArgs(class_name ".getBufferPointer");                                 \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
   SLANG_NO_THROW size_t SLANG_MCALL getBufferSize() override {                 \
     beginArgs(class_name ".getBufferSize");                                    \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_IFILE_SYSTEM(class_name)                                      \
@@ -90,7 +138,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(path);                                                           \
     appendArg(outBlob);                                                        \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_ISHARED_LIBRARY(class_name)                                   \
@@ -100,7 +148,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".findSymbolAddressByName");                          \
     appendArg(this);                                                           \
     appendArg(name);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_ISHARED_LIBRARY_LOADER(class_name)                            \
@@ -111,7 +159,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(path);                                                           \
     appendArg(sharedLibraryOut);                                               \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_IFILE_SYSTEM_EXT(class_name)                                  \
@@ -122,7 +170,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(path);                                                           \
     appendArg(outUniqueIdentity);                                              \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL calcCombinedPath(                     \
@@ -134,7 +182,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(fromPath);                                                       \
     appendArg(path);                                                           \
     appendArg(pathOut);                                                        \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getPathType(                          \
@@ -143,7 +191,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(path);                                                           \
     appendArg(pathTypeOut);                                                    \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getPath(                              \
@@ -153,7 +201,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(kind);                                                           \
     appendArg(path);                                                           \
     appendArg(outPath);                                                        \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW void SLANG_MCALL clearCache() override {                      \
@@ -169,13 +217,13 @@ static void beginArgs(std::string_view func_name) {
     appendArg(path);                                                           \
     appendArg(callback);                                                       \
     appendArg(userData);                                                       \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW OSPathKind SLANG_MCALL getOSPathKind() override {             \
     beginArgs(class_name ".getOSPathKind");                                    \
     appendArg(this);                                                           \
-    return OSPathKind::None;                                                   \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_IMUTABLE_FILE_SYSTEM(class_name)                              \
@@ -187,7 +235,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(path);                                                           \
     appendArg(data);                                                           \
     appendArg(size);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL saveFileBlob(                         \
@@ -196,14 +244,14 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(path);                                                           \
     appendArg(dataBlob);                                                       \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL remove(const char *path) override {   \
     beginArgs(class_name ".remove");                                           \
     appendArg(this);                                                           \
     appendArg(path);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL createDirectory(const char *path)     \
@@ -211,7 +259,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".createDirectory");                                  \
     appendArg(this);                                                           \
     appendArg(path);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_IWRITER(class_name)                                           \
@@ -221,7 +269,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".beginAppendBuffer");                                \
     appendArg(this);                                                           \
     appendArg(maxNumChars);                                                    \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL endAppendBuffer(                      \
@@ -230,7 +278,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(buffer);                                                         \
     appendArg(numChars);                                                       \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL write(const char *chars,              \
@@ -239,7 +287,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(chars);                                                          \
     appendArg(numChars);                                                       \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW void SLANG_MCALL flush() override {                           \
@@ -250,7 +298,7 @@ static void beginArgs(std::string_view func_name) {
   SLANG_NO_THROW SlangBool SLANG_MCALL isConsole() override {                  \
     beginArgs(class_name ".isConsole");                                        \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL setMode(SlangWriterMode mode)         \
@@ -258,7 +306,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".setMode");                                          \
     appendArg(this);                                                           \
     appendArg(mode);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_IPROFILER(class_name)                                         \
@@ -266,7 +314,7 @@ static void beginArgs(std::string_view func_name) {
   SLANG_NO_THROW size_t SLANG_MCALL getEntryCount() override {                 \
     beginArgs(class_name ".getEntryCount");                                    \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW const char *SLANG_MCALL getEntryName(uint32_t index)          \
@@ -274,14 +322,14 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".getEntryName");                                     \
     appendArg(this);                                                           \
     appendArg(index);                                                          \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW long SLANG_MCALL getEntryTimeMS(uint32_t index) override {    \
     beginArgs(class_name ".getEntryTimeMS");                                   \
     appendArg(this);                                                           \
     appendArg(index);                                                          \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW uint32_t SLANG_MCALL getEntryInvocationTimes(uint32_t index)  \
@@ -289,7 +337,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".getEntryInvocationTimes");                          \
     appendArg(this);                                                           \
     appendArg(index);                                                          \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_IGLOBAL_SESSION(class_name)                                   \
@@ -300,7 +348,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(&desc);                                                          \
     appendArg(outSession);                                                     \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangProfileID SLANG_MCALL findProfile(char const *name)      \
@@ -308,7 +356,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".findProfile");                                      \
     appendArg(this);                                                           \
     appendArg(name);                                                           \
-    return SlangProfileID::SLANG_PROFILE_UNKNOWN;                              \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW void SLANG_MCALL setDownstreamCompilerPath(                   \
@@ -338,7 +386,7 @@ static void beginArgs(std::string_view func_name) {
   SLANG_NO_THROW const char *SLANG_MCALL getBuildTagString() override {        \
     beginArgs(class_name ".getBuildTagString");                                \
     appendArg(this);                                                           \
-    return "unknown";                                                          \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL setDefaultDownstreamCompiler(         \
@@ -348,7 +396,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(sourceLanguage);                                                 \
     appendArg(defaultCompiler);                                                \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SlangPassThrough SLANG_MCALL getDefaultDownstreamCompiler(                   \
@@ -356,7 +404,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".getDefaultDownstreamCompiler");                     \
     appendArg(this);                                                           \
     appendArg(sourceLanguage);                                                 \
-    return SlangPassThrough::SLANG_PASS_THROUGH_NONE;                          \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW void SLANG_MCALL setLanguagePrelude(                          \
@@ -380,7 +428,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".createCompileRequest");                             \
     appendArg(this);                                                           \
     appendArg(outCompileRequest);                                              \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW void SLANG_MCALL addBuiltins(                                 \
@@ -402,7 +450,7 @@ static void beginArgs(std::string_view func_name) {
   getSharedLibraryLoader() override {                                          \
     beginArgs(class_name ".getSharedLibraryLoader");                           \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL checkCompileTargetSupport(            \
@@ -410,7 +458,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".checkCompileTargetSupport");                        \
     appendArg(this);                                                           \
     appendArg(target);                                                         \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL checkPassThroughSupport(              \
@@ -418,7 +466,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".checkPassThroughSupport");                          \
     appendArg(this);                                                           \
     appendArg(passThrough);                                                    \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL compileCoreModule(                    \
@@ -426,7 +474,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".compileCoreModule");                                \
     appendArg(this);                                                           \
     appendArg(flags);                                                          \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL loadCoreModule(                       \
@@ -435,7 +483,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(coreModule);                                                     \
     appendArg(coreModuleSizeInBytes);                                          \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL saveCoreModule(                       \
@@ -444,7 +492,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(archiveType);                                                    \
     appendArg(outBlob);                                                        \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangCapabilityID SLANG_MCALL findCapability(                 \
@@ -452,7 +500,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".findCapability");                                   \
     appendArg(this);                                                           \
     appendArg(name);                                                           \
-    return SlangCapabilityID::SLANG_CAPABILITY_UNKNOWN;                        \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW void SLANG_MCALL setDownstreamCompilerForTransition(          \
@@ -472,7 +520,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(source);                                                         \
     appendArg(target);                                                         \
-    return SlangPassThrough::SLANG_PASS_THROUGH_NONE;                          \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW void SLANG_MCALL getCompilerElapsedTime(                      \
@@ -488,7 +536,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".setSPIRVCoreGrammar");                              \
     appendArg(this);                                                           \
     appendArg(jsonPath);                                                       \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL parseCommandLineArguments(            \
@@ -500,7 +548,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(argv);                                                           \
     appendArg(outSessionDesc);                                                 \
     appendArg(outAuxAllocation);                                               \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getSessionDescDigest(                 \
@@ -509,7 +557,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(sessionDesc);                                                    \
     appendArg(outBlob);                                                        \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL compileBuiltinModule(                 \
@@ -519,7 +567,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(module);                                                         \
     appendArg(flags);                                                          \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL loadBuiltinModule(                    \
@@ -530,7 +578,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(module);                                                         \
     appendArg(moduleData);                                                     \
     appendArg(sizeInBytes);                                                    \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL saveBuiltinModule(                    \
@@ -541,7 +589,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(module);                                                         \
     appendArg(archiveType);                                                    \
     appendArg(outBlob);                                                        \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_ISESSION(class_name)                                          \
@@ -550,7 +598,7 @@ static void beginArgs(std::string_view func_name) {
       override {                                                               \
     beginArgs(class_name ".getGlobalSession");                                 \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW slang::IModule *SLANG_MCALL loadModule(                       \
@@ -560,7 +608,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(moduleName);                                                     \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW slang::IModule *SLANG_MCALL loadModuleFromSource(             \
@@ -572,7 +620,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(path);                                                           \
     appendArg(source);                                                         \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL createCompositeComponentType(         \
@@ -586,7 +634,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(componentTypeCount);                                             \
     appendArg(outCompositeComponentType);                                      \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW slang::TypeReflection *SLANG_MCALL specializeType(            \
@@ -600,7 +648,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(specializationArgs);                                             \
     appendArg(specializationArgCount);                                         \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW slang::TypeLayoutReflection *SLANG_MCALL getTypeLayout(       \
@@ -613,7 +661,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(targetIndex);                                                    \
     appendArg(rules);                                                          \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW slang::TypeReflection *SLANG_MCALL getContainerType(          \
@@ -624,14 +672,14 @@ static void beginArgs(std::string_view func_name) {
     appendArg(elementType);                                                    \
     appendArg(containerType);                                                  \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW slang::TypeReflection *SLANG_MCALL getDynamicType()           \
       override {                                                               \
     beginArgs(class_name ".getDynamicType");                                   \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getTypeRTTIMangledName(               \
@@ -640,7 +688,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(type);                                                           \
     appendArg(outNameBlob);                                                    \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getTypeConformanceWitnessMangledName( \
@@ -651,7 +699,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(type);                                                           \
     appendArg(interfaceType);                                                  \
     appendArg(outNameBlob);                                                    \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL                                       \
@@ -663,7 +711,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(type);                                                           \
     appendArg(interfaceType);                                                  \
     appendArg(outId);                                                          \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL createCompileRequest(                 \
@@ -671,7 +719,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".createCompileRequest");                             \
     appendArg(this);                                                           \
     appendArg(outCompileRequest);                                              \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL createTypeConformanceComponentType(   \
@@ -685,7 +733,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(outConformance);                                                 \
     appendArg(conformanceIdOverride);                                          \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW slang::IModule *SLANG_MCALL loadModuleFromIRBlob(             \
@@ -697,13 +745,13 @@ static void beginArgs(std::string_view func_name) {
     appendArg(path);                                                           \
     appendArg(source);                                                         \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangInt SLANG_MCALL getLoadedModuleCount() override {        \
     beginArgs(class_name ".getLoadedModuleCount");                             \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW slang::IModule *SLANG_MCALL getLoadedModule(SlangInt index)   \
@@ -711,7 +759,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".getLoadedModule");                                  \
     appendArg(this);                                                           \
     appendArg(index);                                                          \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW bool SLANG_MCALL isBinaryModuleUpToDate(                      \
@@ -720,7 +768,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(modulePath);                                                     \
     appendArg(binaryModuleBlob);                                               \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW slang::IModule *SLANG_MCALL loadModuleFromSourceString(       \
@@ -732,7 +780,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(path);                                                           \
     appendArg(string);                                                         \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getDynamicObjectRTTIBytes(            \
@@ -744,7 +792,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(interfaceType);                                                  \
     appendArg(outRTTIDataBuffer);                                              \
     appendArg(bufferSizeInBytes);                                              \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL loadModuleInfoFromIRBlob(             \
@@ -757,7 +805,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(&outModuleVersion);                                              \
     appendArg(&outModuleCompilerVersion);                                      \
     appendArg(&outModuleName);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_IMETADATA(class_name)                                         \
@@ -771,13 +819,13 @@ static void beginArgs(std::string_view func_name) {
     appendArg(spaceIndex);                                                     \
     appendArg(registerIndex);                                                  \
     appendArg(&outUsed);                                                       \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   const char *SLANG_MCALL getDebugBuildIdentifier() override {                 \
     beginArgs(class_name ".getDebugBuildIdentifier");                          \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_ICOMPILE_RESULT(class_name)                                   \
@@ -785,7 +833,7 @@ static void beginArgs(std::string_view func_name) {
   uint32_t SLANG_MCALL getItemCount() override {                               \
     beginArgs(class_name ".getItemCount");                                     \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SlangResult SLANG_MCALL getItemData(uint32_t index, ISlangBlob **outblob)    \
@@ -794,7 +842,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(index);                                                          \
     appendArg(outblob);                                                        \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SlangResult SLANG_MCALL getMetadata(slang::IMetadata **outMetadata)          \
@@ -802,7 +850,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".getMetadata");                                      \
     appendArg(this);                                                           \
     appendArg(outMetadata);                                                    \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_ICOMPONENT_TYPE(class_name)                                   \
@@ -810,7 +858,7 @@ static void beginArgs(std::string_view func_name) {
   SLANG_NO_THROW slang::ISession *SLANG_MCALL getSession() override {          \
     beginArgs(class_name ".getSession");                                       \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW slang::ProgramLayout *SLANG_MCALL getLayout(                  \
@@ -820,13 +868,13 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(targetIndex);                                                    \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangInt SLANG_MCALL getSpecializationParamCount() override { \
     beginArgs(class_name ".getSpecializationParamCount");                      \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getEntryPointCode(                    \
@@ -838,7 +886,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(targetIndex);                                                    \
     appendArg(outCode);                                                        \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getResultAsFileSystem(                \
@@ -849,7 +897,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(entryPointIndex);                                                \
     appendArg(targetIndex);                                                    \
     appendArg(outFileSystem);                                                  \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW void SLANG_MCALL getEntryPointHash(                           \
@@ -873,7 +921,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(specializationArgCount);                                         \
     appendArg(outSpecializedComponentType);                                    \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL link(                                 \
@@ -883,7 +931,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(outLinkedComponentType);                                         \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getEntryPointHostCallable(            \
@@ -896,7 +944,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(targetIndex);                                                    \
     appendArg(outSharedLibrary);                                               \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL renameEntryPoint(                     \
@@ -905,7 +953,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(newName);                                                        \
     appendArg(outEntryPoint);                                                  \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL linkWithOptions(                      \
@@ -919,7 +967,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(compilerOptionEntryCount);                                       \
     appendArg(compilerOptionEntries);                                          \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getTargetCode(                        \
@@ -930,7 +978,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(targetIndex);                                                    \
     appendArg(outCode);                                                        \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getTargetMetadata(                    \
@@ -941,7 +989,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(targetIndex);                                                    \
     appendArg(outMetadata);                                                    \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getEntryPointMetadata(                \
@@ -954,7 +1002,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(targetIndex);                                                    \
     appendArg(outMetadata);                                                    \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_IENTRY_POINT(class_name)                                      \
@@ -963,7 +1011,7 @@ static void beginArgs(std::string_view func_name) {
   getFunctionReflection() override {                                           \
     beginArgs(class_name ".getFunctionReflection");                            \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_ICOMPONENT_TYPE2(class_name)                                  \
@@ -976,7 +1024,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(targetIndex);                                                    \
     appendArg(outCompileResult);                                               \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getEntryPointCompileResult(           \
@@ -989,7 +1037,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(targetIndex);                                                    \
     appendArg(outCompileResult);                                               \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_IMODULE(class_name)                                           \
@@ -1000,13 +1048,13 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(name);                                                           \
     appendArg(outEntryPoint);                                                  \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangInt32 SLANG_MCALL getDefinedEntryPointCount() override { \
     beginArgs(class_name ".getDefinedEntryPointCount");                        \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getDefinedEntryPoint(                 \
@@ -1015,7 +1063,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(index);                                                          \
     appendArg(outEntryPoint);                                                  \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL serialize(                            \
@@ -1023,7 +1071,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".serialize");                                        \
     appendArg(this);                                                           \
     appendArg(outSerializedBlob);                                              \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL writeToFile(char const *fileName)     \
@@ -1031,25 +1079,25 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".writeToFile");                                      \
     appendArg(this);                                                           \
     appendArg(fileName);                                                       \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW const char *SLANG_MCALL getName() override {                  \
     beginArgs(class_name ".getName");                                          \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW const char *SLANG_MCALL getFilePath() override {              \
     beginArgs(class_name ".getFilePath");                                      \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW const char *SLANG_MCALL getUniqueIdentity() override {        \
     beginArgs(class_name ".getUniqueIdentity");                                \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL findAndCheckEntryPoint(               \
@@ -1061,13 +1109,13 @@ static void beginArgs(std::string_view func_name) {
     appendArg(stage);                                                          \
     appendArg(outEntryPoint);                                                  \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangInt32 SLANG_MCALL getDependencyFileCount() override {    \
     beginArgs(class_name ".getDependencyFileCount");                           \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW char const *SLANG_MCALL getDependencyFilePath(                \
@@ -1075,14 +1123,14 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".getDependencyFilePath");                            \
     appendArg(this);                                                           \
     appendArg(index);                                                          \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW slang::DeclReflection *SLANG_MCALL getModuleReflection()      \
       override {                                                               \
     beginArgs(class_name ".getModuleReflection");                              \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL disassemble(                          \
@@ -1090,7 +1138,7 @@ static void beginArgs(std::string_view func_name) {
     beginArgs(class_name ".disassemble");                                      \
     appendArg(this);                                                           \
     appendArg(outDisassembledBlob);                                            \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 #define OVERRIDE_IMODULE_PRECOMPILE_SERVICE_EXPERIMENTAL(class_name)           \
@@ -1101,7 +1149,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(this);                                                           \
     appendArg(target);                                                         \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getPrecompiledTargetCode(             \
@@ -1112,13 +1160,13 @@ static void beginArgs(std::string_view func_name) {
     appendArg(target);                                                         \
     appendArg(outCode);                                                        \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangInt SLANG_MCALL getModuleDependencyCount() override {    \
     beginArgs(class_name ".getModuleDependencyCount");                         \
     appendArg(this);                                                           \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }                                                                            \
                                                                                \
   SLANG_NO_THROW SlangResult SLANG_MCALL getModuleDependency(                  \
@@ -1129,7 +1177,7 @@ static void beginArgs(std::string_view func_name) {
     appendArg(dependencyIndex);                                                \
     appendArg(outModule);                                                      \
     appendArg(outDiagnostics);                                                 \
-    return 0;                                                                  \
+    return ReturnValue{};                                                      \
   }
 
 OVERRIDE(IUnknown, ISlangUnknown, OVERRIDE_IUNKNOWN("IUnknown"));
@@ -0,0 +1,363 @@
+//! Compiles every entry point of a set of modules, linking each module only once.
+//!
+//! Entry points of the same module share its global parameters, so they are linked together in
+//! one composite and their code is generated from that single linked program. Sessions are not
+//! thread safe, so the modules are spread over worker threads that each have their own global
+//! session. Compiling runs in two passes: the first one loads the modules and discovers their
+//! entry points, then names that appear in more than one module are made unique with
+//! `renameEntryPoint`, and the second pass links and generates code on the same workers, so
+//! every module is only loaded once.
+
+const std = @import("std");
+const slang = @import("root.zig");
+
+const IGlobalSession = slang.IGlobalSession;
+const ISession = slang.ISession;
+const IModule = slang.IModule;
+const IEntryPoint = slang.IEntryPoint;
+const IComponentType = slang.IComponentType;
+const IBlob = slang.IBlob;
+const Owned = slang.Owned;
+const SessionDesc = slang.SessionDesc;
+const Stage = slang.Stage;
+
+const log = std.log.scoped(.slang_batch);
+
+pub const BatchOptions = struct {
+    session_desc: SessionDesc,
+    /// Names or paths, as given to `ISession.loadModule`
+    modules: []const []const u8,
+    /// Defaults to the number of cpus
+    thread_count: ?usize = null,
+};
+
+pub const BatchResult = struct {
+    arena: std.heap.ArenaAllocator,
+    entry_points: []const EntryPoint,
+    failed_modules: []const []const u8,
+
+    pub const EntryPoint = struct {
+        module: []const u8,
+        name: []const u8,
+        /// Differs from `name` when another module has an entry point with the same name
+        unique_name: []const u8,
+        stage: Stage,
+        /// One per target of the session, null where code generation failed
+        code: []?Owned(IBlob),
+    };
+
+    pub fn deinit(self: *BatchResult) void {
+        for (self.entry_points) |entry_point| {
+            for (entry_point.code) |*code| if (code.*) |*blob| blob.release();
+        }
+        self.arena.deinit();
+    }
+};
+
+/// Compiles every entry point of `options.modules` for every target of the session. Modules that
+/// fail to load or link are listed in the result instead of failing the whole batch. `gpa` is
+/// used from several threads and has to be thread safe.
+pub fn compileLibrary(gpa: std.mem.Allocator, options: BatchOptions) !BatchResult {
+    var arena_state = std.heap.ArenaAllocator.init(gpa);
+    errdefer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    const modules = try arena.alloc(Module, options.modules.len);
+    for (modules, options.modules) |*module, name| {
+        module.* = Module{ .name = try arena.dupeZ(u8, name) };
+    }
+
+    const cpu_count = options.thread_count orelse std.Thread.getCpuCount() catch 1;
+    const worker_count = std.math.clamp(@min(cpu_count, modules.len), 1, max_workers);
+    const workers = try arena.alloc(Worker, worker_count);
+    var initialized: usize = 0;
+    defer for (workers[0..initialized]) |*worker| worker.deinit();
+    for (workers) |*worker| {
+        worker.* = try Worker.init(gpa, options.session_desc, modules);
+        initialized += 1;
+    }
+    // Runs before the workers are deinitialized, the modules have to be released before the
+    // sessions that loaded them
+    defer for (modules) |*module| module.deinit();
+
+    var next_module: std.atomic.Value(usize) = .init(0);
+    try runWorkers(workers, Worker.discover, .{&next_module});
+    try makeNamesUnique(arena, modules);
+    try runWorkers(workers, Worker.generate, .{});
+
+    var entry_points: std.ArrayList(BatchResult.EntryPoint) = .empty;
+    var failed_modules: std.ArrayList([]const u8) = .empty;
+    for (modules) |*module| {
+        if (module.failed) {
+            try failed_modules.append(arena, module.name);
+            continue;
+        }
+        for (module.entry_points.items) |*entry_point| {
+            try entry_points.append(arena, .{
+                .module = module.name,
+                .name = try arena.dupe(u8, entry_point.name),
+                .unique_name = entry_point.unique_name,
+                .stage = entry_point.stage,
+                .code = try arena.dupe(?Owned(IBlob), entry_point.code),
+            });
+            // Ownership of the blobs moves to the result
+            entry_point.code = &.{};
+        }
+    }
+
+    return BatchResult{
+        .arena = arena_state,
+        .entry_points = entry_points.items,
+        .failed_modules = failed_modules.items,
+    };
+}
+
+const max_workers = 64;
+
+const Module = struct {
+    name: [:0]const u8,
+    module: ?Owned(IModule) = null,
+    entry_points: std.ArrayList(EntryPoint) = .empty,
+    failed: bool = false,
+
+    const EntryPoint = struct {
+        handle: Owned(IEntryPoint),
+        name: []const u8,
+        unique_name: [:0]const u8,
+        stage: Stage = .none,
+        code: []?Owned(IBlob) = &.{},
+    };
+
+    fn deinit(self: *Module) void {
+        for (self.entry_points.items) |*entry_point| {
+            entry_point.handle.release();
+            for (entry_point.code) |*code| if (code.*) |*blob| blob.release();
+        }
+        if (self.module) |*module| module.release();
+        self.entry_points = .empty;
+        self.module = null;
+    }
+};
+
+/// Owns a global session, the modules it loaded are only ever touched by this worker.
+const Worker = struct {
+    global_session: Owned(IGlobalSession),
+    session: Owned(ISession),
+    target_count: usize,
+    all_modules: []Module,
+    /// Indices into `all_modules`
+    owned: std.ArrayList(usize) = .empty,
+    /// Only touched by the thread currently running the worker
+    arena: std.heap.ArenaAllocator,
+
+    fn init(gpa: std.mem.Allocator, session_desc: SessionDesc, modules: []Module) !Worker {
+        var global_session = try slang.createGlobalSession(.{});
+        errdefer global_session.release();
+        return Worker{
+            .global_session = global_session,
+            .session = try global_session.borrow().createSession(session_desc),
+            .target_count = session_desc.targets.len,
+            .all_modules = modules,
+            .arena = std.heap.ArenaAllocator.init(gpa),
+        };
+    }
+
+    fn deinit(self: *Worker) void {
+        self.session.release();
+        self.global_session.release();
+        self.arena.deinit();
+    }
+
+    fn discover(self: *Worker, next_module: *std.atomic.Value(usize)) void {
+        while (true) {
+            const index = next_module.fetchAdd(1, .monotonic);
+            if (index >= self.all_modules.len) return;
+            const module = &self.all_modules[index];
+            self.owned.append(self.arena.allocator(), index) catch {
+                module.failed = true;
+                continue;
+            };
+            self.load(module) catch |err| {
+                log.err("{s}: {s}", .{ module.name, @errorName(err) });
+                module.failed = true;
+            };
+        }
+    }
+
+    fn load(self: *Worker, module: *Module) !void {
+        const arena = self.arena.allocator();
+        module.module = self.session.borrow().loadModule(module.name, null) orelse return error.ModuleLoadFailed;
+        const loaded = module.module.?.borrow();
+
+        const count: usize = @intCast(loaded.getDefinedEntryPointCount());
+        try module.entry_points.ensureTotalCapacity(arena, count);
+        for (0..count) |i| {
+            const handle = try loaded.getDefinedEntryPoint(@intCast(i));
+            const name = std.mem.span(handle.borrow().getFunctionReflection().getName());
+            module.entry_points.appendAssumeCapacity(.{ .handle = handle, .name = name, .unique_name = undefined });
+        }
+    }
+
+    fn generate(self: *Worker) void {
+        for (self.owned.items) |index| {
+            const module = &self.all_modules[index];
+            if (module.failed) continue;
+            self.link(module) catch |err| {
+                log.err("{s}: {s}", .{ module.name, @errorName(err) });
+                module.failed = true;
+            };
+        }
+    }
+
+    fn link(self: *Worker, module: *Module) !void {
+        const arena = self.arena.allocator();
+
+        const entry_point_count = module.entry_points.items.len;
+        var components: std.ArrayList(*IComponentType) = try .initCapacity(arena, entry_point_count + 1);
+        components.appendAssumeCapacity(@ptrCast(module.module.?.borrow()));
+        // Only the renamed entry points are new references, the others are borrowed
+        var renamed: std.ArrayList(Owned(IComponentType)) = try .initCapacity(arena, entry_point_count);
+        defer for (renamed.items) |*component| component.release();
+        for (module.entry_points.items) |*entry_point| {
+            if (std.mem.eql(u8, entry_point.name, entry_point.unique_name)) {
+                components.appendAssumeCapacity(@ptrCast(entry_point.handle.borrow()));
+            } else {
+                renamed.appendAssumeCapacity(try entry_point.handle.borrow().renameEntryPoint(entry_point.unique_name));
+                components.appendAssumeCapacity(renamed.getLast().borrow());
+            }
+        }
+
+        var composite = try self.session.borrow().createCompositeComponentType(components.items, null);
+        defer composite.release();
+        var linked = try composite.borrow().link(null);
+        defer linked.release();
+        const layout = linked.borrow().getLayout(0, null);
+
+        for (module.entry_points.items, 0..) |*entry_point, entry_point_index| {
+            if (layout) |program_layout| {
+                entry_point.stage = program_layout.getEntryPointByIndex(entry_point_index).getStage();
+            }
+            entry_point.code = try arena.alloc(?Owned(IBlob), self.target_count);
+            for (entry_point.code, 0..) |*code, target_index| {
+                code.* = linked.borrow().getEntryPointCode(@intCast(entry_point_index), @intCast(target_index), null) catch |err| blk: {
+                    log.err("{s}: {s}: {s}", .{ module.name, entry_point.unique_name, @errorName(err) });
+                    break :blk null;
+                };
+            }
+        }
+    }
+};
+
+/// Runs `function` on every worker, the calling thread takes the first one.
+fn runWorkers(workers: []Worker, comptime function: anytype, args: anytype) !void {
+    var threads: [max_workers]std.Thread = undefined;
+    var spawned: usize = 0;
+    defer for (threads[0..spawned]) |thread| thread.join();
+    for (workers[1..]) |*worker| {
+        threads[spawned] = try std.Thread.spawn(.{}, function, .{worker} ++ args);
+        spawned += 1;
+    }
+    @call(.auto, function, .{&workers[0]} ++ args);
+}
+
+fn makeNamesUnique(arena: std.mem.Allocator, modules: []Module) !void {
+    var counts: std.StringHashMapUnmanaged(u32) = .empty;
+    for (modules) |module| {
+        for (module.entry_points.items) |entry_point| {
+            const entry = try counts.getOrPutValue(arena, entry_point.name, 0);
+            entry.value_ptr.* += 1;
+        }
+    }
+
+    var taken: std.StringHashMapUnmanaged(void) = .empty;
+    for (modules, 0..) |module, module_index| {
+        for (module.entry_points.items) |*entry_point| {
+            if (counts.get(entry_point.name).? == 1) {
+                entry_point.unique_name = try arena.dupeZ(u8, entry_point.name);
+            } else {
+                const stem = std.fs.path.stem(module.name);
+                var unique = try std.fmt.allocPrintSentinel(arena, "{s}_{s}", .{ stem, entry_point.name }, 0);
+                if (counts.contains(unique) or taken.contains(unique)) {
+                    unique = try std.fmt.allocPrintSentinel(arena, "{s}{d}_{s}", .{ stem, module_index, entry_point.name }, 0);
+                }
+                entry_point.unique_name = unique;
+            }
+            try taken.put(arena, entry_point.unique_name, {});
+        }
+    }
+}
+
+test "unique entry point names" {
+    var arena_state = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    var lighting = [_]Module.EntryPoint{
+        .{ .handle = undefined, .name = "main", .unique_name = undefined },
+        .{ .handle = undefined, .name = "shade", .unique_name = undefined },
+    };
+    var shadows = [_]Module.EntryPoint{
+        .{ .handle = undefined, .name = "main", .unique_name = undefined },
+        .{ .handle = undefined, .name = "blur", .unique_name = undefined },
+    };
+    // Already uses the name the first `main` would be renamed to
+    var extra = [_]Module.EntryPoint{
+        .{ .handle = undefined, .name = "lighting_main", .unique_name = undefined },
+    };
+    var modules = [_]Module{
+        .{ .name = "passes/lighting.slang", .entry_points = .fromOwnedSlice(&lighting) },
+        .{ .name = "passes/shadows.slang", .entry_points = .fromOwnedSlice(&shadows) },
+        .{ .name = "extra", .entry_points = .fromOwnedSlice(&extra) },
+    };
+    try makeNamesUnique(arena, &modules);
+
+    try std.testing.expectEqualStrings("lighting0_main", lighting[0].unique_name);
+    try std.testing.expectEqualStrings("shade", lighting[1].unique_name);
+    try std.testing.expectEqualStrings("shadows_main", shadows[0].unique_name);
+    try std.testing.expectEqualStrings("blur", shadows[1].unique_name);
+    try std.testing.expectEqualStrings("lighting_main", extra[0].unique_name);
+}
+
+test "compile library" {
+    const gpa = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    const shader =
+        \\[shader("compute")]
+        \\[numthreads(1, 1, 1)]
+        \\void main(uniform RWStructuredBuffer<float> output) {{ output[0] = {d}; }}
+        \\
+    ;
+    try tmp.dir.writeFile(.{ .sub_path = "first.slang", .data = std.fmt.comptimePrint(shader, .{1}) });
+    try tmp.dir.writeFile(.{ .sub_path = "second.slang", .data = std.fmt.comptimePrint(shader, .{2}) });
+    const dir = try tmp.dir.realpathAlloc(gpa, ".");
+    defer gpa.free(dir);
+    const search_path = try gpa.dupeZ(u8, dir);
+    defer gpa.free(search_path);
+
+    var global_session = try slang.createGlobalSession(.{});
+    defer global_session.release();
+
+    var result = try compileLibrary(gpa, .{
+        .session_desc = .{
+            .targets = &.{.{ .format = .spirv, .profile = global_session.borrow().findProfile("spirv_1_5") }},
+            .search_paths = &.{search_path},
+        },
+        .modules = &.{ "first", "second" },
+        .thread_count = 2,
+    });
+    defer result.deinit();
+
+    try std.testing.expectEqual(0, result.failed_modules.len);
+    try std.testing.expectEqual(2, result.entry_points.len);
+    for (result.entry_points, [_][]const u8{ "first_main", "second_main" }) |entry_point, unique_name| {
+        try std.testing.expectEqualStrings("main", entry_point.name);
+        try std.testing.expectEqualStrings(unique_name, entry_point.unique_name);
+        try std.testing.expectEqual(.compute, entry_point.stage);
+        try std.testing.expectEqual(1, entry_point.code.len);
+        // The SPIR-V entry point carries the new name
+        const code = entry_point.code[0].?.borrow().getBuffer();
+        try std.testing.expect(std.mem.indexOf(u8, code, unique_name) != null);
+    }
+}
@@ -0,0 +1,401 @@
+//! Reads many compiled shader files at once with io_uring, without blocking on every file.
+//!
+//! The files are read in the order of the access list. Up to `queue_depth` reads are in flight,
+//! and the files a little further down the list are already opened and announced to the kernel
+//! with `fadvise(WILLNEED)`, so their pages are on the way before their reads are submitted. Every
+//! file is handed to the callback as soon as it is complete, as an `IBlob` that owns the buffer the
+//! file was read into, so it can be passed to slang (e.g. `loadModuleFromIRBlob`) without a copy.
+//! Only available on linux.
+
+const std = @import("std");
+const builtin = @import("builtin");
+const linux = std.os.linux;
+const slang = @import("root.zig");
+
+const IUnknown = slang.IUnknown;
+const IBlob = slang.IBlob;
+const UUID = slang.UUID;
+const Result = slang.Result;
+const mcall = slang.mcall;
+
+const log = std.log.scoped(.slang_blob_loader);
+
+/// Alignment of the buffers files are read into, enough to read SPIR-V words in place
+pub const buffer_alignment: std.mem.Alignment = .@"16";
+
+pub const BlobLoader = struct {
+    gpa: std.mem.Allocator,
+    ring: linux.IoUring,
+    options: Options,
+
+    pub const Options = struct {
+        /// Number of reads in flight at once
+        queue_depth: u16 = 64,
+        /// Number of files that are opened and advised ahead of their read, counting the ones in
+        /// flight. Every one of them holds a file descriptor.
+        prefetch_distance: u32 = 128,
+    };
+
+    pub const Request = struct {
+        dir: std.fs.Dir = std.fs.cwd(),
+        path: []const u8,
+    };
+
+    pub const Completion = struct {
+        /// Index into the access list
+        index: usize,
+        /// The callback owns the handle and has to release it
+        result: anyerror!slang.Owned(IBlob),
+    };
+
+    pub const Callback = *const fn (context: ?*anyopaque, completion: Completion) void;
+
+    pub fn init(gpa: std.mem.Allocator, options: Options) !BlobLoader {
+        if (builtin.os.tag != .linux) @compileError("BlobLoader relies on io_uring, which is only available on linux");
+        return BlobLoader{
+            .gpa = gpa,
+            .ring = try linux.IoUring.init(std.math.ceilPowerOfTwoAssert(u16, @max(1, options.queue_depth)), 0),
+            .options = options,
+        };
+    }
+
+    pub fn deinit(self: *BlobLoader) void {
+        self.ring.deinit();
+    }
+
+    /// Reads every file of `requests` and calls `callback` once for each of them, on the calling
+    /// thread, in the order they complete. Returns once all of them are done. Failing to read a
+    /// file is reported through the callback, the error returned is for the ring itself.
+    pub fn load(self: *BlobLoader, requests: []const Request, context: ?*anyopaque, callback: Callback) !void {
+        const queue_depth: usize = self.ring.sq.sqes.len;
+        const prefetch_distance = @max(queue_depth, self.options.prefetch_distance);
+
+        var state = State{
+            .requests = requests,
+            .context = context,
+            .callback = callback,
+            .reads = try self.gpa.alloc(Read, queue_depth),
+            .opened = undefined,
+        };
+        defer self.gpa.free(state.reads);
+        state.opened = try self.gpa.alloc(OpenFile, prefetch_distance);
+        defer self.gpa.free(state.opened);
+        for (state.reads) |*read| read.* = .{};
+        // Anything left after an error is closed without calling the callback again
+        defer state.abort();
+
+        var cqes: [64]linux.io_uring_cqe = undefined;
+        while (state.next_open < requests.len or state.opened_count > 0 or state.in_flight > 0) {
+            while (state.opened_count < prefetch_distance and state.next_open < requests.len) {
+                state.openNext();
+            }
+            while (state.in_flight < queue_depth) {
+                const open_file = state.popOpened() orelse break;
+                try state.startRead(self, open_file);
+            }
+            if (state.in_flight == 0) continue;
+
+            _ = try self.ring.submit();
+            const count = try self.ring.copy_cqes(&cqes, 1);
+            for (cqes[0..count]) |cqe| try state.complete(self, cqe);
+        }
+    }
+
+    const OpenFile = struct {
+        index: usize,
+        file: std.fs.File,
+        size: usize,
+    };
+
+    const Read = struct {
+        active: bool = false,
+        index: usize = 0,
+        file: std.fs.File = undefined,
+        buffer: []align(buffer_alignment.toByteUnits()) u8 = &.{},
+        filled: usize = 0,
+    };
+
+    const State = struct {
+        requests: []const Request,
+        context: ?*anyopaque,
+        callback: Callback,
+        reads: []Read,
+        /// Files that are open but not read yet, a ring buffer in request order
+        opened: []OpenFile,
+        opened_head: usize = 0,
+        opened_count: usize = 0,
+        next_open: usize = 0,
+        in_flight: usize = 0,
+
+        fn openNext(state: *State) void {
+            const index = state.next_open;
+            state.next_open += 1;
+            const request = state.requests[index];
+
+            const file = request.dir.openFile(request.path, .{}) catch |err| return state.fail(index, err);
+            const size = file.getEndPos() catch |err| {
+                file.close();
+                return state.fail(index, err);
+            };
+            // Only a hint, the read works the same without it
+            _ = linux.fadvise(file.handle, 0, 0, linux.POSIX_FADV.WILLNEED);
+            state.opened[(state.opened_head + state.opened_count) % state.opened.len] = .{
+                .index = index,
+                .file = file,
+                .size = @intCast(size),
+            };
+            state.opened_count += 1;
+        }
+
+        fn popOpened(state: *State) ?OpenFile {
+            if (state.opened_count == 0) return null;
+            const open_file = state.opened[state.opened_head];
+            state.opened_head = (state.opened_head + 1) % state.opened.len;
+            state.opened_count -= 1;
+            return open_file;
+        }
+
+        fn startRead(state: *State, loader: *BlobLoader, open_file: OpenFile) !void {
+            const buffer = loader.gpa.alignedAlloc(u8, buffer_alignment, open_file.size) catch |err| {
+                open_file.file.close();
+                return state.fail(open_file.index, err);
+            };
+            if (open_file.size == 0) {
+                open_file.file.close();
+                return state.finish(loader.gpa, open_file.index, buffer);
+            }
+
+            const slot = for (state.reads, 0..) |read, i| {
+                if (!read.active) break i;
+            } else unreachable;
+            state.reads[slot] = .{ .active = true, .index = open_file.index, .file = open_file.file, .buffer = buffer };
+            state.in_flight += 1;
+            try state.submitRead(loader, slot);
+        }
+
+        fn submitRead(state: *State, loader: *BlobLoader, slot: usize) !void {
+            const read = &state.reads[slot];
+            _ = try loader.ring.read(slot, read.file.handle, .{ .buffer = read.buffer[read.filled..] }, read.filled);
+        }
+
+        fn complete(state: *State, loader: *BlobLoader, cqe: linux.io_uring_cqe) !void {
+            const slot: usize = @intCast(cqe.user_data);
+            const read = &state.reads[slot];
+            switch (cqe.err()) {
+                .SUCCESS => {},
+                // Interrupted before anything was read, try again
+                .INTR, .AGAIN => return state.submitRead(loader, slot),
+                else => |errno| {
+                    log.err("reading '{s}' failed: {t}", .{ state.requests[read.index].path, errno });
+                    return state.retire(loader.gpa, slot, error.ReadFailed);
+                },
+            }
+            if (cqe.res == 0) return state.retire(loader.gpa, slot, error.UnexpectedEndOfFile);
+
+            read.filled += @intCast(cqe.res);
+            if (read.filled < read.buffer.len) return state.submitRead(loader, slot);
+
+            const index = read.index;
+            const buffer = read.buffer;
+            read.file.close();
+            read.* = .{};
+            state.in_flight -= 1;
+            state.finish(loader.gpa, index, buffer);
+        }
+
+        fn retire(state: *State, gpa: std.mem.Allocator, slot: usize, err: anyerror) void {
+            const read = &state.reads[slot];
+            const index = read.index;
+            read.file.close();
+            gpa.free(read.buffer);
+            read.* = .{};
+            state.in_flight -= 1;
+            state.fail(index, err);
+        }
+
+        fn finish(state: *State, gpa: std.mem.Allocator, index: usize, buffer: []align(buffer_alignment.toByteUnits()) u8) void {
+            const blob = OwnedBlob.create(gpa, buffer) catch |err| {
+                gpa.free(buffer);
+                return state.fail(index, err);
+            };
+            state.callback(state.context, .{ .index = index, .result = slang.own(&blob.interface) });
+        }
+
+        fn fail(state: *State, index: usize, err: anyerror) void {
+            state.callback(state.context, .{ .index = index, .result = err });
+        }
+
+        fn abort(state: *State) void {
+            while (state.popOpened()) |open_file| open_file.file.close();
+            for (state.reads) |*read| {
+                if (!read.active) continue;
+                // The kernel may still write into the buffer, so it is leaked rather than freed
+                read.file.close();
+                read.* = .{};
+            }
+        }
+    };
+};
+
+/// An `IBlob` that owns a buffer allocated with `buffer_alignment` and frees it on the last
+/// `release`.
+pub const OwnedBlob = struct {
+    interface: IBlob,
+    gpa: std.mem.Allocator,
+    bytes: []align(buffer_alignment.toByteUnits()) u8,
+    ref_count: std.atomic.Value(u32) = .init(1),
+
+    pub fn create(gpa: std.mem.Allocator, bytes: []align(buffer_alignment.toByteUnits()) u8) !*OwnedBlob {
+        const blob = try gpa.create(OwnedBlob);
+        blob.* = OwnedBlob{ .interface = .{ .vtable = &vtable }, .gpa = gpa, .bytes = bytes };
+        return blob;
+    }
+
+    const vtable = IBlob.VTable{
+        .base = .{
+            .queryInterface = &queryInterface,
+            .addRef = &addRef,
+            .release = &release,
+        },
+        .getBufferPointer = &getBufferPointer,
+        .getBufferSize = &getBufferSize,
+    };
+
+    fn fromInterface(this: anytype) *OwnedBlob {
+        return @fieldParentPtr("interface", @as(*IBlob, @ptrCast(this)));
+    }
+
+    fn queryInterface(this: *IUnknown, uuid: *const UUID, out_object: **anyopaque) callconv(mcall) Result {
+        if (!uuid.eql(IUnknown.uuid) and !uuid.eql(IBlob.uuid)) return .no_interface;
+        _ = addRef(this);
+        out_object.* = this;
+        return .ok;
+    }
+
+    fn addRef(this: *IUnknown) callconv(mcall) u32 {
+        return fromInterface(this).ref_count.fetchAdd(1, .monotonic) + 1;
+    }
+
+    fn release(this: *IUnknown) callconv(mcall) u32 {
+        const self = fromInterface(this);
+        const ref_count = self.ref_count.fetchSub(1, .acq_rel) - 1;
+        if (ref_count == 0) {
+            self.gpa.free(self.bytes);
+            self.gpa.destroy(self);
+        }
+        return ref_count;
+    }
+
+    fn getBufferPointer(this: *IBlob) callconv(mcall) ?[*]const u8 {
+        return fromInterface(this).bytes.ptr;
+    }
+
+    fn getBufferSize(this: *IBlob) callconv(mcall) usize {
+        return fromInterface(this).bytes.len;
+    }
+};
+
+/// An `IBlob` over memory owned by someone else, like a slice of a mapped `ShaderArchive`.
+/// Reference counting is a noop, the blob and the memory have to outlive every use by slang.
+pub const SliceBlob = struct {
+    interface: IBlob,
+    bytes: []const u8,
+
+    pub fn init(bytes: []const u8) SliceBlob {
+        return SliceBlob{ .interface = .{ .vtable = &vtable }, .bytes = bytes };
+    }
+
+    pub fn blob(self: *SliceBlob) *IBlob {
+        return &self.interface;
+    }
+
+    const vtable = IBlob.VTable{
+        .base = .{
+            .queryInterface = &queryInterface,
+            .addRef = &addRef,
+            .release = &release,
+        },
+        .getBufferPointer = &getBufferPointer,
+        .getBufferSize = &getBufferSize,
+    };
+
+    fn queryInterface(this: *IUnknown, uuid: *const UUID, out_object: **anyopaque) callconv(mcall) Result {
+        if (!uuid.eql(IUnknown.uuid) and !uuid.eql(IBlob.uuid)) return .no_interface;
+        out_object.* = this;
+        return .ok;
+    }
+
+    fn addRef(_: *IUnknown) callconv(mcall) u32 {
+        return 1;
+    }
+
+    fn release(_: *IUnknown) callconv(mcall) u32 {
+        return 1;
+    }
+
+    fn getBufferPointer(this: *IBlob) callconv(mcall) ?[*]const u8 {
+        const self: *SliceBlob = @fieldParentPtr("interface", this);
+        return self.bytes.ptr;
+    }
+
+    fn getBufferSize(this: *IBlob) callconv(mcall) usize {
+        const self: *SliceBlob = @fieldParentPtr("interface", this);
+        return self.bytes.len;
+    }
+};
+
+test "blob loader" {
+    if (builtin.os.tag != .linux) return error.SkipZigTest;
+
+    const gpa = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    // Larger than a single read is likely to return, so it completes over several of them
+    const large = try gpa.alloc(u8, 4 << 20);
+    defer gpa.free(large);
+    for (large, 0..) |*byte, i| byte.* = @truncate(i *% 7);
+    try tmp.dir.writeFile(.{ .sub_path = "large.bin", .data = large });
+    try tmp.dir.writeFile(.{ .sub_path = "small.bin", .data = "spirv" });
+    try tmp.dir.writeFile(.{ .sub_path = "empty.bin", .data = "" });
+
+    const requests = [_]BlobLoader.Request{
+        .{ .dir = tmp.dir, .path = "large.bin" },
+        .{ .dir = tmp.dir, .path = "missing.bin" },
+        .{ .dir = tmp.dir, .path = "empty.bin" },
+        .{ .dir = tmp.dir, .path = "small.bin" },
+        .{ .dir = tmp.dir, .path = "small.bin" },
+    };
+    const Results = struct {
+        calls: [requests.len]u32 = @splat(0),
+        blobs: [requests.len]?slang.Owned(IBlob) = @splat(null),
+        errors: [requests.len]?anyerror = @splat(null),
+
+        fn record(context: ?*anyopaque, completion: BlobLoader.Completion) void {
+            const results: *@This() = @ptrCast(@alignCast(context.?));
+            results.calls[completion.index] += 1;
+            if (completion.result) |blob| {
+                results.blobs[completion.index] = blob;
+            } else |err| {
+                results.errors[completion.index] = err;
+            }
+        }
+    };
+    var results: Results = .{};
+    defer for (&results.blobs) |*blob| if (blob.*) |*b| b.release();
+
+    // Fewer slots than files, so reads wait for each other
+    var loader = BlobLoader.init(gpa, .{ .queue_depth = 2, .prefetch_distance = 2 }) catch |err| switch (err) {
+        error.SystemOutdated, error.PermissionDenied => return error.SkipZigTest,
+        else => return err,
+    };
+    defer loader.deinit();
+    try loader.load(&requests, &results, Results.record);
+
+    for (results.calls) |calls| try std.testing.expectEqual(1, calls);
+    try std.testing.expectEqualSlices(u8, large, results.blobs[0].?.borrow().getBuffer());
+    try std.testing.expectEqual(error.FileNotFound, results.errors[1].?);
+    try std.testing.expectEqual(0, results.blobs[2].?.borrow().getBufferSize());
+    try std.testing.expectEqualStrings("spirv", results.blobs[3].?.borrow().getBuffer());
+    try std.testing.expectEqualStrings("spirv", results.blobs[4].?.borrow().getBuffer());
+}
@@ -0,0 +1,178 @@
+//! Bookkeeping behind the `track_com_lifetimes` build option.
+//!
+//! Every reference the bindings hand to the caller, either returned through an out parameter or
+//! taken with `addRef`, is counted per object, and every `release` through the bindings takes one
+//! away. The first reference records the stack trace of where the object was handed out, so an
+//! object that is still alive at `shutdown` points straight at the code that leaked it.
+//! References that slang takes and gives back internally are not seen and don't need to be.
+
+const std = @import("std");
+
+const log = std.log.scoped(.slang_com_tracker);
+
+/// Frames kept per object
+const stack_depth = 16;
+
+const Object = struct {
+    references: u32,
+    /// Name of the interface the object was first seen as
+    interface: []const u8,
+    /// Order in which the objects were first seen, so the report lists the oldest leak first
+    sequence: u64,
+    addresses: [stack_depth]usize,
+    address_count: usize,
+};
+
+var mutex: std.Thread.Mutex = .{};
+var objects: std.AutoHashMapUnmanaged(usize, Object) = .empty;
+var next_sequence: u64 = 0;
+/// The bookkeeping must not show up in the allocations of the process it is debugging, and has
+/// to work before any allocator of the caller exists
+const gpa = std.heap.c_allocator;
+
+/// Records a new reference to `object`, `return_address` is the first frame of the trace
+pub fn created(object: anytype, return_address: usize) void {
+    acquire(object, return_address);
+}
+
+pub fn addRef(object: anytype, return_address: usize) void {
+    acquire(object, return_address);
+}
+
+/// Releasing objects that were never handed out, like the ones of `IBlob.init` or borrowed
+/// pointers, is ignored.
+pub fn release(object: anytype) void {
+    mutex.lock();
+    defer mutex.unlock();
+    const entry = objects.getEntry(@intFromPtr(object)) orelse return;
+    entry.value_ptr.references -= 1;
+    if (entry.value_ptr.references == 0) objects.removeByPtr(entry.key_ptr);
+}
+
+pub fn isTracked(object: anytype) bool {
+    mutex.lock();
+    defer mutex.unlock();
+    return objects.contains(@intFromPtr(object));
+}
+
+pub fn liveCount() usize {
+    mutex.lock();
+    defer mutex.unlock();
+    return objects.count();
+}
+
+fn acquire(object: anytype, return_address: usize) void {
+    mutex.lock();
+    defer mutex.unlock();
+    const entry = objects.getOrPut(gpa, @intFromPtr(object)) catch {
+        log.warn("out of memory, the references of {*} are not tracked", .{object});
+        return;
+    };
+    if (entry.found_existing) {
+        entry.value_ptr.references += 1;
+        return;
+    }
+
+    entry.value_ptr.* = Object{
+        .references = 1,
+        .interface = @typeName(@typeInfo(@TypeOf(object)).pointer.child),
+        .sequence = next_sequence,
+        .addresses = undefined,
+        .address_count = 0,
+    };
+    next_sequence += 1;
+    var trace = std.builtin.StackTrace{ .index = 0, .instruction_addresses = &entry.value_ptr.addresses };
+    std.debug.captureStackTrace(return_address, &trace);
+    entry.value_ptr.address_count = @min(trace.index, stack_depth);
+}
+
+/// Writes every object that is still referenced, oldest first, with the stack trace of where it
+/// was handed out.
+pub fn writeLiveObjects(writer: *std.Io.Writer) !void {
+    mutex.lock();
+    defer mutex.unlock();
+
+    const live = try gpa.alloc(Object, objects.count());
+    defer gpa.free(live);
+    const pointers = try gpa.alloc(usize, objects.count());
+    defer gpa.free(pointers);
+    var it = objects.iterator();
+    var i: usize = 0;
+    while (it.next()) |entry| : (i += 1) {
+        live[i] = entry.value_ptr.*;
+        pointers[i] = entry.key_ptr.*;
+    }
+    const Context = struct {
+        live: []Object,
+        pointers: []usize,
+
+        pub fn lessThan(ctx: @This(), a: usize, b: usize) bool {
+            return ctx.live[a].sequence < ctx.live[b].sequence;
+        }
+
+        pub fn swap(ctx: @This(), a: usize, b: usize) void {
+            std.mem.swap(Object, &ctx.live[a], &ctx.live[b]);
+            std.mem.swap(usize, &ctx.pointers[a], &ctx.pointers[b]);
+        }
+    };
+    std.sort.pdqContext(0, live.len, Context{ .live = live, .pointers = pointers });
+
+    try writer.print("{d} COM objects are still alive\n", .{live.len});
+    const debug_info = std.debug.getSelfDebugInfo() catch null;
+    for (live, pointers) |*object, pointer| {
+        try writer.print("\n{s}@{x} with {d} reference{s}, handed out at:\n", .{
+            object.interface,
+            pointer,
+            object.references,
+            if (object.references == 1) "" else "s",
+        });
+        const trace = std.builtin.StackTrace{
+            .index = object.address_count,
+            .instruction_addresses = object.addresses[0..object.address_count],
+        };
+        if (debug_info) |info| {
+            try std.debug.writeStackTrace(trace, writer, info, .no_color);
+        } else for (trace.instruction_addresses) |instruction| {
+            try writer.print("    0x{x}\n", .{instruction});
+        }
+    }
+}
+
+/// `writeLiveObjects` to the log, when there are any
+pub fn logLiveObjects() void {
+    if (liveCount() == 0) return;
+    var output: std.Io.Writer.Allocating = .init(gpa);
+    defer output.deinit();
+    writeLiveObjects(&output.writer) catch |err| {
+        log.err("unable to list the live objects: {s}", .{@errorName(err)});
+        return;
+    };
+    log.err("{s}", .{output.written()});
+}
+
+test "com tracker" {
+    const Dummy = struct { vtable: usize };
+    var first = Dummy{ .vtable = 0 };
+    var second = Dummy{ .vtable = 0 };
+    const count = liveCount();
+
+    created(&first, @returnAddress());
+    addRef(&first, @returnAddress());
+    created(&second, @returnAddress());
+    try std.testing.expectEqual(count + 2, liveCount());
+
+    release(&first);
+    try std.testing.expect(isTracked(&first));
+    release(&first);
+    try std.testing.expect(!isTracked(&first));
+
+    var output: std.Io.Writer.Allocating = .init(std.testing.allocator);
+    defer output.deinit();
+    try writeLiveObjects(&output.writer);
+    try std.testing.expect(std.mem.indexOf(u8, output.written(), "Dummy@") != null);
+
+    release(&second);
+    // Untracked objects are ignored
+    release(&second);
+    try std.testing.expectEqual(count, liveCount());
+}
@@ -0,0 +1,183 @@
+//! Index over the declarations of a module, for tools that look declarations up repeatedly.
+//!
+//! Walking `DeclReflection` costs a slang call for every child, and finding a declaration by name
+//! or kind means scanning all of them. The index walks the tree once, on the first query, and
+//! answers every query after that from its own tables. The declarations are owned by the module,
+//! the index has to be dropped before the module is released.
+
+const std = @import("std");
+const slang = @import("root.zig");
+
+const IModule = slang.IModule;
+const DeclReflection = slang.DeclReflection;
+const DeclKind = slang.DeclKind;
+
+pub const DeclIndex = struct {
+    gpa: std.mem.Allocator,
+    root: *DeclReflection,
+    built: bool = false,
+    /// Every declaration in breadth first order, so the children of a declaration are next to
+    /// each other. The root is the first one.
+    decls: std.ArrayList(*DeclReflection) = .empty,
+    nodes: std.ArrayList(Node) = .empty,
+    positions: std.AutoHashMapUnmanaged(*DeclReflection, u32) = .empty,
+    /// The first declaration with a given name, the others are chained through `Node.next_same_name`
+    names: std.StringHashMapUnmanaged(u32) = .empty,
+    kinds: std.EnumArray(DeclKind, std.ArrayList(*DeclReflection)) = .initFill(.empty),
+
+    const Node = struct {
+        name: []const u8,
+        parent: u32,
+        first_child: u32 = 0,
+        child_count: u32 = 0,
+        next_same_name: u32 = none,
+    };
+
+    const none = std.math.maxInt(u32);
+
+    pub fn init(gpa: std.mem.Allocator, module: *IModule) DeclIndex {
+        return initDecl(gpa, module.getModuleReflection());
+    }
+
+    /// Indexes the declarations below `root` instead of a whole module.
+    pub fn initDecl(gpa: std.mem.Allocator, root: *DeclReflection) DeclIndex {
+        return DeclIndex{ .gpa = gpa, .root = root };
+    }
+
+    pub fn deinit(self: *DeclIndex) void {
+        self.decls.deinit(self.gpa);
+        self.nodes.deinit(self.gpa);
+        self.positions.deinit(self.gpa);
+        self.names.deinit(self.gpa);
+        for (&self.kinds.values) |*list| list.deinit(self.gpa);
+    }
+
+    /// The first declaration named `name` in breadth first order, so outer declarations win over
+    /// nested ones.
+    pub fn find(self: *DeclIndex, name: []const u8) !?*DeclReflection {
+        try self.build();
+        const index = self.names.get(name) orelse return null;
+        return self.decls.items[index];
+    }
+
+    /// Every declaration named `name`, like the overloads of a function.
+    pub fn findAll(self: *DeclIndex, name: []const u8) !NameIterator {
+        try self.build();
+        return NameIterator{ .index = self, .next_index = self.names.get(name) orelse none };
+    }
+
+    pub const NameIterator = struct {
+        index: *const DeclIndex,
+        next_index: u32,
+
+        pub fn next(self: *NameIterator) ?*DeclReflection {
+            if (self.next_index == none) return null;
+            defer self.next_index = self.index.nodes.items[self.next_index].next_same_name;
+            return self.index.decls.items[self.next_index];
+        }
+    };
+
+    /// Every declaration of `kind` at any depth, in breadth first order.
+    pub fn ofKind(self: *DeclIndex, kind: DeclKind) ![]const *DeclReflection {
+        try self.build();
+        return self.kinds.get(kind).items;
+    }
+
+    pub fn children(self: *DeclIndex, decl: *DeclReflection) ![]const *DeclReflection {
+        const node = self.nodes.items[try self.position(decl)];
+        return self.decls.items[node.first_child..][0..node.child_count];
+    }
+
+    /// Null for the root of the index.
+    pub fn parent(self: *DeclIndex, decl: *DeclReflection) !?*DeclReflection {
+        const node = self.nodes.items[try self.position(decl)];
+        if (node.parent == none) return null;
+        return self.decls.items[node.parent];
+    }
+
+    pub fn count(self: *DeclIndex) !usize {
+        try self.build();
+        return self.decls.items.len;
+    }
+
+    fn position(self: *DeclIndex, decl: *DeclReflection) !u32 {
+        try self.build();
+        return self.positions.get(decl) orelse error.DeclNotIndexed;
+    }
+
+    fn build(self: *DeclIndex) !void {
+        if (self.built) return;
+        errdefer self.clear();
+
+        try self.append(self.root, none);
+        var index: u32 = 0;
+        while (index < self.decls.items.len) : (index += 1) {
+            const decl = self.decls.items[index];
+            const child_count = decl.getChildrenCount();
+            self.nodes.items[index].first_child = @intCast(self.decls.items.len);
+            self.nodes.items[index].child_count = child_count;
+            for (0..child_count) |child_index| {
+                try self.append(decl.getChild(@intCast(child_index)), index);
+            }
+        }
+
+        // Walking backwards leaves the chains of equal names in breadth first order
+        var i = self.nodes.items.len;
+        while (i > 0) {
+            i -= 1;
+            const node = &self.nodes.items[i];
+            const entry = try self.names.getOrPut(self.gpa, node.name);
+            node.next_same_name = if (entry.found_existing) entry.value_ptr.* else none;
+            entry.value_ptr.* = @intCast(i);
+        }
+        self.built = true;
+    }
+
+    fn append(self: *DeclIndex, decl: *DeclReflection, parent_index: u32) !void {
+        const index: u32 = @intCast(self.decls.items.len);
+        const name: []const u8 = if (decl.getName()) |ptr| std.mem.span(ptr) else "";
+        try self.decls.append(self.gpa, decl);
+        try self.nodes.append(self.gpa, .{ .name = name, .parent = parent_index });
+        try self.positions.put(self.gpa, decl, index);
+        try self.kinds.getPtr(decl.getKind()).append(self.gpa, decl);
+    }
+
+    fn clear(self: *DeclIndex) void {
+        self.decls.clearRetainingCapacity();
+        self.nodes.clearRetainingCapacity();
+        self.positions.clearRetainingCapacity();
+        self.names.clearRetainingCapacity();
+        for (&self.kinds.values) |*list| list.clearRetainingCapacity();
+    }
+};
+
+test "decl index" {
+    var global_session = try slang.createGlobalSession(.{});
+    defer global_session.release();
+    var session = try global_session.borrow().createSession(.{});
+    defer session.release();
+
+    const source =
+        \\struct Light { float3 color; float intensity; }
+        \\float shade(Light light) { return light.intensity; }
+        \\float shade(Light light, float scale) { return light.intensity * scale; }
+    ;
+    var module = session.borrow().loadModuleFromSourceString("decl_index", "decl_index.slang", source, null) orelse return error.ModuleLoadFailed;
+    defer module.release();
+
+    var index = DeclIndex.init(std.testing.allocator, module.borrow());
+    defer index.deinit();
+
+    const light = (try index.find("Light")) orelse return error.TestUnexpectedResult;
+    try std.testing.expectEqual(DeclKind.@"struct", light.getKind());
+    try std.testing.expectEqual(index.root, (try index.parent(light)).?);
+    const intensity = (try index.find("intensity")) orelse return error.TestUnexpectedResult;
+    try std.testing.expectEqual(light, (try index.parent(intensity)).?);
+    try std.testing.expect(std.mem.indexOfScalar(*DeclReflection, try index.children(light), intensity) != null);
+
+    var overloads = try index.findAll("shade");
+    var overload_count: usize = 0;
+    while (overloads.next()) |_| overload_count += 1;
+    try std.testing.expectEqual(2, overload_count);
+    try std.testing.expectEqual(2, (try index.ofKind(.func)).len);
+}
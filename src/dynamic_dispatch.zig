@@ -0,0 +1,195 @@
+//! Batching helpers for `dyn interface` shader data.
+//!
+//! Uploading polymorphic objects needs the RTTI header, the witness table ID and the layout of
+//! every concrete type. Querying those through `ISession` for each object is slow, so
+//! `DynamicTypeTable` resolves everything for a whole set of conforming types up front and
+//! `ObjectPacker` uses the cached results to lay objects out in a single buffer.
+
+const std = @import("std");
+const slang = @import("root.zig");
+
+const ISession = slang.ISession;
+const IBlob = slang.IBlob;
+const IComponentType = slang.IComponentType;
+const TypeReflection = slang.TypeReflection;
+const TypeLayoutReflection = slang.TypeLayoutReflection;
+
+/// Size of the header slang expects in front of every dynamic object. The first 8 bytes hold the
+/// RTTI pointer, the next 4 bytes hold the sequential ID of the type conformance witness.
+pub const rtti_header_size = 16;
+
+pub const DynamicTypeTable = struct {
+    interface_type: *TypeReflection,
+    /// A composite of the type conformances for every type in the table. Link it together with
+    /// the program that uses the interface so the witness tables get generated.
+    conformances: slang.Owned(IComponentType),
+    entries: std.AutoHashMapUnmanaged(*TypeReflection, Entry),
+
+    pub const Entry = struct {
+        rtti: [rtti_header_size / 4]u32,
+        witness_id: u32,
+        layout: *TypeLayoutReflection,
+        size: usize,
+        alignment: usize,
+    };
+
+    pub const Options = struct {
+        target_index: i64 = 0,
+        rules: slang.LayoutRules = .default,
+    };
+
+    /// Creates one type conformance per concrete type, composes them and caches the RTTI bytes,
+    /// witness IDs and layouts of every type. Witness IDs are assigned in the order of
+    /// `concrete_types` so they stay stable between runs.
+    pub fn init(
+        gpa: std.mem.Allocator,
+        session: *ISession,
+        interface_type: *TypeReflection,
+        concrete_types: []const *TypeReflection,
+        options: Options,
+        out_diagnostics: ?**IBlob,
+    ) !DynamicTypeTable {
+        var entries: std.AutoHashMapUnmanaged(*TypeReflection, Entry) = .empty;
+        errdefer entries.deinit(gpa);
+        try entries.ensureTotalCapacity(gpa, @intCast(concrete_types.len));
+
+        const components = try gpa.alloc(*IComponentType, concrete_types.len);
+        defer gpa.free(components);
+
+        var created: usize = 0;
+        defer for (components[0..created]) |component| component.release();
+
+        for (concrete_types, 0..) |concrete_type, i| {
+            var conformance = try session.createTypeConformanceComponentType(concrete_type, interface_type, @intCast(i), out_diagnostics);
+            components[i] = @ptrCast(conformance.leak());
+            created += 1;
+        }
+        var conformances = try session.createCompositeComponentType(components, out_diagnostics);
+        errdefer conformances.release();
+
+        for (concrete_types) |concrete_type| {
+            var entry: Entry = undefined;
+            try session.getDynamicObjectRTTIBytes(concrete_type, interface_type, &entry.rtti);
+            entry.witness_id = try session.getTypeConformanceWitnessSequentialID(concrete_type, interface_type);
+            entry.layout = session.getTypeLayout(concrete_type, options.target_index, options.rules, out_diagnostics);
+            entry.size = entry.layout.getSize(.uniform);
+            entry.alignment = @intCast(@max(1, entry.layout.getAlignment(.uniform)));
+            entries.putAssumeCapacity(concrete_type, entry);
+        }
+
+        return DynamicTypeTable{
+            .interface_type = interface_type,
+            .conformances = conformances,
+            .entries = entries,
+        };
+    }
+
+    pub fn deinit(self: *DynamicTypeTable, gpa: std.mem.Allocator) void {
+        self.conformances.release();
+        self.entries.deinit(gpa);
+    }
+
+    pub fn get(self: *const DynamicTypeTable, concrete_type: *TypeReflection) ?*const Entry {
+        return self.entries.getPtr(concrete_type);
+    }
+};
+
+/// Packs heterogeneous objects into a single buffer. Every object is stored as the RTTI header
+/// followed by its payload, with both aligned to the alignment reported by the type layout.
+pub const ObjectPacker = struct {
+    table: *const DynamicTypeTable,
+    bytes: std.ArrayList(u8) = .empty,
+
+    pub fn init(table: *const DynamicTypeTable) ObjectPacker {
+        return ObjectPacker{ .table = table };
+    }
+
+    pub fn deinit(self: *ObjectPacker, gpa: std.mem.Allocator) void {
+        self.bytes.deinit(gpa);
+    }
+
+    /// Discards the packed objects but keeps the memory around for the next upload.
+    pub fn reset(self: *ObjectPacker) void {
+        self.bytes.clearRetainingCapacity();
+    }
+
+    /// Appends a single object and returns the byte offset of its header. `payload` must already
+    /// follow the layout of `concrete_type`, and may be shorter than the layout size in which
+    /// case the rest is zero filled.
+    pub fn append(self: *ObjectPacker, gpa: std.mem.Allocator, concrete_type: *TypeReflection, payload: []const u8) !u32 {
+        const entry = self.table.get(concrete_type) orelse return error.UnknownType;
+        if (payload.len > entry.size) return error.PayloadTooLarge;
+
+        try self.bytes.ensureUnusedCapacity(gpa, recordStride(entry.*) + @max(entry.alignment, 4));
+        return self.appendAssumeCapacity(entry.*, payload);
+    }
+
+    /// Appends `count` objects of the same type, read from `payloads` with a stride equal to the
+    /// layout size. Returns the offset of the first header, the rest follow at `recordStride`.
+    pub fn appendMany(self: *ObjectPacker, gpa: std.mem.Allocator, concrete_type: *TypeReflection, payloads: []const u8, count: usize) !u32 {
+        const entry = self.table.get(concrete_type) orelse return error.UnknownType;
+        if (payloads.len != entry.size * count) return error.PayloadSizeMismatch;
+        if (count == 0) return @intCast(self.bytes.items.len);
+
+        try self.bytes.ensureUnusedCapacity(gpa, recordStride(entry.*) * count + @max(entry.alignment, 4));
+        const first = self.appendAssumeCapacity(entry.*, payloads[0..entry.size]);
+        for (1..count) |i| {
+            _ = self.appendAssumeCapacity(entry.*, payloads[i * entry.size ..][0..entry.size]);
+        }
+        return first;
+    }
+
+    /// The distance between two consecutive objects of the same type.
+    pub fn recordStride(entry: DynamicTypeTable.Entry) usize {
+        const payload_offset = std.mem.alignForward(usize, rtti_header_size, entry.alignment);
+        return std.mem.alignForward(usize, payload_offset + entry.size, @max(entry.alignment, 4));
+    }
+
+    pub fn items(self: *const ObjectPacker) []const u8 {
+        return self.bytes.items;
+    }
+
+    fn appendAssumeCapacity(self: *ObjectPacker, entry: DynamicTypeTable.Entry, payload: []const u8) u32 {
+        const record_offset = std.mem.alignForward(usize, self.bytes.items.len, @max(entry.alignment, 4));
+        const payload_offset = record_offset + std.mem.alignForward(usize, rtti_header_size, entry.alignment);
+        const record_end = record_offset + recordStride(entry);
+
+        const old_len = self.bytes.items.len;
+        self.bytes.items.len = record_end;
+        @memset(self.bytes.items[old_len..record_end], 0);
+
+        @memcpy(self.bytes.items[record_offset..][0..rtti_header_size], std.mem.asBytes(&entry.rtti));
+        @memcpy(self.bytes.items[payload_offset..][0..payload.len], payload);
+        return @intCast(record_offset);
+    }
+};
+
+test "object packing" {
+    const gpa = std.testing.allocator;
+
+    var table = DynamicTypeTable{
+        .interface_type = undefined,
+        .conformances = undefined,
+        .entries = .empty,
+    };
+    defer table.entries.deinit(gpa);
+
+    const type_a: *TypeReflection = @ptrFromInt(0x1000);
+    const type_b: *TypeReflection = @ptrFromInt(0x2000);
+    try table.entries.put(gpa, type_a, .{ .rtti = .{ 0, 0, 1, 0 }, .witness_id = 1, .layout = undefined, .size = 4, .alignment = 4 });
+    try table.entries.put(gpa, type_b, .{ .rtti = .{ 0, 0, 2, 0 }, .witness_id = 2, .layout = undefined, .size = 32, .alignment = 32 });
+
+    var packer = ObjectPacker.init(&table);
+    defer packer.deinit(gpa);
+
+    try std.testing.expectEqual(0, try packer.append(gpa, type_a, &.{ 1, 2, 3, 4 }));
+    try std.testing.expectEqual(32, try packer.append(gpa, type_b, &([_]u8{7} ** 32)));
+    try std.testing.expectEqual(96, try packer.appendMany(gpa, type_a, &([_]u8{9} ** 8), 2));
+    try std.testing.expectEqual(136, packer.items().len);
+
+    const bytes = packer.items();
+    try std.testing.expectEqual(2, std.mem.readInt(u32, bytes[40..44], .little));
+    try std.testing.expectEqualSlices(u8, &.{ 1, 2, 3, 4 }, bytes[16..20]);
+    try std.testing.expectEqual(7, bytes[64]);
+    try std.testing.expectError(error.UnknownType, packer.append(gpa, @ptrFromInt(0x3000), &.{}));
+}
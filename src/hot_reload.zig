@@ -0,0 +1,368 @@
+//! Recompiles shaders while the application is running, when one of their source files changes.
+//!
+//! The directories of every file a program depends on, as reported by
+//! `IModule.getDependencyFilePath`, are watched with inotify. `poll` reads the pending events
+//! without blocking. When a file changed, only the programs that depend on it are rebuilt, all of
+//! them in one fresh `ISession`, since a session never reloads a module it has already loaded.
+//! Programs whose files did not change keep their old linked program and session. Entry points
+//! are only handed to the callback when `getEntryPointHash` differs from the last build, so an
+//! edit that does not change the code of a pipeline does not recreate it.
+//!
+//! A failed rebuild is logged and the program keeps its last working code.
+//! Only available on linux.
+
+const std = @import("std");
+const builtin = @import("builtin");
+const linux = std.os.linux;
+const slang = @import("root.zig");
+
+const IGlobalSession = slang.IGlobalSession;
+const ISession = slang.ISession;
+const IComponentType = slang.IComponentType;
+const IBlob = slang.IBlob;
+const Owned = slang.Owned;
+const SessionDesc = slang.SessionDesc;
+
+const log = std.log.scoped(.slang_hot_reload);
+
+pub const HotReloader = struct {
+    gpa: std.mem.Allocator,
+    global_session: *IGlobalSession,
+    /// Has to stay valid for as long as the reloader, every rebuild creates a session from it
+    session_desc: SessionDesc,
+    callback: Callback,
+    context: ?*anyopaque,
+    inotify_fd: i32,
+    programs: std.ArrayList(Program) = .empty,
+    /// Watched directory by watch descriptor, the paths are absolute
+    watches: std.AutoHashMapUnmanaged(i32, []const u8) = .empty,
+    watched_dirs: std.StringHashMapUnmanaged(void) = .empty,
+
+    pub const ProgramId = enum(u32) { _ };
+
+    pub const ProgramDesc = struct {
+        /// Name or path of the module, as given to `ISession.loadModule`
+        module_name: []const u8,
+        /// Defaults to every entry point marked with `[shader(...)]`
+        entry_points: []const []const u8 = &.{},
+    };
+
+    pub const Update = struct {
+        program: ProgramId,
+        entry_point_index: u32,
+        target_index: u32,
+        /// Only valid during the callback, take a reference with `Owned(IBlob).retain` to keep it
+        code: *IBlob,
+    };
+
+    pub const Callback = *const fn (context: ?*anyopaque, update: Update) void;
+
+    const Program = struct {
+        module_name: [:0]const u8,
+        entry_points: []const [:0]const u8,
+        session: ?Owned(ISession) = null,
+        linked: ?Owned(IComponentType) = null,
+        entry_point_count: u32 = 0,
+        /// Hash of every entry point and target pair, entry point major
+        hashes: []const []const u8 = &.{},
+        /// Absolute paths
+        dependencies: []const []const u8 = &.{},
+        dirty: bool = false,
+    };
+
+    pub fn init(
+        gpa: std.mem.Allocator,
+        global_session: *IGlobalSession,
+        session_desc: SessionDesc,
+        context: ?*anyopaque,
+        callback: Callback,
+    ) !HotReloader {
+        if (builtin.os.tag != .linux) @compileError("HotReloader relies on inotify, which is only available on linux");
+        const flags = linux.IN.NONBLOCK | linux.IN.CLOEXEC;
+        return HotReloader{
+            .gpa = gpa,
+            .global_session = global_session,
+            .session_desc = session_desc,
+            .callback = callback,
+            .context = context,
+            .inotify_fd = try std.posix.inotify_init1(flags),
+        };
+    }
+
+    pub fn deinit(self: *HotReloader) void {
+        for (self.programs.items) |*program| {
+            self.releaseBuild(program);
+            self.gpa.free(program.module_name);
+            for (program.entry_points) |name| self.gpa.free(name);
+            self.gpa.free(program.entry_points);
+        }
+        self.programs.deinit(self.gpa);
+        var dirs = self.watched_dirs.keyIterator();
+        while (dirs.next()) |dir| self.gpa.free(dir.*);
+        self.watched_dirs.deinit(self.gpa);
+        self.watches.deinit(self.gpa);
+        std.posix.close(self.inotify_fd);
+    }
+
+    /// For waiting on changes with `poll` or `epoll` instead of calling `poll` every frame.
+    pub fn fd(self: *const HotReloader) i32 {
+        return self.inotify_fd;
+    }
+
+    /// Builds the program and calls the callback for every entry point and target.
+    pub fn addProgram(self: *HotReloader, desc: ProgramDesc) !ProgramId {
+        const module_name = try self.gpa.dupeZ(u8, desc.module_name);
+        errdefer self.gpa.free(module_name);
+
+        const entry_points = try self.gpa.alloc([:0]const u8, desc.entry_points.len);
+        var duped: usize = 0;
+        errdefer {
+            for (entry_points[0..duped]) |name| self.gpa.free(name);
+            self.gpa.free(entry_points);
+        }
+        for (entry_points, desc.entry_points) |*copy, name| {
+            copy.* = try self.gpa.dupeZ(u8, name);
+            duped += 1;
+        }
+
+        var session = try self.global_session.createSession(self.session_desc);
+        defer session.release();
+
+        // The callback sees the id during the build, so nothing may fail after it
+        try self.programs.ensureUnusedCapacity(self.gpa, 1);
+        var program = Program{ .module_name = module_name, .entry_points = entry_points };
+        const id: ProgramId = @enumFromInt(self.programs.items.len);
+        try self.build(&program, id, session.borrow());
+        self.programs.appendAssumeCapacity(program);
+        return id;
+    }
+
+    /// Reads the pending file events without blocking and rebuilds the programs that depend on
+    /// the changed files. Returns the number of programs that were rebuilt successfully.
+    pub fn poll(self: *HotReloader) !usize {
+        var buffer: [16 * 1024]u8 align(@alignOf(linux.inotify_event)) = undefined;
+        var any_dirty = false;
+        while (true) {
+            const len = std.posix.read(self.inotify_fd, &buffer) catch |err| switch (err) {
+                error.WouldBlock => break,
+                else => |e| return e,
+            };
+            if (len == 0) break;
+
+            var offset: usize = 0;
+            while (offset < len) {
+                const event: *const linux.inotify_event = @ptrCast(@alignCast(&buffer[offset]));
+                const name_bytes = buffer[offset + @sizeOf(linux.inotify_event) ..][0..event.len];
+                offset += @sizeOf(linux.inotify_event) + event.len;
+
+                const dir = self.watches.get(event.wd) orelse continue;
+                const name = std.mem.sliceTo(name_bytes, 0);
+                if (self.markDirty(dir, name)) any_dirty = true;
+            }
+        }
+        if (!any_dirty) return 0;
+
+        // One session for the whole batch, so a header shared by several programs is only
+        // parsed once
+        var session = try self.global_session.createSession(self.session_desc);
+        defer session.release();
+
+        var rebuilt: usize = 0;
+        for (self.programs.items, 0..) |*program, index| {
+            if (!program.dirty) continue;
+            program.dirty = false;
+            self.build(program, @enumFromInt(index), session.borrow()) catch |err| {
+                log.err("rebuilding '{s}' failed, keeping the previous code: {s}", .{ program.module_name, @errorName(err) });
+                continue;
+            };
+            rebuilt += 1;
+        }
+        return rebuilt;
+    }
+
+    fn markDirty(self: *HotReloader, dir: []const u8, name: []const u8) bool {
+        var marked = false;
+        for (self.programs.items) |*program| {
+            for (program.dependencies) |path| {
+                const path_dir = std.fs.path.dirname(path) orelse continue;
+                if (std.mem.eql(u8, path_dir, dir) and std.mem.eql(u8, std.fs.path.basename(path), name)) {
+                    program.dirty = true;
+                    marked = true;
+                    break;
+                }
+            }
+        }
+        return marked;
+    }
+
+    /// Replaces the build of `program` with one from `session`, only when everything succeeded.
+    fn build(self: *HotReloader, program: *Program, id: ProgramId, session: *ISession) !void {
+        var module = session.loadModule(program.module_name, null) orelse return error.ModuleLoadFailed;
+        defer module.release();
+
+        var components: std.ArrayList(*IComponentType) = .empty;
+        try components.append(self.gpa, @ptrCast(module.borrow()));
+        defer {
+            for (components.items[1..]) |component| component.release();
+            components.deinit(self.gpa);
+        }
+        if (program.entry_points.len == 0) {
+            for (0..@intCast(module.borrow().getDefinedEntryPointCount())) |index| {
+                try components.ensureUnusedCapacity(self.gpa, 1);
+                var entry_point = try module.borrow().getDefinedEntryPoint(@intCast(index));
+                components.appendAssumeCapacity(@ptrCast(entry_point.leak()));
+            }
+        } else for (program.entry_points) |name| {
+            try components.ensureUnusedCapacity(self.gpa, 1);
+            var entry_point = try module.borrow().findEntryPointByName(name);
+            components.appendAssumeCapacity(@ptrCast(entry_point.leak()));
+        }
+
+        var composite = try session.createCompositeComponentType(components.items, null);
+        defer composite.release();
+        var linked = try composite.borrow().link(null);
+        errdefer linked.release();
+
+        const entry_point_count: u32 = @intCast(components.items.len - 1);
+        const target_count: u32 = @intCast(self.session_desc.targets.len);
+
+        const hashes = try self.gpa.alloc([]const u8, entry_point_count * target_count);
+        var hashed: usize = 0;
+        errdefer freePaths(self.gpa, hashes[0..hashed], hashes);
+
+        var changed: std.ArrayList(Update) = .empty;
+        defer {
+            for (changed.items) |update| update.code.release();
+            changed.deinit(self.gpa);
+        }
+        for (0..entry_point_count) |entry_point_index| {
+            for (0..target_count) |target_index| {
+                var hash_blob = linked.borrow().getEntryPointHash(@intCast(entry_point_index), @intCast(target_index));
+                defer hash_blob.release();
+                const slot = entry_point_index * target_count + target_index;
+                hashes[slot] = try self.gpa.dupe(u8, hash_blob.borrow().getBuffer());
+                hashed += 1;
+
+                const unchanged = entry_point_count == program.entry_point_count and
+                    std.mem.eql(u8, hashes[slot], program.hashes[slot]);
+                if (unchanged) continue;
+
+                try changed.ensureUnusedCapacity(self.gpa, 1);
+                var code = try linked.borrow().getEntryPointCode(@intCast(entry_point_index), @intCast(target_index), null);
+                changed.appendAssumeCapacity(.{
+                    .program = id,
+                    .entry_point_index = @intCast(entry_point_index),
+                    .target_index = @intCast(target_index),
+                    .code = code.leak(),
+                });
+            }
+        }
+
+        const dependencies = try self.gpa.alloc([]const u8, @intCast(module.borrow().getDependencyFileCount()));
+        var resolved: usize = 0;
+        errdefer freePaths(self.gpa, dependencies[0..resolved], dependencies);
+        for (dependencies, 0..) |*path, index| {
+            path.* = try std.fs.cwd().realpathAlloc(self.gpa, std.mem.span(module.borrow().getDependencyFilePath(@intCast(index))));
+            resolved += 1;
+        }
+        try self.watch(dependencies);
+
+        // Everything succeeded, swap in the new build
+        self.releaseBuild(program);
+        program.session = Owned(ISession).retain(session);
+        program.linked = linked;
+        program.entry_point_count = entry_point_count;
+        program.hashes = hashes;
+        program.dependencies = dependencies;
+
+        for (changed.items) |update| self.callback(self.context, update);
+    }
+
+    fn releaseBuild(self: *HotReloader, program: *Program) void {
+        if (program.linked) |*linked| linked.release();
+        if (program.session) |*session| session.release();
+        freePaths(self.gpa, program.hashes, program.hashes);
+        freePaths(self.gpa, program.dependencies, program.dependencies);
+        program.linked = null;
+        program.session = null;
+        program.hashes = &.{};
+        program.dependencies = &.{};
+    }
+
+    fn watch(self: *HotReloader, paths: []const []const u8) !void {
+        const mask = linux.IN.CLOSE_WRITE | linux.IN.MOVED_TO | linux.IN.CREATE;
+        for (paths) |path| {
+            // Editors often save by renaming a new file over the old one, which would drop a
+            // watch on the file itself, so the directory is watched instead
+            const dir = std.fs.path.dirname(path) orelse continue;
+            if (self.watched_dirs.contains(dir)) continue;
+
+            const owned_dir = try self.gpa.dupe(u8, dir);
+            errdefer self.gpa.free(owned_dir);
+            const wd = try std.posix.inotify_add_watch(self.inotify_fd, owned_dir, mask);
+            try self.watched_dirs.put(self.gpa, owned_dir, {});
+            errdefer _ = self.watched_dirs.remove(owned_dir);
+            try self.watches.put(self.gpa, wd, owned_dir);
+        }
+    }
+};
+
+/// Frees the first `filled` strings and the whole `slice`.
+fn freePaths(gpa: std.mem.Allocator, filled: []const []const u8, slice: []const []const u8) void {
+    for (filled) |path| gpa.free(path);
+    gpa.free(slice);
+}
+
+test "hot reloader" {
+    if (builtin.os.tag != .linux) return error.SkipZigTest;
+
+    const gpa = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    const shader =
+        \\[shader("compute")]
+        \\[numthreads(1, 1, 1)]
+        \\void main(uniform RWStructuredBuffer<float> output) {{ output[0] = {d}; }}
+        \\
+    ;
+    try tmp.dir.writeFile(.{ .sub_path = "reload.slang", .data = std.fmt.comptimePrint(shader, .{1}) });
+    const dir = try tmp.dir.realpathAlloc(gpa, ".");
+    defer gpa.free(dir);
+    const search_path = try gpa.dupeZ(u8, dir);
+    defer gpa.free(search_path);
+
+    var global_session = try slang.createGlobalSession(.{});
+    defer global_session.release();
+
+    const Updates = struct {
+        count: usize = 0,
+        program: ?HotReloader.ProgramId = null,
+
+        fn record(context: ?*anyopaque, update: HotReloader.Update) void {
+            const updates: *@This() = @ptrCast(@alignCast(context.?));
+            updates.count += 1;
+            updates.program = update.program;
+        }
+    };
+    var updates: Updates = .{};
+    var reloader = try HotReloader.init(gpa, global_session.borrow(), .{
+        .targets = &.{.{ .format = .spirv, .profile = global_session.borrow().findProfile("spirv_1_5") }},
+        .search_paths = &.{search_path},
+    }, &updates, Updates.record);
+    defer reloader.deinit();
+
+    const id = try reloader.addProgram(.{ .module_name = "reload" });
+    try std.testing.expectEqual(1, updates.count);
+    try std.testing.expectEqual(id, updates.program.?);
+    try std.testing.expectEqual(0, try reloader.poll());
+
+    try tmp.dir.writeFile(.{ .sub_path = "reload.slang", .data = std.fmt.comptimePrint(shader, .{2}) });
+    try std.testing.expectEqual(1, try reloader.poll());
+    try std.testing.expectEqual(2, updates.count);
+
+    // A file the program doesn't depend on changes nothing
+    try tmp.dir.writeFile(.{ .sub_path = "other.slang", .data = "" });
+    try std.testing.expectEqual(0, try reloader.poll());
+    try std.testing.expectEqual(2, updates.count);
+}
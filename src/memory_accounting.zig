@@ -0,0 +1,505 @@
+//! Attributes memory growth to sessions, jobs and compile phases, and exports it as Prometheus
+//! counters.
+//!
+//! Sessions created through `MemoryAccounting.createSession` are wrapped in a `SessionAccount`,
+//! whose `loadModule`, `link` and `getEntryPointCode` sample the resident set size and the heap
+//! in use before and after the call and add the growth to the session, to the job that is active
+//! on the session, and to the phase. The heap in use comes from `mallinfo2` with glibc, which
+//! also sees the allocations of slang itself, and is zero elsewhere. Both are process wide, so
+//! phases running on other threads at the same time are counted as well.
+//!
+//! The account also tracks how many modules the session has loaded and how many of the component
+//! types and blobs it returned are still alive, which is what to watch when deciding when to
+//! recycle a session.
+
+const std = @import("std");
+const builtin = @import("builtin");
+const slang = @import("root.zig");
+
+const IGlobalSession = slang.IGlobalSession;
+const ISession = slang.ISession;
+const IModule = slang.IModule;
+const IComponentType = slang.IComponentType;
+const IBlob = slang.IBlob;
+const Owned = slang.Owned;
+const SessionDesc = slang.SessionDesc;
+const residentSetSize = @import("session_pool.zig").residentSetSize;
+
+pub const Phase = enum {
+    create_session,
+    load_module,
+    link,
+    get_entry_point_code,
+};
+
+pub const PhaseStats = struct {
+    calls: u64 = 0,
+    time_ns: u64 = 0,
+    /// Sums of the growth during the calls, negative when memory was given back
+    rss_growth: i64 = 0,
+    heap_growth: i64 = 0,
+
+    fn add(self: *PhaseStats, other: PhaseStats) void {
+        self.calls += other.calls;
+        self.time_ns += other.time_ns;
+        self.rss_growth += other.rss_growth;
+        self.heap_growth += other.heap_growth;
+    }
+};
+
+pub const Usage = std.EnumArray(Phase, PhaseStats);
+
+pub const MemoryAccounting = struct {
+    gpa: std.mem.Allocator,
+    options: Options,
+    mutex: std.Thread.Mutex = .{},
+    sessions: std.ArrayList(*SessionAccount) = .empty,
+    /// Usage of the sessions that were closed, so the counters never go down
+    retired: Usage = .initFill(.{}),
+    retired_sessions: u64 = 0,
+    next_id: u64 = 0,
+
+    pub const Options = struct {
+        /// Reported along with the sessions, usually the allocator of the Zig side of the service
+        counting_allocator: ?*CountingAllocator = null,
+    };
+
+    pub fn init(gpa: std.mem.Allocator, options: Options) MemoryAccounting {
+        return MemoryAccounting{ .gpa = gpa, .options = options };
+    }
+
+    /// Every session has to be closed first
+    pub fn deinit(self: *MemoryAccounting) void {
+        std.debug.assert(self.sessions.items.len == 0);
+        self.sessions.deinit(self.gpa);
+    }
+
+    /// `label` names the session in the counters, it is copied
+    pub fn createSession(self: *MemoryAccounting, global_session: *IGlobalSession, desc: SessionDesc, label: []const u8) !*SessionAccount {
+        const account = try self.gpa.create(SessionAccount);
+        errdefer self.gpa.destroy(account);
+        const owned_label = try self.gpa.dupe(u8, label);
+        errdefer self.gpa.free(owned_label);
+
+        const sample = Sample.take();
+        var session = try global_session.createSession(desc);
+        errdefer session.release();
+        account.* = SessionAccount{
+            .accounting = self,
+            .session = session,
+            .id = undefined,
+            .label = owned_label,
+        };
+        account.record(.create_session, sample);
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        try self.sessions.append(self.gpa, account);
+        account.id = self.next_id;
+        self.next_id += 1;
+        return account;
+    }
+
+    /// Writes every counter in the Prometheus text format
+    pub fn writePrometheus(self: *MemoryAccounting, w: *std.Io.Writer) !void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        try w.writeAll(
+            \\# HELP slang_process_resident_bytes Resident set size of the process.
+            \\# TYPE slang_process_resident_bytes gauge
+            \\
+        );
+        try w.print("slang_process_resident_bytes {d}\n", .{residentSetSize() catch 0});
+        if (has_mallinfo) {
+            try w.writeAll(
+                \\# HELP slang_process_heap_bytes Heap in use by malloc, including slang.
+                \\# TYPE slang_process_heap_bytes gauge
+                \\
+            );
+            try w.print("slang_process_heap_bytes {d}\n", .{heapInUse()});
+        }
+        if (self.options.counting_allocator) |counting| {
+            try w.writeAll(
+                \\# HELP slang_allocator_live_bytes Bytes allocated through the counting allocator and not freed yet.
+                \\# TYPE slang_allocator_live_bytes gauge
+                \\
+            );
+            try w.print("slang_allocator_live_bytes {d}\n", .{counting.live_bytes.load(.monotonic)});
+            try w.writeAll(
+                \\# HELP slang_allocator_peak_bytes Highest value of slang_allocator_live_bytes.
+                \\# TYPE slang_allocator_peak_bytes gauge
+                \\
+            );
+            try w.print("slang_allocator_peak_bytes {d}\n", .{counting.peak_bytes.load(.monotonic)});
+            try w.writeAll(
+                \\# HELP slang_allocator_allocations_total Allocations made through the counting allocator.
+                \\# TYPE slang_allocator_allocations_total counter
+                \\
+            );
+            try w.print("slang_allocator_allocations_total {d}\n", .{counting.allocations.load(.monotonic)});
+        }
+
+        try w.writeAll(
+            \\# HELP slang_sessions Sessions that are open.
+            \\# TYPE slang_sessions gauge
+            \\
+        );
+        try w.print("slang_sessions {d}\n", .{self.sessions.items.len});
+        try w.writeAll(
+            \\# HELP slang_sessions_closed_total Sessions that were closed.
+            \\# TYPE slang_sessions_closed_total counter
+            \\
+        );
+        try w.print("slang_sessions_closed_total {d}\n", .{self.retired_sessions});
+
+        const session_gauges = [_]struct { []const u8, []const u8, std.meta.FieldEnum(SessionAccount) }{
+            .{ "slang_session_loaded_modules", "Modules loaded by the session.", .loaded_modules },
+            .{ "slang_session_live_component_types", "Component types returned by the session and not released yet.", .live_component_types },
+            .{ "slang_session_live_blobs", "Blobs returned by the session and not released yet.", .live_blobs },
+        };
+        inline for (session_gauges) |gauge| {
+            try w.print("# HELP {s} {s}\n# TYPE {s} gauge\n", .{ gauge[0], gauge[1], gauge[0] });
+            for (self.sessions.items) |account| {
+                try w.print("{s}{{", .{gauge[0]});
+                try account.writeLabels(w);
+                try w.print("}} {d}\n", .{@field(account, @tagName(gauge[2]))});
+            }
+        }
+
+        const phase_metrics = [_]struct { []const u8, []const u8, []const u8, std.meta.FieldEnum(PhaseStats) }{
+            .{ "slang_phase_calls_total", "Calls of the phase.", "counter", .calls },
+            .{ "slang_phase_seconds_total", "Time spent in the phase.", "counter", .time_ns },
+            .{ "slang_phase_rss_growth_bytes", "Growth of the resident set size during the phase.", "gauge", .rss_growth },
+            .{ "slang_phase_heap_growth_bytes", "Growth of the heap in use during the phase.", "gauge", .heap_growth },
+        };
+        inline for (phase_metrics) |metric| {
+            try w.print("# HELP {s} {s}\n# TYPE {s} {s}\n", .{ metric[0], metric[1], metric[0], metric[2] });
+            for (self.sessions.items) |account| {
+                for (std.enums.values(Phase)) |phase| {
+                    try w.print("{s}{{", .{metric[0]});
+                    try account.writeLabels(w);
+                    try w.print(",phase=\"{t}\"}} ", .{phase});
+                    try writeValue(w, metric[3], account.usage.get(phase));
+                }
+            }
+            for (std.enums.values(Phase)) |phase| {
+                try w.print("{s}{{session=\"closed\",phase=\"{t}\"}} ", .{ metric[0], phase });
+                try writeValue(w, metric[3], self.retired.get(phase));
+            }
+        }
+    }
+
+    fn writeValue(w: *std.Io.Writer, comptime field: std.meta.FieldEnum(PhaseStats), stats: PhaseStats) !void {
+        switch (field) {
+            .time_ns => try w.print("{d:.6}\n", .{@as(f64, @floatFromInt(stats.time_ns)) / std.time.ns_per_s}),
+            else => try w.print("{d}\n", .{@field(stats, @tagName(field))}),
+        }
+    }
+};
+
+/// A session with its memory accounting. Not thread safe, like the session itself.
+pub const SessionAccount = struct {
+    accounting: *MemoryAccounting,
+    session: Owned(ISession),
+    id: u64,
+    label: []const u8,
+    usage: Usage = .initFill(.{}),
+    /// Added to as well while set, see `beginJob`
+    job: ?*Usage = null,
+    loaded_modules: usize = 0,
+    live_component_types: usize = 0,
+    live_blobs: usize = 0,
+
+    /// Releases the session and keeps its usage in the totals of closed sessions. Objects
+    /// returned by the account that are still alive keep working, but are not counted anymore.
+    pub fn close(self: *SessionAccount) void {
+        const accounting = self.accounting;
+        self.session.release();
+        {
+            accounting.mutex.lock();
+            defer accounting.mutex.unlock();
+            const index = std.mem.indexOfScalar(*SessionAccount, accounting.sessions.items, self).?;
+            _ = accounting.sessions.swapRemove(index);
+            for (std.enums.values(Phase)) |phase| {
+                accounting.retired.getPtr(phase).add(self.usage.get(phase));
+            }
+            accounting.retired_sessions += 1;
+        }
+        accounting.gpa.free(self.label);
+        accounting.gpa.destroy(self);
+    }
+
+    /// Adds the usage of the following phases to `usage` as well, until `endJob`
+    pub fn beginJob(self: *SessionAccount, usage: *Usage) void {
+        std.debug.assert(self.job == null);
+        self.job = usage;
+    }
+
+    pub fn endJob(self: *SessionAccount) void {
+        self.job = null;
+    }
+
+    pub fn loadModule(self: *SessionAccount, module_name: [*:0]const u8, out_diagnostics: ?**IBlob) ?Owned(IModule) {
+        const sample = Sample.take();
+        defer self.record(.load_module, sample);
+        return self.session.borrow().loadModule(module_name, out_diagnostics);
+    }
+
+    /// Release the result with `release`
+    pub fn link(self: *SessionAccount, component: *IComponentType, out_diagnostics: ?**IBlob) !Owned(IComponentType) {
+        const sample = Sample.take();
+        defer self.record(.link, sample);
+        const linked = try component.link(out_diagnostics);
+        self.count(IComponentType, .created);
+        return linked;
+    }
+
+    /// Release the result with `release`
+    pub fn getEntryPointCode(self: *SessionAccount, linked: *IComponentType, entry_point_index: i64, target_index: i64, out_diagnostics: ?**IBlob) !Owned(IBlob) {
+        const sample = Sample.take();
+        defer self.record(.get_entry_point_code, sample);
+        const code = try linked.getEntryPointCode(entry_point_index, target_index, out_diagnostics);
+        self.count(IBlob, .created);
+        return code;
+    }
+
+    /// Releases a component type or blob returned by the account
+    pub fn release(self: *SessionAccount, object: anytype) void {
+        const T = @typeInfo(@TypeOf(object.borrow())).pointer.child;
+        object.release();
+        self.count(T, .released);
+    }
+
+    fn count(self: *SessionAccount, comptime T: type, change: enum { created, released }) void {
+        const counter = switch (T) {
+            IComponentType => &self.live_component_types,
+            IBlob => &self.live_blobs,
+            else => @compileError("only component types and blobs are counted, got " ++ @typeName(T)),
+        };
+        self.accounting.mutex.lock();
+        defer self.accounting.mutex.unlock();
+        switch (change) {
+            .created => counter.* += 1,
+            .released => counter.* -= 1,
+        }
+    }
+
+    fn record(self: *SessionAccount, phase: Phase, before: Sample) void {
+        const after = Sample.take();
+        const stats = PhaseStats{
+            .calls = 1,
+            .time_ns = after.time_ns -| before.time_ns,
+            .rss_growth = @as(i64, @intCast(after.rss)) - @as(i64, @intCast(before.rss)),
+            .heap_growth = @as(i64, @intCast(after.heap)) - @as(i64, @intCast(before.heap)),
+        };
+        const loaded_modules = self.session.borrow().getLoadedModuleCount();
+
+        self.accounting.mutex.lock();
+        defer self.accounting.mutex.unlock();
+        self.usage.getPtr(phase).add(stats);
+        if (self.job) |job| job.getPtr(phase).add(stats);
+        self.loaded_modules = loaded_modules;
+    }
+
+    /// Labels identifying the session, the label is escaped as Prometheus requires
+    fn writeLabels(self: *const SessionAccount, w: *std.Io.Writer) !void {
+        try w.writeAll("session=\"");
+        for (self.label) |c| switch (c) {
+            '\\' => try w.writeAll("\\\\"),
+            '"' => try w.writeAll("\\\""),
+            '\n' => try w.writeAll("\\n"),
+            else => try w.writeByte(c),
+        };
+        try w.print("\",id=\"{d}\"", .{self.id});
+    }
+};
+
+const Sample = struct {
+    time_ns: u64,
+    rss: usize,
+    heap: usize,
+
+    fn take() Sample {
+        return Sample{
+            .time_ns = @intCast(std.time.nanoTimestamp()),
+            .rss = residentSetSize() catch 0,
+            .heap = heapInUse(),
+        };
+    }
+};
+
+const has_mallinfo = builtin.os.tag == .linux and builtin.abi.isGnu() and builtin.link_libc;
+
+const Mallinfo2 = extern struct {
+    arena: usize,
+    ordblks: usize,
+    smblks: usize,
+    hblks: usize,
+    hblkhd: usize,
+    usmblks: usize,
+    fsmblks: usize,
+    uordblks: usize,
+    fordblks: usize,
+    keepcost: usize,
+};
+
+extern "c" fn mallinfo2() Mallinfo2;
+
+/// Bytes handed out by malloc, both from its arenas and mapped directly
+fn heapInUse() usize {
+    if (!has_mallinfo) return 0;
+    const info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+/// Counts the bytes that are allocated through it, for the allocations made on the Zig side
+pub const CountingAllocator = struct {
+    child: std.mem.Allocator,
+    live_bytes: std.atomic.Value(usize) = .init(0),
+    peak_bytes: std.atomic.Value(usize) = .init(0),
+    allocations: std.atomic.Value(u64) = .init(0),
+
+    pub fn init(child: std.mem.Allocator) CountingAllocator {
+        return CountingAllocator{ .child = child };
+    }
+
+    pub fn allocator(self: *CountingAllocator) std.mem.Allocator {
+        return .{ .ptr = self, .vtable = &vtable };
+    }
+
+    const vtable = std.mem.Allocator.VTable{
+        .alloc = alloc,
+        .resize = resize,
+        .remap = remap,
+        .free = free,
+    };
+
+    fn grow(self: *CountingAllocator, bytes: usize) void {
+        const live = self.live_bytes.fetchAdd(bytes, .monotonic) + bytes;
+        _ = self.peak_bytes.fetchMax(live, .monotonic);
+    }
+
+    fn shrink(self: *CountingAllocator, bytes: usize) void {
+        _ = self.live_bytes.fetchSub(bytes, .monotonic);
+    }
+
+    fn resized(self: *CountingAllocator, old_len: usize, new_len: usize) void {
+        if (new_len > old_len) self.grow(new_len - old_len) else self.shrink(old_len - new_len);
+    }
+
+    fn alloc(ctx: *anyopaque, len: usize, alignment: std.mem.Alignment, ret_addr: usize) ?[*]u8 {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        const ptr = self.child.rawAlloc(len, alignment, ret_addr) orelse return null;
+        _ = self.allocations.fetchAdd(1, .monotonic);
+        self.grow(len);
+        return ptr;
+    }
+
+    fn resize(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) bool {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        if (!self.child.rawResize(memory, alignment, new_len, ret_addr)) return false;
+        self.resized(memory.len, new_len);
+        return true;
+    }
+
+    fn remap(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) ?[*]u8 {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        const ptr = self.child.rawRemap(memory, alignment, new_len, ret_addr) orelse return null;
+        self.resized(memory.len, new_len);
+        return ptr;
+    }
+
+    fn free(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, ret_addr: usize) void {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        self.child.rawFree(memory, alignment, ret_addr);
+        self.shrink(memory.len);
+    }
+};
+
+test "memory accounting" {
+    var counting = CountingAllocator.init(std.testing.allocator);
+    const gpa = counting.allocator();
+
+    var list: std.ArrayList(u32) = .empty;
+    try list.appendSlice(gpa, &.{ 1, 2, 3, 4 });
+    try std.testing.expect(counting.live_bytes.load(.monotonic) >= 16);
+    list.deinit(gpa);
+    try std.testing.expectEqual(0, counting.live_bytes.load(.monotonic));
+    try std.testing.expect(counting.peak_bytes.load(.monotonic) >= 16);
+
+    var accounting = MemoryAccounting.init(std.testing.allocator, .{ .counting_allocator = &counting });
+    defer accounting.deinit();
+    accounting.retired.getPtr(.link).add(.{ .calls = 2, .time_ns = 1_500_000_000, .rss_growth = -4096 });
+
+    var output: std.Io.Writer.Allocating = .init(std.testing.allocator);
+    defer output.deinit();
+    try accounting.writePrometheus(&output.writer);
+    const text = output.written();
+    try std.testing.expect(std.mem.indexOf(u8, text, "slang_allocator_live_bytes 0\n") != null);
+    try std.testing.expect(std.mem.indexOf(u8, text, "slang_phase_calls_total{session=\"closed\",phase=\"link\"} 2\n") != null);
+    try std.testing.expect(std.mem.indexOf(u8, text, "slang_phase_seconds_total{session=\"closed\",phase=\"link\"} 1.500000\n") != null);
+    try std.testing.expect(std.mem.indexOf(u8, text, "slang_phase_rss_growth_bytes{session=\"closed\",phase=\"link\"} -4096\n") != null);
+}
+
+test "session account" {
+    const gpa = std.testing.allocator;
+    var global_session = try slang.createGlobalSession(.{});
+    defer global_session.release();
+
+    var accounting = MemoryAccounting.init(gpa, .{});
+    defer accounting.deinit();
+    const account = try accounting.createSession(global_session.borrow(), .{
+        .targets = &.{.{ .format = .spirv, .profile = global_session.borrow().findProfile("spirv_1_5") }},
+        .search_paths = &.{"shaders"},
+    }, "test \"session\"");
+    errdefer account.close();
+
+    var job: Usage = .initFill(.{});
+    {
+        account.beginJob(&job);
+        var module = account.loadModule("test.slang", null) orelse return error.ModuleLoadFailed;
+        defer module.release();
+        var entry_point = try module.borrow().findEntryPointByName("computeMain");
+        defer entry_point.release();
+        const components = [_]*IComponentType{ @ptrCast(module.borrow()), @ptrCast(entry_point.borrow()) };
+        var program = try account.session.borrow().createCompositeComponentType(&components, null);
+        defer program.release();
+        var linked = try account.link(program.borrow(), null);
+        account.endJob();
+        var code = try account.getEntryPointCode(linked.borrow(), 0, 0, null);
+        try std.testing.expect(code.borrow().getBufferSize() != 0);
+
+        try std.testing.expect(account.loaded_modules >= 1);
+        try std.testing.expectEqual(1, account.live_component_types);
+        try std.testing.expectEqual(1, account.live_blobs);
+
+        var output: std.Io.Writer.Allocating = .init(gpa);
+        defer output.deinit();
+        try accounting.writePrometheus(&output.writer);
+        const text = output.written();
+        try std.testing.expect(std.mem.indexOf(u8, text, "slang_sessions 1\n") != null);
+        try std.testing.expect(std.mem.indexOf(u8, text, "slang_session_live_blobs{session=\"test \\\"session\\\"\",id=\"0\"} 1\n") != null);
+        try std.testing.expect(std.mem.indexOf(u8, text, "slang_phase_calls_total{session=\"test \\\"session\\\"\",id=\"0\",phase=\"link\"} 1\n") != null);
+
+        account.release(&code);
+        account.release(&linked);
+        try std.testing.expectEqual(0, account.live_component_types);
+        try std.testing.expectEqual(0, account.live_blobs);
+    }
+
+    for (std.enums.values(Phase)) |phase| {
+        try std.testing.expectEqual(1, account.usage.get(phase).calls);
+    }
+    // Only the phases between beginJob and endJob go to the job
+    try std.testing.expectEqual(0, job.get(.create_session).calls);
+    try std.testing.expectEqual(1, job.get(.load_module).calls);
+    try std.testing.expectEqual(1, job.get(.link).calls);
+    try std.testing.expectEqual(0, job.get(.get_entry_point_code).calls);
+
+    account.close();
+    try std.testing.expectEqual(0, accounting.sessions.items.len);
+    try std.testing.expectEqual(1, accounting.retired_sessions);
+    try std.testing.expectEqual(1, accounting.retired.get(.link).calls);
+    try std.testing.expectEqual(1, accounting.retired.get(.create_session).calls);
+}
@@ -0,0 +1,251 @@
+//! Compiler options that are checked, ordered and hashed at comptime.
+//!
+//! A preset is a fixed list of `CompilerOptionEntry` values. Making it with `optionPreset` rejects
+//! options that contradict each other with a compile error, sorts the entries by option name and
+//! computes a 128-bit fingerprint, so mixing the options into a cache key costs nothing at
+//! runtime. `fingerprint` computes the same value for options that are only known at runtime.
+
+const std = @import("std");
+const slang = @import("root.zig");
+
+const CompilerOptionEntry = slang.CompilerOptionEntry;
+const CompilerOptionName = slang.CompilerOptionName;
+
+pub const Fingerprint = u128;
+
+pub const OptionPreset = struct {
+    /// Sorted by option name, options with the same name keep their order
+    entries: []const CompilerOptionEntry,
+    fingerprint: Fingerprint,
+};
+
+pub fn optionPreset(comptime entries: []const CompilerOptionEntry) OptionPreset {
+    const preset = comptime blk: {
+        @setEvalBranchQuota(1000 * (entries.len + 1) * (entries.len + 1) + 100_000);
+        if (findConflict(entries)) |conflict| {
+            @compileError(std.fmt.comptimePrint("conflicting compiler options '{t}' and '{t}'", .{ conflict.first, conflict.second }));
+        }
+        var sorted = entries[0..entries.len].*;
+        std.sort.insertion(CompilerOptionEntry, &sorted, {}, nameLessThan);
+        const final = sorted;
+        break :blk OptionPreset{ .entries = &final, .fingerprint = fingerprint(&final) };
+    };
+    return preset;
+}
+
+pub const Conflict = struct {
+    first: CompilerOptionName,
+    second: CompilerOptionName,
+};
+
+/// Two options that can not both apply. Setting the same option twice is fine if the values are
+/// the same or the option can be given several times, like `include`.
+pub fn findConflict(entries: []const CompilerOptionEntry) ?Conflict {
+    for (entries, 0..) |a, i| {
+        for (entries[i + 1 ..]) |b| {
+            if (conflicts(a, b)) return Conflict{ .first = a.name, .second = b.name };
+        }
+    }
+    return null;
+}
+
+/// Depends only on the options, not on their order. Options with the same name are hashed in the
+/// order they are given in, since that decides which one applies or which path is searched first,
+/// except for the ones that only add to a set, like `macro_define` or `capability`.
+pub fn fingerprint(entries: []const CompilerOptionEntry) Fingerprint {
+    var hasher = Hasher{};
+    hasher.updateInt(@intCast(entries.len));
+
+    // Selects the names in ascending order instead of sorting, so nothing has to be allocated.
+    // Option lists are short, the quadratic cost does not matter.
+    var previous: ?i32 = null;
+    while (true) {
+        var next: ?i32 = null;
+        for (entries) |entry| {
+            const name = @intFromEnum(entry.name);
+            if (previous != null and name <= previous.?) continue;
+            if (next == null or name < next.?) next = name;
+        }
+        const name = next orelse break;
+        if (isUnordered(@enumFromInt(name))) {
+            // Summed, so every order of the entries gives the same value. Unlike xor, entries
+            // given twice don't cancel out.
+            var sum: Fingerprint = 0;
+            for (entries) |entry| {
+                if (@intFromEnum(entry.name) != name) continue;
+                var entry_hasher = Hasher{};
+                entry_hasher.updateEntry(entry);
+                sum +%= entry_hasher.final();
+            }
+            hasher.update(&std.mem.toBytes(std.mem.nativeToLittle(Fingerprint, sum)));
+        } else for (entries) |entry| {
+            if (@intFromEnum(entry.name) == name) hasher.updateEntry(entry);
+        }
+        previous = name;
+    }
+    return hasher.final();
+}
+
+/// Two Wyhash states with different seeds, for 128 bits without a slower hash.
+const Hasher = struct {
+    low: std.hash.Wyhash = .init(0),
+    high: std.hash.Wyhash = .init(0x9e3779b97f4a7c15),
+
+    fn update(self: *Hasher, bytes: []const u8) void {
+        self.low.update(bytes);
+        self.high.update(bytes);
+    }
+
+    fn updateInt(self: *Hasher, value: i32) void {
+        // Little endian, so the fingerprint is the same on every host
+        self.update(&std.mem.toBytes(std.mem.nativeToLittle(i32, value)));
+    }
+
+    fn updateString(self: *Hasher, string: ?[*:0]const u8) void {
+        const bytes = std.mem.span(string orelse {
+            self.updateInt(-1);
+            return;
+        });
+        self.updateInt(@intCast(bytes.len));
+        self.update(bytes);
+    }
+
+    fn updateEntry(self: *Hasher, entry: CompilerOptionEntry) void {
+        self.updateInt(@intFromEnum(entry.name));
+        self.updateInt(@intFromEnum(entry.value.kind));
+        self.updateInt(entry.value.int_value_0);
+        self.updateInt(entry.value.int_value_1);
+        self.updateString(entry.value.string_value_0);
+        self.updateString(entry.value.string_value_1);
+    }
+
+    fn final(self: *Hasher) Fingerprint {
+        return @as(Fingerprint, self.high.final()) << 64 | self.low.final();
+    }
+};
+
+/// Options that can be given several times and whose order does not change the result
+fn isUnordered(name: CompilerOptionName) bool {
+    return switch (name) {
+        .macro_define,
+        .capability,
+        .type_conformance,
+        .warnings_as_errors,
+        .enable_warning,
+        .disable_warning,
+        => true,
+        else => false,
+    };
+}
+
+fn nameLessThan(_: void, a: CompilerOptionEntry, b: CompilerOptionEntry) bool {
+    return @intFromEnum(a.name) < @intFromEnum(b.name);
+}
+
+fn conflicts(a: CompilerOptionEntry, b: CompilerOptionEntry) bool {
+    if (a.name == b.name) {
+        return switch (a.name) {
+            // Macros only conflict when the same macro gets two different values
+            .macro_define => eqlString(a.value.string_value_0, b.value.string_value_0) and
+                !eqlString(a.value.string_value_1, b.value.string_value_1),
+            .include,
+            .capability,
+            .warnings_as_errors,
+            .disable_warnings,
+            .enable_warning,
+            .disable_warning,
+            .type_conformance,
+            .downstream_args,
+            .vulkan_bind_shift,
+            .vulkan_bind_shift_all,
+            => false,
+            else => !eqlValue(a, b),
+        };
+    }
+
+    if (spirvMethod(a)) |method_a| {
+        if (spirvMethod(b)) |method_b| return method_a != method_b;
+    }
+    return (isEnabled(a, .matrix_layout_row) and isEnabled(b, .matrix_layout_column)) or
+        (isEnabled(a, .matrix_layout_column) and isEnabled(b, .matrix_layout_row));
+}
+
+/// The way of emitting SPIR-V that `entry` asks for, the two older flags are turned into
+/// `emit_spirv_method` by slang too.
+fn spirvMethod(entry: CompilerOptionEntry) ?i32 {
+    return switch (entry.name) {
+        .emit_spirv_directly => if (entry.value.int_value_0 != 0) @intFromEnum(slang.EmitSpirvMethod.directly) else null,
+        .emit_spirv_via_glsl => if (entry.value.int_value_0 != 0) @intFromEnum(slang.EmitSpirvMethod.via_glsl) else null,
+        .emit_spirv_method => entry.value.int_value_0,
+        else => null,
+    };
+}
+
+fn isEnabled(entry: CompilerOptionEntry, name: CompilerOptionName) bool {
+    return entry.name == name and entry.value.int_value_0 != 0;
+}
+
+fn eqlValue(a: CompilerOptionEntry, b: CompilerOptionEntry) bool {
+    return a.value.kind == b.value.kind and
+        a.value.int_value_0 == b.value.int_value_0 and
+        a.value.int_value_1 == b.value.int_value_1 and
+        eqlString(a.value.string_value_0, b.value.string_value_0) and
+        eqlString(a.value.string_value_1, b.value.string_value_1);
+}
+
+fn eqlString(a: ?[*:0]const u8, b: ?[*:0]const u8) bool {
+    if (a == null or b == null) return a == null and b == null;
+    return std.mem.eql(u8, std.mem.span(a.?), std.mem.span(b.?));
+}
+
+test "option presets" {
+    const preset = comptime optionPreset(&.{
+        .optimization(.high),
+        .macro_define("FOO", "1"),
+        .include("shaders"),
+        .emit_spirv_directly(true),
+        .include("common"),
+    });
+    try std.testing.expectEqual(CompilerOptionName.macro_define, preset.entries[0].name);
+    try std.testing.expectEqualStrings("shaders", std.mem.span(preset.entries[1].value.string_value_0.?));
+    try std.testing.expectEqualStrings("common", std.mem.span(preset.entries[2].value.string_value_0.?));
+
+    const reordered = [_]CompilerOptionEntry{
+        .include("shaders"),
+        .emit_spirv_directly(true),
+        .include("common"),
+        .optimization(.high),
+        .macro_define("FOO", "1"),
+    };
+    try std.testing.expectEqual(preset.fingerprint, fingerprint(&reordered));
+
+    const includes_swapped = [_]CompilerOptionEntry{
+        .optimization(.high),
+        .macro_define("FOO", "1"),
+        .include("common"),
+        .emit_spirv_directly(true),
+        .include("shaders"),
+    };
+    try std.testing.expect(preset.fingerprint != fingerprint(&includes_swapped));
+
+    // Unlike includes, the order of macros does not change what is compiled
+    const macros = [_]CompilerOptionEntry{
+        .macro_define("FOO", "1"),
+        .macro_define("BAR", ""),
+        .type_conformance("Impl:IInterface"),
+    };
+    const macros_swapped = [_]CompilerOptionEntry{
+        .type_conformance("Impl:IInterface"),
+        .macro_define("BAR", ""),
+        .macro_define("FOO", "1"),
+    };
+    try std.testing.expectEqual(fingerprint(&macros), fingerprint(&macros_swapped));
+    // A repeated macro still changes the fingerprint
+    const macro_repeated = macros ++ [_]CompilerOptionEntry{.macro_define("FOO", "1")};
+    try std.testing.expect(fingerprint(&macros) != fingerprint(&macro_repeated));
+
+    try std.testing.expect(findConflict(&.{ .emit_spirv_directly(true), .emit_spirv_via_glsl(true) }) != null);
+    try std.testing.expect(findConflict(&.{ .emit_spirv_directly(true), .emit_spirv_via_glsl(false) }) == null);
+    try std.testing.expect(findConflict(&.{ .optimization(.high), .optimization(.none) }) != null);
+    try std.testing.expect(findConflict(&.{ .macro_define("FOO", "1"), .macro_define("FOO", "2") }) != null);
+}
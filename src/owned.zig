@@ -0,0 +1,128 @@
+//! An owning handle for COM objects, the Zig take on `ComPtr`.
+//!
+//! Every wrapper that hands out a reference returns it in an `Owned` handle, `own` wraps pointers
+//! that come from elsewhere, like a vtable implemented in Zig. The handle is the size of a pointer
+//! in release builds, `move` hands the reference on without an `addRef`/`release` pair, and
+//! `borrow` gives out the pointer for calls. Only `clone` and `retain` take another reference. A moved handle is empty, releasing it
+//! is a noop in every build mode. Build modes with runtime safety also remember whether a handle
+//! was moved or released, so using it afterwards or releasing it twice panics instead of
+//! corrupting the reference count.
+//!
+//! ```zig
+//! var linked = try program.borrow().link(null);
+//! defer linked.release();
+//! const code = try linked.borrow().getEntryPointCode(0, 0, null);
+//! defer code.release();
+//! // The cache takes the reference, the deferred release is then a noop
+//! try cache.put(gpa, key, linked.move());
+//! ```
+
+const std = @import("std");
+
+const track_state = std.debug.runtime_safety;
+
+/// Takes over the reference held by `object`, for pointers that don't come from the bindings
+pub fn own(object: anytype) Owned(@typeInfo(@TypeOf(object)).pointer.child) {
+    return .adopt(object);
+}
+
+pub fn Owned(comptime T: type) type {
+    return struct {
+        /// Null once the reference was handed on with `move` or `leak`
+        object: ?*T,
+        state: if (track_state) State else void = if (track_state) .live else {},
+
+        const Self = @This();
+        const State = enum { live, moved, released };
+
+        /// Takes over the reference held by `object`
+        pub fn adopt(object: *T) Self {
+            return Self{ .object = object };
+        }
+
+        /// Takes a reference of its own to `object`, for pointers that are only borrowed
+        pub fn retain(object: *T) Self {
+            object.addRef();
+            return .adopt(object);
+        }
+
+        /// The object, the handle keeps its reference. The pointer must not outlive the handle.
+        pub fn borrow(self: Self) *T {
+            self.assertLive("borrow");
+            return self.object.?;
+        }
+
+        /// Hands the reference to a new handle. Releasing this one afterwards is a noop, so a
+        /// `defer release()` can stay in place.
+        pub fn move(self: *Self) Self {
+            return .adopt(self.leak());
+        }
+
+        /// A second handle with a reference of its own
+        pub fn clone(self: Self) Self {
+            return .retain(self.borrow());
+        }
+
+        /// Gives up the handle without releasing, for passing the reference on as a plain pointer
+        pub fn leak(self: *Self) *T {
+            self.assertLive("leak");
+            if (track_state) self.state = .moved;
+            const object = self.object.?;
+            self.object = null;
+            return object;
+        }
+
+        pub fn release(self: *Self) void {
+            if (track_state and self.state == .released) {
+                std.debug.panic("{s} released twice", .{@typeName(T)});
+            }
+            if (track_state) self.state = if (self.state == .moved) .moved else .released;
+            const object = self.object orelse return;
+            self.object = null;
+            object.release();
+        }
+
+        fn assertLive(self: Self, comptime operation: []const u8) void {
+            if (track_state and self.state != .live) {
+                std.debug.panic(operation ++ " of a {s} handle that was {t}", .{ @typeName(T), self.state });
+            }
+        }
+    };
+}
+
+test "owned handles" {
+    const blob_loader = @import("blob_loader.zig");
+    const gpa = std.testing.allocator;
+    const bytes = try gpa.alignedAlloc(u8, blob_loader.buffer_alignment, 4);
+    @memcpy(bytes, "code");
+    const blob = try blob_loader.OwnedBlob.create(gpa, bytes);
+
+    var first = own(&blob.interface);
+    defer first.release();
+    try std.testing.expectEqualStrings("code", first.borrow().getBuffer());
+
+    var second = first.clone();
+    defer second.release();
+    try std.testing.expectEqual(2, blob.ref_count.load(.monotonic));
+
+    var third = second.move();
+    try std.testing.expectEqual(2, blob.ref_count.load(.monotonic));
+    // Releasing the moved handle leaves the reference to the new one, in every build mode
+    second.release();
+    try std.testing.expectEqual(2, blob.ref_count.load(.monotonic));
+    try std.testing.expectEqual(null, second.object);
+    third.release();
+    try std.testing.expectEqual(1, blob.ref_count.load(.monotonic));
+
+    var fourth = first.clone();
+    defer fourth.release();
+    const leaked = fourth.leak();
+    defer leaked.release();
+    try std.testing.expectEqual(2, blob.ref_count.load(.monotonic));
+
+    // Like a module that the session keeps and hands out to the loaders
+    var retained = Owned(@TypeOf(blob.interface)).retain(&blob.interface);
+    try std.testing.expectEqual(3, blob.ref_count.load(.monotonic));
+    retained.release();
+    try std.testing.expectEqual(2, blob.ref_count.load(.monotonic));
+}
@@ -0,0 +1,387 @@
+//! Shares compiled entry points between machines through a cache server.
+//!
+//! Entries are keyed by the digest of the session description, the `getEntryPointHash` of the
+//! entry point and the target index, which together cover everything the code depends on. The
+//! client talks to the server over a Unix socket, a TCP port can be forwarded to it with any
+//! socket relay. Requests are batched and pipelined: `Client.lookup` sends all of its batches
+//! from a second thread while the calling thread reads the answers, so thousands of entry points
+//! take a few batches on one connection and a single round trip of latency.
+//!
+//! The protocol is a sequence of frames, every request frame is answered by exactly one response
+//! frame, in order. All integers are little endian.
+//! - get request: `Op.get`, `u32` count, count keys
+//! - get response: `Op.get`, `u32` count, for every key a `u32` length and the value, or
+//!   `missing` without a value
+//! - put request: `Op.put`, `u32` count, for every entry a key, a `u32` length and the value
+//! - put response: `Op.put`, `u32` number of entries stored
+//!
+//! `Server` is the reference implementation, an in memory store that tools/cache_server.zig puts
+//! behind a socket.
+
+const std = @import("std");
+const slang = @import("root.zig");
+
+const IGlobalSession = slang.IGlobalSession;
+const IComponentType = slang.IComponentType;
+const SessionDesc = slang.SessionDesc;
+const Sha256 = std.crypto.hash.sha2.Sha256;
+
+const log = std.log.scoped(.slang_remote_cache);
+
+pub const Key = [Sha256.digest_length]u8;
+
+pub const Op = enum(u8) {
+    get = 1,
+    put = 2,
+    _,
+};
+
+/// Length of a value that is not in the cache
+pub const missing = std.math.maxInt(u32);
+/// Larger values are rejected by both sides, so a corrupt length can't exhaust memory
+pub const max_value_size = 256 * 1024 * 1024;
+/// Larger frames are rejected by the server
+pub const max_batch_size = 64 * 1024;
+
+const buffer_size = 64 * 1024;
+
+pub fn cacheKey(session_digest: []const u8, entry_point_hash: []const u8, target_index: u32) Key {
+    var hasher = Sha256.init(.{});
+    for ([_][]const u8{ session_digest, entry_point_hash }) |part| {
+        var len: [4]u8 = undefined;
+        std.mem.writeInt(u32, &len, @intCast(part.len), .little);
+        hasher.update(&len);
+        hasher.update(part);
+    }
+    var target: [4]u8 = undefined;
+    std.mem.writeInt(u32, &target, target_index, .little);
+    hasher.update(&target);
+    return hasher.finalResult();
+}
+
+/// The key of an entry point of `linked`, a program created by a session with `session_desc`.
+pub fn entryPointKey(
+    global_session: *IGlobalSession,
+    session_desc: SessionDesc,
+    linked: *IComponentType,
+    entry_point_index: i32,
+    target_index: i32,
+) !Key {
+    var digest = try global_session.getSessionDescDigest(session_desc);
+    defer digest.release();
+    var hash = linked.getEntryPointHash(entry_point_index, target_index);
+    defer hash.release();
+    return cacheKey(digest.borrow().getBuffer(), hash.borrow().getBuffer(), @intCast(target_index));
+}
+
+pub const Entry = struct {
+    key: Key,
+    value: []const u8,
+};
+
+pub const Client = struct {
+    gpa: std.mem.Allocator,
+    stream: std.net.Stream,
+    options: Options,
+
+    pub const Options = struct {
+        /// Keys or entries per frame
+        batch_size: u32 = 1024,
+    };
+
+    pub fn connect(gpa: std.mem.Allocator, socket_path: []const u8, options: Options) !Client {
+        std.debug.assert(options.batch_size > 0 and options.batch_size <= max_batch_size);
+        return Client{
+            .gpa = gpa,
+            .stream = try std.net.connectUnixSocket(socket_path),
+            .options = options,
+        };
+    }
+
+    pub fn close(self: *Client) void {
+        self.stream.close();
+    }
+
+    /// Looks up every key, `values[i]` is set to the value of `keys[i]`, or null when the server
+    /// doesn't have it. The values are allocated with the gpa, free them with `freeValues`.
+    pub fn lookup(self: *Client, keys: []const Key, values: []?[]u8) !void {
+        std.debug.assert(keys.len == values.len);
+        @memset(values, null);
+        errdefer freeValues(self.gpa, values);
+
+        // The requests are written by a second thread, otherwise a large answer could fill the
+        // socket buffers while this thread is still writing and neither side would make progress
+        var sender = Sender{ .client = self, .keys = keys };
+        const thread = try std.Thread.spawn(.{}, Sender.run, .{&sender});
+        defer thread.join();
+        errdefer self.shutdown();
+
+        var read_buffer: [buffer_size]u8 = undefined;
+        var file_reader = self.file().readerStreaming(&read_buffer);
+        const reader = &file_reader.interface;
+
+        var start: usize = 0;
+        while (start < keys.len) {
+            const count = @min(keys.len - start, self.options.batch_size);
+            try expectFrame(reader, .get, count);
+            for (values[start..][0..count]) |*value| {
+                const len = try reader.takeInt(u32, .little);
+                if (len == missing) continue;
+                if (len > max_value_size) return error.ProtocolError;
+                const bytes = try self.gpa.alloc(u8, len);
+                value.* = bytes;
+                try reader.readSliceAll(bytes);
+            }
+            start += count;
+        }
+    }
+
+    /// Publishes every entry, returns how many of them the server stored.
+    pub fn publish(self: *Client, entries: []const Entry) !usize {
+        // Checked up front, a frame that is cut short leaves the server waiting for the rest
+        for (entries) |entry| {
+            if (entry.value.len > max_value_size) return error.ValueTooLarge;
+        }
+        errdefer self.shutdown();
+
+        var write_buffer: [buffer_size]u8 = undefined;
+        var file_writer = self.file().writerStreaming(&write_buffer);
+        const writer = &file_writer.interface;
+
+        // Unlike `lookup`, every answer is only five bytes, so they can wait in the socket buffer
+        // until all of the requests are written
+        var frames: usize = 0;
+        var start: usize = 0;
+        while (start < entries.len) : (frames += 1) {
+            const count = @min(entries.len - start, self.options.batch_size);
+            try writer.writeByte(@intFromEnum(Op.put));
+            try writer.writeInt(u32, @intCast(count), .little);
+            for (entries[start..][0..count]) |entry| {
+                try writer.writeAll(&entry.key);
+                try writer.writeInt(u32, @intCast(entry.value.len), .little);
+                try writer.writeAll(entry.value);
+            }
+            start += count;
+        }
+        try writer.flush();
+
+        var read_buffer: [64]u8 = undefined;
+        var file_reader = self.file().readerStreaming(&read_buffer);
+        const reader = &file_reader.interface;
+        var stored: usize = 0;
+        for (0..frames) |_| {
+            if (try reader.takeByte() != @intFromEnum(Op.put)) return error.ProtocolError;
+            stored += try reader.takeInt(u32, .little);
+        }
+        return stored;
+    }
+
+    pub fn freeValues(gpa: std.mem.Allocator, values: []?[]u8) void {
+        for (values) |*value| {
+            if (value.*) |bytes| gpa.free(bytes);
+            value.* = null;
+        }
+    }
+
+    fn file(self: *Client) std.fs.File {
+        return .{ .handle = self.stream.handle };
+    }
+
+    /// Unblocks both directions after an error, the connection can't be used afterwards
+    fn shutdown(self: *Client) void {
+        std.posix.shutdown(self.stream.handle, .both) catch {};
+    }
+
+    const Sender = struct {
+        client: *Client,
+        keys: []const Key,
+
+        /// Failing to send shuts the connection down, which fails the reads of `lookup` as well
+        fn run(sender: *Sender) void {
+            sender.send() catch |err| {
+                log.err("sending lookups failed: {s}", .{@errorName(err)});
+                sender.client.shutdown();
+            };
+        }
+
+        fn send(sender: *Sender) !void {
+            var write_buffer: [buffer_size]u8 = undefined;
+            var file_writer = sender.client.file().writerStreaming(&write_buffer);
+            const writer = &file_writer.interface;
+
+            var start: usize = 0;
+            while (start < sender.keys.len) {
+                const count = @min(sender.keys.len - start, sender.client.options.batch_size);
+                try writer.writeByte(@intFromEnum(Op.get));
+                try writer.writeInt(u32, @intCast(count), .little);
+                for (sender.keys[start..][0..count]) |*key| try writer.writeAll(key);
+                // Every batch is sent as soon as it is complete, so the server can start on it
+                try writer.flush();
+                start += count;
+            }
+        }
+    };
+};
+
+fn expectFrame(reader: *std.Io.Reader, op: Op, count: usize) !void {
+    if (try reader.takeByte() != @intFromEnum(op)) return error.ProtocolError;
+    if (try reader.takeInt(u32, .little) != count) return error.ProtocolError;
+}
+
+/// An in memory cache that can serve many connections at once. Values are never evicted,
+/// entries past `max_size` are not stored.
+pub const Server = struct {
+    gpa: std.mem.Allocator,
+    max_size: usize,
+    mutex: std.Thread.Mutex = .{},
+    /// Values are owned and stay put until `deinit`, so they can be sent without the lock
+    entries: std.AutoHashMapUnmanaged(Key, []const u8) = .empty,
+    size: usize = 0,
+
+    pub fn init(gpa: std.mem.Allocator, max_size: usize) Server {
+        return Server{ .gpa = gpa, .max_size = max_size };
+    }
+
+    pub fn deinit(self: *Server) void {
+        var it = self.entries.valueIterator();
+        while (it.next()) |value| self.gpa.free(value.*);
+        self.entries.deinit(self.gpa);
+    }
+
+    pub fn get(self: *Server, key: Key) ?[]const u8 {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        return self.entries.get(key);
+    }
+
+    /// Takes ownership of `value` when it returns true
+    pub fn put(self: *Server, key: Key, value: []const u8) !bool {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.size + value.len > self.max_size) return false;
+        const entry = try self.entries.getOrPut(self.gpa, key);
+        // The first value wins, the key covers everything the value depends on
+        if (entry.found_existing) return false;
+        entry.value_ptr.* = value;
+        self.size += value.len;
+        return true;
+    }
+
+    /// Answers the requests of one connection until the client closes it. Returns an error
+    /// without answering when a request is malformed.
+    pub fn serve(self: *Server, stream: std.net.Stream) !void {
+        const file: std.fs.File = .{ .handle = stream.handle };
+        var read_buffer: [buffer_size]u8 = undefined;
+        var file_reader = file.readerStreaming(&read_buffer);
+        const reader = &file_reader.interface;
+        var write_buffer: [buffer_size]u8 = undefined;
+        var file_writer = file.writerStreaming(&write_buffer);
+        const writer = &file_writer.interface;
+
+        while (true) {
+            const op: Op = @enumFromInt(reader.takeByte() catch |err| switch (err) {
+                error.EndOfStream => return,
+                else => return err,
+            });
+            const count = try reader.takeInt(u32, .little);
+            if (count > max_batch_size) return error.ProtocolError;
+            switch (op) {
+                .get => {
+                    try writer.writeByte(@intFromEnum(Op.get));
+                    try writer.writeInt(u32, count, .little);
+                    for (0..count) |_| {
+                        var key: Key = undefined;
+                        try reader.readSliceAll(&key);
+                        if (self.get(key)) |value| {
+                            try writer.writeInt(u32, @intCast(value.len), .little);
+                            try writer.writeAll(value);
+                        } else {
+                            try writer.writeInt(u32, missing, .little);
+                        }
+                    }
+                },
+                .put => {
+                    var stored: u32 = 0;
+                    for (0..count) |_| {
+                        var key: Key = undefined;
+                        try reader.readSliceAll(&key);
+                        const len = try reader.takeInt(u32, .little);
+                        if (len > max_value_size) return error.ProtocolError;
+                        const value = try self.gpa.alloc(u8, len);
+                        const taken = taken: {
+                            errdefer self.gpa.free(value);
+                            try reader.readSliceAll(value);
+                            break :taken try self.put(key, value);
+                        };
+                        if (taken) {
+                            stored += 1;
+                        } else {
+                            self.gpa.free(value);
+                        }
+                    }
+                    try writer.writeByte(@intFromEnum(Op.put));
+                    try writer.writeInt(u32, stored, .little);
+                },
+                _ => return error.ProtocolError,
+            }
+            // Answers only wait in the buffer while the next request is already there
+            if (reader.bufferedLen() == 0) try writer.flush();
+        }
+    }
+};
+
+test "remote cache" {
+    const gpa = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    const socket_path = try std.fmt.allocPrint(gpa, ".zig-cache/tmp/{s}/cache.sock", .{tmp.sub_path});
+    defer gpa.free(socket_path);
+    const address = try std.net.Address.initUnix(socket_path);
+    var listener = try address.listen(.{});
+    defer listener.deinit();
+
+    var server = Server.init(gpa, 1024 * 1024);
+    defer server.deinit();
+    const Accept = struct {
+        fn run(cache: *Server, net_server: *std.net.Server) !void {
+            const connection = try net_server.accept();
+            defer connection.stream.close();
+            try cache.serve(connection.stream);
+        }
+    };
+    const thread = try std.Thread.spawn(.{}, Accept.run, .{ &server, &listener });
+    defer thread.join();
+
+    var client = try Client.connect(gpa, socket_path, .{ .batch_size = 7 });
+    defer client.close();
+
+    var keys: [100]Key = undefined;
+    var entries: [50]Entry = undefined;
+    var value_buffers: [50][16]u8 = undefined;
+    for (&keys, 0..) |*key, i| {
+        var index: [4]u8 = undefined;
+        std.mem.writeInt(u32, &index, @intCast(i), .little);
+        key.* = cacheKey("session", &index, 0);
+        if (i % 2 == 0) {
+            entries[i / 2] = .{ .key = key.*, .value = try std.fmt.bufPrint(&value_buffers[i / 2], "code {d}", .{i}) };
+        }
+    }
+    try std.testing.expect(!std.mem.eql(u8, &cacheKey("session", "hash", 0), &cacheKey("session", "hash", 1)));
+
+    try std.testing.expectEqual(50, try client.publish(&entries));
+    // Publishing again stores nothing new
+    try std.testing.expectEqual(0, try client.publish(entries[0..10]));
+
+    var values: [100]?[]u8 = undefined;
+    try client.lookup(&keys, &values);
+    defer Client.freeValues(gpa, &values);
+    for (values, 0..) |value, i| {
+        if (i % 2 == 0) {
+            var expected: [16]u8 = undefined;
+            try std.testing.expectEqualStrings(try std.fmt.bufPrint(&expected, "code {d}", .{i}), value.?);
+        } else {
+            try std.testing.expectEqual(null, value);
+        }
+    }
+}
@@ -3,13 +3,10 @@ const builtin = @import("builtin");
 const log = std.log.scoped(.slang);
 
 // TODO: Copy over all the doc comments from slang
-// TODO: Create tests for struct sizes and enum tags by reflecting this zig module, generating the
-// c++ code that accesses the appropriate tags/sizeofs, maybe with some name conversion overrides
-// for edge cases, and pass them back to zig via FFI. Write the actual assertion tests on the zig
-// side, and write a build step for compiling and linking the c++ file and register it as a
-// dependency of the test step.
 
 const log_diagnostics = @import("options").log_diagnostics;
+const track_com_lifetimes = @import("options").track_com_lifetimes;
+const com_tracker = @import("com_tracker.zig");
 threadlocal var diagnostics_blob: *IBlob = @ptrFromInt(0x8);
 
 fn getDiagnosticsPtr(out_diagnostics: ?**IBlob) ?**IBlob {
@@ -19,7 +16,28 @@ fn getDiagnosticsPtr(out_diagnostics: ?**IBlob) ?**IBlob {
     };
 }
 
-fn logDiagnostics(diagnostics: ?**IBlob, out_diagnostics: ?**IBlob) void {
+/// Wraps a reference that slang returned through an out parameter in the handle that releases
+/// it. With `track_com_lifetimes` enabled the reference is also recorded.
+inline fn owned(object: anytype) Owned(@typeInfo(@TypeOf(object)).pointer.child) {
+    if (track_com_lifetimes) com_tracker.created(object, @returnAddress());
+    return .adopt(object);
+}
+
+/// The blob in `out_diagnostics` before the call, so `logDiagnostics` only tracks a blob that
+/// slang wrote. The variable may hold a released or `undefined` pointer.
+fn snapshotDiagnostics(out_diagnostics: ?**IBlob) ?*IBlob {
+    if (!track_com_lifetimes) return null;
+    const out = out_diagnostics orelse return null;
+    return out.*;
+}
+
+fn logDiagnostics(diagnostics: ?**IBlob, out_diagnostics: ?**IBlob, previous_diagnostics: ?*IBlob) void {
+    // A blob that changed during the call was written by slang and belongs to the caller
+    if (track_com_lifetimes) {
+        if (out_diagnostics) |out| {
+            if (out.* != previous_diagnostics) com_tracker.created(out.*, @returnAddress());
+        }
+    }
     if (log_diagnostics != .never and out_diagnostics == null and @intFromPtr(diagnostics_blob) != 0x8) {
         log.err("{s}", .{diagnostics_blob.getBuffer()});
         diagnostics_blob.release();
@@ -135,7 +153,7 @@ pub const TargetFlags = packed struct(u32) {
     generate_spirv_directly: bool = false,
     _pad2: u21 = 0,
 
-    pub const default = CompileFlags{ .generate_spirv_directly = true };
+    pub const default = TargetFlags{ .generate_spirv_directly = true };
 };
 
 pub const FloatingPointMode = enum(i32) {
@@ -710,9 +728,13 @@ pub const UUID = extern struct {
     pub fn init(a: u32, b: u16, c: u16, d: [8]u8) UUID {
         return UUID{ .data1 = a, .data2 = b, .data3 = c, .data4 = d };
     }
+
+    pub fn eql(self: UUID, other: UUID) bool {
+        return std.mem.eql(u8, std.mem.asBytes(&self), std.mem.asBytes(&other));
+    }
 };
 
-const mcall: std.builtin.CallingConvention = if (builtin.os.tag == .windows) .winapi else .c;
+pub const mcall: std.builtin.CallingConvention = if (builtin.os.tag == .windows) .winapi else .c;
 
 pub const IUnknown = extern struct {
     vtable: *const VTable,
@@ -723,7 +745,7 @@ pub const IUnknown = extern struct {
     pub const addRef = IUnknown.Mixin(@This()).addRef;
     pub const release = IUnknown.Mixin(@This()).release;
 
-    const VTable = extern struct {
+    pub const VTable = extern struct {
         queryInterface: *const fn (this: *IUnknown, uuid_: *const UUID, out_object: **anyopaque) callconv(mcall) Result,
         addRef: *const fn (this: *IUnknown) callconv(mcall) u32,
         release: *const fn (this: *IUnknown) callconv(mcall) u32,
@@ -734,14 +756,17 @@ pub const IUnknown = extern struct {
             fn queryInterface(self: *T, uuid_: *const UUID, out_object: **anyopaque) !void {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 try vtable.queryInterface(@ptrCast(self), uuid_, out_object).check();
+                if (track_com_lifetimes) com_tracker.created(@as(*IUnknown, @ptrCast(@alignCast(out_object.*))), @returnAddress());
             }
 
             fn addRef(self: *T) void {
+                if (track_com_lifetimes) com_tracker.addRef(self, @returnAddress());
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 _ = vtable.addRef(@ptrCast(self));
             }
 
             fn release(self: *T) void {
+                if (track_com_lifetimes) com_tracker.release(self);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 _ = vtable.release(@ptrCast(self));
             }
@@ -759,7 +784,7 @@ pub const ICastable = extern struct {
     pub const release = IUnknown.Mixin(@This()).release;
     pub const castAs = ICastable.Mixin(@This()).castAs;
 
-    const VTable = extern struct {
+    pub const VTable = extern struct {
         base: IUnknown.VTable,
         castAs: *const fn (this: *ICastable, guid: *const UUID) callconv(mcall) ?*anyopaque,
     };
@@ -770,7 +795,7 @@ pub const ICastable = extern struct {
             // restricted to only types with uuid constants
             fn castAs(self: *T, comptime U: type) *U {
                 const vtable: *const VTable = @ptrCast(self.vtable);
-                return @ptrCast(@alignCast(vtable.castAs(@ptrCast(self), U.uuid)));
+                return @ptrCast(@alignCast(vtable.castAs(@ptrCast(self), &U.uuid)));
             }
         };
     }
@@ -814,7 +839,7 @@ pub const IBlob = extern struct {
     pub const getBuffer = IBlob.Mixin(@This()).getBuffer;
     pub const getBufferSize = IBlob.Mixin(@This()).getBufferSize;
 
-    const VTable = extern struct {
+    pub const VTable = extern struct {
         base: IUnknown.VTable,
         getBufferPointer: *const fn (this: *IBlob) callconv(mcall) ?[*]const u8,
         getBufferSize: *const fn (this: *IBlob) callconv(mcall) usize,
@@ -881,11 +906,11 @@ pub const IFileSystem = extern struct {
 
     fn Mixin(comptime T: type) type {
         return struct {
-            fn loadFile(self: *T, path: [:0]const u8) !*IBlob {
+            fn loadFile(self: *T, path: [:0]const u8) !Owned(IBlob) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var blob: *IBlob = undefined;
                 try vtable.loadFile(@ptrCast(self), path.ptr, &blob).check();
-                return blob;
+                return owned(blob);
             }
         };
     }
@@ -905,7 +930,7 @@ pub const ISharedLibrary = extern struct {
     pub const findSymbolAddressByName = ISharedLibrary.Mixin(@This()).findSymbolAddressByName;
     pub const findFuncByName = ISharedLibrary.Mixin(@This()).findFuncByName;
 
-    const VTable = extern struct {
+    pub const VTable = extern struct {
         base: ICastable.VTable,
         findSymbolAddressByName: *const fn (self: *ISharedLibrary, name: [*:0]const u8) callconv(mcall) ?*const anyopaque,
     };
@@ -934,18 +959,18 @@ pub const ISharedLibraryLoader = extern struct {
     pub const release = IUnknown.Mixin(@This()).release;
     pub const loadSharedLibrary = ISharedLibraryLoader.Mixin(@This()).loadSharedLibrary;
 
-    const VTable = extern struct {
+    pub const VTable = extern struct {
         base: IUnknown.VTable,
         loadSharedLibrary: *const fn (this: *ISharedLibraryLoader, path: [*:0]const u8, out_shared_library: **ISharedLibrary) callconv(mcall) Result,
     };
 
     fn Mixin(comptime T: type) type {
         return struct {
-            fn loadSharedLibrary(self: *T, path: [:0]const u8) !*ISharedLibrary {
+            fn loadSharedLibrary(self: *T, path: [:0]const u8) !Owned(ISharedLibrary) {
                 var result: *ISharedLibrary = undefined;
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 try vtable.loadSharedLibrary(@ptrCast(self), path.ptr, &result).check();
-                return result;
+                return owned(result);
             }
         };
     }
@@ -1003,18 +1028,18 @@ pub const IFileSystemExt = extern struct {
 
     fn Mixin(comptime T: type) type {
         return struct {
-            fn getFileUniqueIdentity(self: *T, path: [:0]const u8) !*IBlob {
+            fn getFileUniqueIdentity(self: *T, path: [:0]const u8) !Owned(IBlob) {
                 var result: *IBlob = undefined;
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 try vtable.getFileUniqueIdentity(@ptrCast(self), path.ptr, &result).check();
-                return result;
+                return owned(result);
             }
 
-            fn calcCombinedPath(self: *T, from_path: [:0]const u8, path: [:0]const u8) !*IBlob {
+            fn calcCombinedPath(self: *T, from_path: [:0]const u8, path: [:0]const u8) !Owned(IBlob) {
                 var result: *IBlob = undefined;
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 try vtable.calcCombinedPath(@ptrCast(self), from_path.ptr, path.ptr, &result).check();
-                return result;
+                return owned(result);
             }
 
             fn getPathType(self: *T, path: [:0]const u8) !PathType {
@@ -1024,11 +1049,11 @@ pub const IFileSystemExt = extern struct {
                 return result;
             }
 
-            fn getPath(self: *T, kind: PathKind, path: [:0]const u8) !*IBlob {
+            fn getPath(self: *T, kind: PathKind, path: [:0]const u8) !Owned(IBlob) {
                 var result: *IBlob = undefined;
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 try vtable.getPath(@ptrCast(self), kind, path.ptr, &result).check();
-                return result;
+                return owned(result);
             }
 
             fn clearCache(self: *T) void {
@@ -1131,10 +1156,10 @@ pub const IWriter = extern struct {
     pub const isConsole = IWriter.Mixin(@This()).isConsole;
     pub const setMode = IWriter.Mixin(@This()).setMode;
 
-    const VTable = extern struct {
+    pub const VTable = extern struct {
         base: IUnknown.VTable,
         beginAppendBuffer: *const fn (this: *IWriter, max_num_chars: usize) callconv(mcall) ?[*]u8,
-        endAppendBuffer: *const fn (this: *IWriter, buffer: [*]const u8, num_chars: usize) callconv(mcall) Result,
+        endAppendBuffer: *const fn (this: *IWriter, buffer: [*]u8, num_chars: usize) callconv(mcall) Result,
         write: *const fn (this: *IWriter, chars: [*]const u8, num_chars: usize) callconv(mcall) Result,
         flush: *const fn (this: *IWriter) callconv(mcall) void,
         isConsole: *const fn (this: *IWriter) callconv(mcall) bool,
@@ -1143,19 +1168,20 @@ pub const IWriter = extern struct {
 
     fn Mixin(comptime T: type) type {
         return struct {
-            fn beginAppendBuffer(self: *T, max_size: usize) []u8 {
+            fn beginAppendBuffer(self: *T, max_size: usize) ![]u8 {
                 const vtable: *const VTable = @ptrCast(self.vtable);
-                return vtable.beginAppendBuffer(@ptrCast(self), max_size).?[0..max_size];
+                const buffer = vtable.beginAppendBuffer(@ptrCast(self), max_size) orelse return error.AppendBufferFailed;
+                return buffer[0..max_size];
             }
 
-            fn endAppendBuffer(self: *T, buffer: []const u8) !void {
+            fn endAppendBuffer(self: *T, buffer: []u8) !void {
                 const vtable: *const VTable = @ptrCast(self.vtable);
-                try vtable.endAppendBuffer(@ptrCast(self), buffer.ptr, buffer.len);
+                try vtable.endAppendBuffer(@ptrCast(self), buffer.ptr, buffer.len).check();
             }
 
             fn write(self: *T, chars: []const u8) !void {
                 const vtable: *const VTable = @ptrCast(self.vtable);
-                try vtable.write(@ptrCast(self), chars.ptr, chars.len);
+                try vtable.write(@ptrCast(self), chars.ptr, chars.len).check();
             }
 
             fn flush(self: *T) void {
@@ -1170,7 +1196,7 @@ pub const IWriter = extern struct {
 
             fn setMode(self: *T, mode: WriterMode) !void {
                 const vtable: *const VTable = @ptrCast(self.vtable);
-                try vtable.setMode(@ptrCast(self), mode);
+                try vtable.setMode(@ptrCast(self), mode).check();
             }
         };
     }
@@ -1253,7 +1279,7 @@ pub const GenericArgType = enum(i32) {
     bool = 2,
 };
 
-const TypeKind = enum(u32) {
+pub const TypeKind = enum(u32) {
     none = 0,
     @"struct",
     array,
@@ -1276,7 +1302,7 @@ const TypeKind = enum(u32) {
     dynamic_resource,
 };
 
-const ScalarType = enum(u32) {
+pub const ScalarType = enum(u32) {
     none = 0,
     void,
     bool,
@@ -1295,7 +1321,7 @@ const ScalarType = enum(u32) {
     uintptr,
 };
 
-const DeclKind = enum(u32) {
+pub const DeclKind = enum(u32) {
     unsupported_for_reflection = 0,
     @"struct",
     func,
@@ -1447,10 +1473,10 @@ pub const TypeReflection = opaque {
     pub const getElementCount = cdef.spReflectionType_GetSpecializedElementCount;
 
     pub fn getTotalArrayElementCount(self: *TypeReflection) usize {
-        var result: usize = 0;
+        var result: usize = 1;
         var ptr = self;
         while (ptr.isArray()) {
-            result *= ptr.getElementCount();
+            result *= ptr.getElementCount(null);
             ptr = ptr.getElementType();
         }
         return result;
@@ -1465,10 +1491,10 @@ pub const TypeReflection = opaque {
     pub const getResourceResultType = cdef.spReflectionType_GetResourceResultType;
     pub const getName = cdef.spReflectionType_GetName;
 
-    pub fn getFullName(self: *TypeReflection) !*IBlob {
+    pub fn getFullName(self: *TypeReflection) !Owned(IBlob) {
         var name: *IBlob = undefined;
         try cdef.spReflectionType_GetFullName(self, &name).check();
-        return name;
+        return owned(name);
     }
 
     pub const getGenericContainer = cdef.spReflectionType_GetGenericContainer;
@@ -1815,10 +1841,11 @@ pub const EntryPointReflection = opaque {
     pub const getParameterByIndex = cdef.spReflectionEntryPoint_getParameterByIndex;
     pub const getStage = cdef.spReflectionEntryPoint_getStage;
 
-    pub fn getComputeThreadGroupSize(self: *EntryPointReflection, axis_count: u64) u64 {
-        var size_along_axis: u64 = undefined;
-        cdef.spReflectionEntryPoint_getComputeThreadGroupSize(self, axis_count, &size_along_axis);
-        return size_along_axis;
+    /// Size along x, y and z
+    pub fn getComputeThreadGroupSize(self: *EntryPointReflection) [3]u64 {
+        var sizes: [3]u64 = undefined;
+        cdef.spReflectionEntryPoint_getComputeThreadGroupSize(self, sizes.len, &sizes);
+        return sizes;
     }
 
     pub fn getComputeWaveSize(self: *EntryPointReflection) u64 {
@@ -1884,7 +1911,8 @@ pub const ShaderReflection = opaque {
         out_diagnostics: ?**IBlob,
     ) *TypeReflection {
         const diagnostics = getDiagnosticsPtr(out_diagnostics);
-        defer logDiagnostics(diagnostics, out_diagnostics);
+        const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+        defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
         return cdef.spReflection_specializeType(self, type_refl, @intCast(specialization_args.len), specialization_args.ptr, diagnostics);
     }
 
@@ -1897,7 +1925,8 @@ pub const ShaderReflection = opaque {
     ) *GenericReflection {
         std.debug.assert(arg_types.len == args.len);
         const diagnostics = getDiagnosticsPtr(out_diagnostics);
-        defer logDiagnostics(diagnostics, out_diagnostics);
+        const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+        defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
         return cdef.spReflection_specializeGeneric(self, generic, @intCast(args.len), arg_types.ptr, args.ptr, diagnostics);
     }
 
@@ -1913,10 +1942,10 @@ pub const ShaderReflection = opaque {
     pub const getGlobalParamsTypeLayout = cdef.spReflection_getGlobalParamsTypeLayout;
     pub const getGlobalParamsVarLayout = cdef.spReflection_getGlobalParamsVarLayout;
 
-    pub fn toJson(self: *ShaderReflection) !*IBlob {
+    pub fn toJson(self: *ShaderReflection) !Owned(IBlob) {
         var blob: *IBlob = undefined;
-        try cdef.spReflection_ToJson(self, null, &blob);
-        return blob;
+        try cdef.spReflection_ToJson(self, null, &blob).check();
+        return owned(blob);
     }
 };
 pub const ProgramLayout = ShaderReflection;
@@ -2001,9 +2030,15 @@ pub const GetCompilerElapsedTimeResult = struct {
     downstream_time: f64,
 };
 
+/// The strings and arrays of `session_desc` live in `aux_allocation`, the description can only
+/// be used until `deinit` is called.
 pub const ParseCommandLineArgumentsResult = struct {
     session_desc: SessionDesc,
-    aux_allocation: *IUnknown,
+    aux_allocation: Owned(IUnknown),
+
+    pub fn deinit(self: *ParseCommandLineArgumentsResult) void {
+        self.aux_allocation.release();
+    }
 };
 
 pub const IGlobalSession = extern struct {
@@ -2080,11 +2115,11 @@ pub const IGlobalSession = extern struct {
 
     fn Mixin(comptime T: type) type {
         return struct {
-            fn createSession(self: *T, desc: SessionDesc) !*ISession {
+            fn createSession(self: *T, desc: SessionDesc) !Owned(ISession) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var session: *ISession = undefined;
                 try vtable.createSession(@ptrCast(self), &desc.toSlang(), &session).check();
-                return session;
+                return owned(session);
             }
 
             fn findProfile(self: *T, name: [*:0]const u8) ProfileID {
@@ -2102,11 +2137,11 @@ pub const IGlobalSession = extern struct {
                 vtable.setDownstreamCompilerPrelude(@ptrCast(self), pass_through, predule_text);
             }
 
-            fn getDownstreamCompilerPrelude(self: *T, pass_through: PassThrough) *IBlob {
+            fn getDownstreamCompilerPrelude(self: *T, pass_through: PassThrough) Owned(IBlob) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var prelude: *IBlob = undefined;
                 vtable.getDownstreamCompilerPrelude(@ptrCast(self), pass_through, &prelude);
-                return prelude;
+                return owned(prelude);
             }
 
             fn getBuildTagString(self: *T) [*:0]const u8 {
@@ -2129,19 +2164,19 @@ pub const IGlobalSession = extern struct {
                 vtable.setLanguagePrelude(@ptrCast(self), source_language, prelude_text);
             }
 
-            fn getLanguagePrelude(self: *T, source_language: SourceLanguage) *IBlob {
+            fn getLanguagePrelude(self: *T, source_language: SourceLanguage) Owned(IBlob) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var prelude: *IBlob = undefined;
                 vtable.getLanguagePrelude(@ptrCast(self), source_language, &prelude);
-                return prelude;
+                return owned(prelude);
             }
 
             /// Deprecated
-            fn createCompileRequest(self: *IGlobalSession) callconv(mcall) !*ICompileRequest {
+            fn createCompileRequest(self: *T) !Owned(ICompileRequest) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var compiler_request: *ICompileRequest = undefined;
                 try vtable.createCompileRequest(@ptrCast(self), &compiler_request).check();
-                return compiler_request;
+                return owned(compiler_request);
             }
 
             fn addBuiltins(self: *T, source_path: [*:0]const u8, source_string: [*:0]const u8) void {
@@ -2179,11 +2214,11 @@ pub const IGlobalSession = extern struct {
                 try vtable.loadCoreModule(@ptrCast(self), core_module.ptr, core_module.len).check();
             }
 
-            fn saveCoreModule(self: *T, archive_type: ArchiveType) !*IBlob {
+            fn saveCoreModule(self: *T, archive_type: ArchiveType) !Owned(IBlob) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var blob: *IBlob = undefined;
                 try vtable.saveCoreModule(@ptrCast(self), archive_type, &blob).check();
-                return blob;
+                return owned(blob);
             }
 
             fn findCapability(self: *T, name: [*:0]const u8) CapabilityID {
@@ -2219,17 +2254,17 @@ pub const IGlobalSession = extern struct {
                 var session_desc: SessionDescExtern = undefined;
                 try vtable.parseCommandLineArguments(@ptrCast(self), @intCast(args.len), args.ptr, &session_desc, &aux_allocation).check();
                 return .{
-                    .aux_allocation = aux_allocation,
+                    .aux_allocation = owned(aux_allocation),
                     .session_desc = session_desc.fromSlang(),
                 };
             }
 
-            fn getSessionDescDigest(self: *T, session_desc: SessionDesc) !*IBlob {
+            fn getSessionDescDigest(self: *T, session_desc: SessionDesc) !Owned(IBlob) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var blob: *IBlob = undefined;
                 var desc = session_desc.toSlang();
                 try vtable.getSessionDescDigest(@ptrCast(self), &desc, &blob).check();
-                return blob;
+                return owned(blob);
             }
 
             fn compileBuiltinModule(self: *T, module: BuiltinModuleName, flags: CompileCoreModuleFlags) !void {
@@ -2242,11 +2277,11 @@ pub const IGlobalSession = extern struct {
                 try vtable.loadBuiltinModule(@ptrCast(self), module, module_data.ptr, module_data.len).check();
             }
 
-            fn saveBuiltinModule(self: *T, module: BuiltinModuleName, archive_type: ArchiveType) !*IBlob {
+            fn saveBuiltinModule(self: *T, module: BuiltinModuleName, archive_type: ArchiveType) !Owned(IBlob) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var blob: *IBlob = undefined;
                 try vtable.saveBuiltinModule(@ptrCast(self), module, archive_type, &blob).check();
-                return blob;
+                return owned(blob);
             }
         };
     }
@@ -2269,7 +2304,7 @@ pub const SessionFlags = enum(u32) {
     none = 0,
 };
 
-const PreprocessorMacroDesc = extern struct {
+pub const PreprocessorMacroDesc = extern struct {
     name: [*:0]const u8,
     value: [*:0]const u8,
 };
@@ -2286,6 +2321,64 @@ pub const SessionDesc = struct {
     compiler_option_entries: []const CompilerOptionEntry = &.{},
     skip_spirv_validation: bool = false,
 
+    /// Feeds everything that affects the created session into `hasher`, following the pointers to
+    /// strings and arrays. The file system is hashed by identity. `hasher` can be anything with an
+    /// `update([]const u8)` method.
+    pub fn hash(self: SessionDesc, hasher: anytype) void {
+        hashBytes(hasher, std.mem.asBytes(&self.targets.len));
+        for (self.targets) |target| {
+            hashBytes(hasher, std.mem.asBytes(&target.format));
+            hashBytes(hasher, std.mem.asBytes(&target.profile));
+            hashBytes(hasher, std.mem.asBytes(&target.flags));
+            hashBytes(hasher, std.mem.asBytes(&target.floating_point_mode));
+            hashBytes(hasher, std.mem.asBytes(&target.line_directive_mode));
+            hashBytes(hasher, std.mem.asBytes(&target.force_glsl_scalar_buffer_layout));
+            const entries = if (target.compiler_option_entries) |entries| entries[0..target.compiler_option_entry_count] else &.{};
+            hashCompilerOptionEntries(hasher, entries);
+        }
+        hashBytes(hasher, std.mem.asBytes(&self.flags));
+        hashBytes(hasher, std.mem.asBytes(&self.default_matrix_layout_mode));
+        hashBytes(hasher, std.mem.asBytes(&self.search_paths.len));
+        for (self.search_paths) |path| hashString(hasher, path);
+        hashBytes(hasher, std.mem.asBytes(&self.preprpcessor_macros.len));
+        for (self.preprpcessor_macros) |macro| {
+            hashString(hasher, macro.name);
+            hashString(hasher, macro.value);
+        }
+        hashBytes(hasher, std.mem.asBytes(&self.file_system));
+        hashBytes(hasher, std.mem.asBytes(&self.enable_effect_annotations));
+        hashBytes(hasher, std.mem.asBytes(&self.allow_glsl_syntax));
+        hashCompilerOptionEntries(hasher, self.compiler_option_entries);
+        hashBytes(hasher, std.mem.asBytes(&self.skip_spirv_validation));
+    }
+
+    fn hashCompilerOptionEntries(hasher: anytype, entries: []const CompilerOptionEntry) void {
+        hashBytes(hasher, std.mem.asBytes(&entries.len));
+        for (entries) |entry| {
+            hashBytes(hasher, std.mem.asBytes(&entry.name));
+            hashBytes(hasher, std.mem.asBytes(&entry.value.kind));
+            hashBytes(hasher, std.mem.asBytes(&entry.value.int_value_0));
+            hashBytes(hasher, std.mem.asBytes(&entry.value.int_value_1));
+            hashOptionalString(hasher, entry.value.string_value_0);
+            hashOptionalString(hasher, entry.value.string_value_1);
+        }
+    }
+
+    fn hashBytes(hasher: anytype, bytes: []const u8) void {
+        hasher.update(bytes);
+    }
+
+    fn hashString(hasher: anytype, string: [*:0]const u8) void {
+        const bytes = std.mem.span(string);
+        hasher.update(std.mem.asBytes(&bytes.len));
+        hasher.update(bytes);
+    }
+
+    fn hashOptionalString(hasher: anytype, string: ?[*:0]const u8) void {
+        hasher.update(&.{@intFromBool(string != null)});
+        if (string) |s| hashString(hasher, s);
+    }
+
     fn toSlang(self: SessionDesc) SessionDescExtern {
         for (self.targets, 0..) |desc, i| {
             if (desc.compiler_option_entries != null and desc.compiler_option_entry_count == 0) {
@@ -2312,7 +2405,7 @@ pub const SessionDesc = struct {
     }
 };
 
-const SessionDescExtern = extern struct {
+pub const SessionDescExtern = extern struct {
     _structure_size: usize = @sizeOf(@This()),
     targets: ?[*]const TargetDesc = null,
     target_count: i64 = 0,
@@ -2331,21 +2424,21 @@ const SessionDescExtern = extern struct {
 
     fn fromSlang(self: SessionDescExtern) SessionDesc {
         return SessionDesc{
-            .targets = if (self.targets != null) self.targets[0..@intCast(self.target_count)] else &.{},
+            .targets = if (self.targets) |targets| targets[0..@intCast(self.target_count)] else &.{},
             .flags = self.flags,
             .default_matrix_layout_mode = self.default_matrix_layout_mode,
-            .search_paths = if (self.search_paths != null) self.search_paths[0..@intCast(self.search_path_count)] else &.{},
-            .preprpcessor_macros = if (self.preprpcessor_macros != null) self.preprpcessor_macros[0..@intCast(self.preprocessor_macro_count)] else &.{},
+            .search_paths = if (self.search_paths) |paths| paths[0..@intCast(self.search_path_count)] else &.{},
+            .preprpcessor_macros = if (self.preprpcessor_macros) |macros| macros[0..@intCast(self.preprocessor_macro_count)] else &.{},
             .file_system = self.file_system,
             .enable_effect_annotations = self.enable_effect_annotations,
             .allow_glsl_syntax = self.allow_glsl_syntax,
-            .compiler_option_entries = if (self.compiler_options_entries != null) self.compiler_options_entries[0..@intCast(self.compiler_option_entry_count)] else &.{},
+            .compiler_option_entries = if (self.compiler_options_entries) |entries| entries[0..@intCast(self.compiler_option_entry_count)] else &.{},
             .skip_spirv_validation = self.skip_spirv_validation,
         };
     }
 };
 
-const ContainerType = enum(i32) {
+pub const ContainerType = enum(i32) {
     none = 0,
     unsizedarray,
     structuredbuffer,
@@ -2403,12 +2496,12 @@ pub const ISession = extern struct {
         path: [*:0]const u8,
         source: [:0]const u8,
         out_diagnostics: ?**IBlob,
-    ) ?*IModule {
+    ) ?Owned(IModule) {
         const diagnostics = getDiagnosticsPtr(out_diagnostics);
-        defer logDiagnostics(diagnostics, out_diagnostics);
+        const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+        defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
         const module = cdef.slang_loadModuleFromSource(self, module_name, path, source.ptr, source.len, diagnostics) orelse return null;
-        module.addRef();
-        return module;
+        return Owned(IModule).retain(module);
     }
 
     /// Load a module from IR data.
@@ -2425,12 +2518,12 @@ pub const ISession = extern struct {
         path: [*:0]const u8,
         source: []const u8,
         out_diagnostics: ?**IBlob,
-    ) ?*IModule {
+    ) ?Owned(IModule) {
         const diagnostics = getDiagnosticsPtr(out_diagnostics);
-        defer logDiagnostics(diagnostics, out_diagnostics);
+        const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+        defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
         const module = cdef.slang_loadModuleFromIRBlob(self, module_name, path, source.ptr, source.len, diagnostics) orelse return null;
-        module.addRef();
-        return module;
+        return Owned(IModule).retain(module);
     }
 
     /// Read module info (name and version) from IR data.
@@ -2453,7 +2546,7 @@ pub const ISession = extern struct {
         loadModule: *const fn (this: *ISession, module_name: [*:0]const u8, out_diagnostics: ?**IBlob) callconv(mcall) ?*IModule,
         loadModuleFromSource: *const fn (this: *ISession, module_name: [*:0]const u8, path: [*:0]const u8, source: *IBlob, out_diagnostics: ?**IBlob) callconv(mcall) ?*IModule,
         createCompositeComponentType: *const fn (this: *ISession, component_types: [*]const *IComponentType, component_type_count: i64, out_composite_component_type: **IComponentType, out_diagnostics: ?**IBlob) callconv(mcall) Result,
-        specializeType: *const fn (this: *ISession, type: *TypeReflection, specialization_args: [*]const SpecializationArg, specialization_arg_count: i64, out_diagnostics: ?**IBlob) callconv(mcall) *TypeReflection,
+        specializeType: *const fn (this: *ISession, type: *TypeReflection, specialization_args: [*]const SpecializationArg, specialization_arg_count: i64, out_diagnostics: ?**IBlob) callconv(mcall) ?*TypeReflection,
         getTypeLayout: *const fn (this: *ISession, type: *TypeReflection, target_index: i64, rules: LayoutRules, out_diagnostics: ?**IBlob) callconv(mcall) *TypeLayoutReflection,
         getContainerType: *const fn (this: *ISession, element_type: *TypeReflection, container_type: ContainerType, out_diagnostics: ?**IBlob) callconv(mcall) *TypeReflection,
         getDynamicType: *const fn (this: *ISession) callconv(mcall) *TypeReflection,
@@ -2475,53 +2568,57 @@ pub const ISession = extern struct {
         return struct {
             fn getGlobalSession(self: *T) *IGlobalSession {
                 const vtable: *const VTable = @ptrCast(self.vtable);
-                vtable.getGlobalSession(@ptrCast(self));
+                return vtable.getGlobalSession(@ptrCast(self));
             }
 
-            fn loadModule(self: *T, module_name: [*:0]const u8, out_diagnostics: ?**IBlob) ?*IModule {
+            fn loadModule(self: *T, module_name: [*:0]const u8, out_diagnostics: ?**IBlob) ?Owned(IModule) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 const module = vtable.loadModule(@ptrCast(self), module_name, diagnostics) orelse return null;
-                module.addRef();
-                return module;
+                return Owned(IModule).retain(module);
             }
 
-            fn loadModuleFromSourceBlob(self: *T, module_name: [*:0]const u8, path: [*:0]const u8, source: *IBlob, out_diagnostics: ?**IBlob) ?*IModule {
+            fn loadModuleFromSourceBlob(self: *T, module_name: [*:0]const u8, path: [*:0]const u8, source: *IBlob, out_diagnostics: ?**IBlob) ?Owned(IModule) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 const module = vtable.loadModuleFromSource(@ptrCast(self), module_name, path, source, diagnostics) orelse return null;
-                module.addRef();
-                return module;
+                return Owned(IModule).retain(module);
             }
 
-            fn createCompositeComponentType(self: *T, component_types: []const *IComponentType, out_diagnostics: ?**IBlob) !*IComponentType {
+            fn createCompositeComponentType(self: *T, component_types: []const *IComponentType, out_diagnostics: ?**IBlob) !Owned(IComponentType) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var component_type: *IComponentType = undefined;
                 try vtable.createCompositeComponentType(@ptrCast(self), component_types.ptr, @intCast(component_types.len), &component_type, diagnostics).check();
-                return component_type;
+                return owned(component_type);
             }
 
-            fn specializeType(self: *T, type_: *TypeReflection, specialization_args: []const SpecializationArg, out_diagnostics: ?**IBlob) *TypeReflection {
+            fn specializeType(self: *T, type_: *TypeReflection, specialization_args: []const SpecializationArg, out_diagnostics: ?**IBlob) ?*TypeReflection {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 return vtable.specializeType(@ptrCast(self), type_, specialization_args.ptr, @intCast(specialization_args.len), diagnostics);
             }
 
             fn getTypeLayout(self: *T, type_: *TypeReflection, target_index: i64, rules: LayoutRules, out_diagnostics: ?**IBlob) *TypeLayoutReflection {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 return vtable.getTypeLayout(@ptrCast(self), type_, target_index, rules, diagnostics);
             }
 
             fn getContainerType(self: *T, element_type: *TypeReflection, container_type: ContainerType, out_diagnostics: ?**IBlob) *TypeReflection {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 return vtable.getContainerType(@ptrCast(self), element_type, container_type, diagnostics);
             }
@@ -2531,18 +2628,18 @@ pub const ISession = extern struct {
                 return vtable.getDynamicType(@ptrCast(self));
             }
 
-            fn getTypeRTTIMangledName(self: *T, type_: *TypeReflection) !*IBlob {
+            fn getTypeRTTIMangledName(self: *T, type_: *TypeReflection) !Owned(IBlob) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var name_blob: *IBlob = undefined;
                 try vtable.getTypeRTTIMangledName(@ptrCast(self), type_, &name_blob).check();
-                return name_blob;
+                return owned(name_blob);
             }
 
-            fn getTypeConformanceWitnessMangledName(self: *T, type_: *TypeReflection, interface_type: *TypeReflection) !*IBlob {
+            fn getTypeConformanceWitnessMangledName(self: *T, type_: *TypeReflection, interface_type: *TypeReflection) !Owned(IBlob) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var name_blob: *IBlob = undefined;
                 try vtable.getTypeConformanceWitnessMangledName(@ptrCast(self), type_, interface_type, &name_blob).check();
-                return name_blob;
+                return owned(name_blob);
             }
 
             fn getTypeConformanceWitnessSequentialID(self: *T, type_: *TypeReflection, interface_type: *TypeReflection) !u32 {
@@ -2552,29 +2649,30 @@ pub const ISession = extern struct {
                 return id;
             }
 
-            fn createCompileRequest(self: *T) !*ICompileResult {
+            fn createCompileRequest(self: *T) !Owned(ICompileRequest) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var compile_request: *ICompileRequest = undefined;
                 try vtable.createCompileRequest(@ptrCast(self), &compile_request).check();
-                return compile_request;
+                return owned(compile_request);
             }
 
-            fn createTypeConformanceComponentType(self: *T, type_: *TypeReflection, interface_type: *TypeReflection, conformance_id_override: i64, out_diagnostics: ?**IBlob) !*ITypeConformance {
+            fn createTypeConformanceComponentType(self: *T, type_: *TypeReflection, interface_type: *TypeReflection, conformance_id_override: i64, out_diagnostics: ?**IBlob) !Owned(ITypeConformance) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var conformance: *ITypeConformance = undefined;
                 try vtable.createTypeConformanceComponentType(@ptrCast(self), type_, interface_type, &conformance, conformance_id_override, diagnostics).check();
-                return conformance;
+                return owned(conformance);
             }
 
-            fn loadModuleFromIRBlob(self: *T, module_name: [*:0]const u8, path: [*:0]const u8, source: *IBlob, out_diagnostics: ?**IBlob) ?*IModule {
+            fn loadModuleFromIRBlob(self: *T, module_name: [*:0]const u8, path: [*:0]const u8, source: *IBlob, out_diagnostics: ?**IBlob) ?Owned(IModule) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 const module = vtable.loadModuleFromIRBlob(@ptrCast(self), module_name, path, source, diagnostics) orelse return null;
-                module.addRef();
-                return module;
+                return Owned(IModule).retain(module);
             }
 
             fn getLoadedModuleCount(self: *T) usize {
@@ -2593,18 +2691,18 @@ pub const ISession = extern struct {
                 return vtable.isBinaryModuleUpToDate(@ptrCast(self), module_path, binary_module_blob);
             }
 
-            fn loadModuleFromSourceString(self: *T, module_name: [:0]const u8, path: [:0]const u8, source_str: [:0]const u8, out_diagnostics: ?**IBlob) ?*IModule {
+            fn loadModuleFromSourceString(self: *T, module_name: [:0]const u8, path: [:0]const u8, source_str: [:0]const u8, out_diagnostics: ?**IBlob) ?Owned(IModule) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 const module = vtable.loadModuleFromSourceString(@ptrCast(self), module_name.ptr, path.ptr, source_str.ptr, diagnostics) orelse return null;
-                module.addRef();
-                return module;
+                return Owned(IModule).retain(module);
             }
 
             fn getDynamicObjectRTTIBytes(self: *T, type_: *TypeReflection, interface_type: *TypeReflection, out_rtti_data_buffer: []u32) !void {
                 const vtable: *const VTable = @ptrCast(self.vtable);
-                try vtable.getDynamicObjectRTTIBytes(@ptrCast(self), type_, interface_type, out_rtti_data_buffer.ptr, @intCast(out_rtti_data_buffer.len)).check();
+                try vtable.getDynamicObjectRTTIBytes(@ptrCast(self), type_, interface_type, out_rtti_data_buffer.ptr, @intCast(out_rtti_data_buffer.len * @sizeOf(u32))).check();
             }
 
             fn loadModuleInfoFromIRBlob(self: *T, source: *IBlob) !LoadModuleInfoFromIRBlobResult {
@@ -2679,18 +2777,18 @@ pub const ICompileResult = extern struct {
                 return vtable.getItemCount(@ptrCast(self));
             }
 
-            fn getItemData(self: *T, index: u32) !*IBlob {
+            fn getItemData(self: *T, index: u32) !Owned(IBlob) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var blob: *IBlob = undefined;
                 try vtable.getItemData(@ptrCast(self), index, &blob).check();
-                return blob;
+                return owned(blob);
             }
 
-            fn getMetadata(self: *T) !*IMetadata {
+            fn getMetadata(self: *T) !Owned(IMetadata) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
-                var blob: *IBlob = undefined;
-                try vtable.getMetadata(@ptrCast(self), &blob).check();
-                return blob;
+                var metadata: *IMetadata = undefined;
+                try vtable.getMetadata(@ptrCast(self), &metadata).check();
+                return owned(metadata);
             }
         };
     }
@@ -2726,7 +2824,7 @@ pub const IComponentType = extern struct {
         getSpecializationParamCount: *const fn (this: *IComponentType) callconv(mcall) i64,
         getEntryPointCode: *const fn (this: *IComponentType, entry_point_index: i64, target_index: i64, out_code: **IBlob, out_diagnostics: ?**IBlob) callconv(mcall) Result,
         getResultAsFileSystem: *const fn (this: *IComponentType, entry_point_index: i64, target_index: i64, out_file_system: **IMutableFileSystem) callconv(mcall) Result,
-        getEntryPointHash: *const fn (this: *IComponentType, entry_point_index: i64, target_index: i64, out_hash: **IBlob) callconv(mcall) Result,
+        getEntryPointHash: *const fn (this: *IComponentType, entry_point_index: i64, target_index: i64, out_hash: **IBlob) callconv(mcall) void,
         specialize: *const fn (this: *IComponentType, specialization_args: [*]const SpecializationArg, specialization_arg_count: i64, out_specialized_component_type: **IComponentType, out_diagnostics: ?**IBlob) callconv(mcall) Result,
         link: *const fn (this: *IComponentType, out_linked_component_type: **IComponentType, out_diagnostics: ?**IBlob) callconv(mcall) Result,
         getEntryPointHostCallable: *const fn (this: *IComponentType, entry_point_index: i32, target_index: i32, out_shared_library: **ISharedLibrary, out_diagnostics: ?**IBlob) callconv(mcall) Result,
@@ -2740,13 +2838,14 @@ pub const IComponentType = extern struct {
     fn Mixin(comptime T: type) type {
         return struct {
             fn getSession(self: *T) *ISession {
-                const vtable: *const VTable = @ptrCast(self);
+                const vtable: *const VTable = @ptrCast(self.vtable);
                 return vtable.getSession(@ptrCast(self));
             }
 
             fn getLayout(self: *T, target_index: i64, out_diagnostics: ?**IBlob) ?*ProgramLayout {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 return vtable.getLayout(@ptrCast(self), target_index, diagnostics);
             }
@@ -2756,97 +2855,105 @@ pub const IComponentType = extern struct {
                 return @intCast(vtable.getSpecializationParamCount(@ptrCast(self)));
             }
 
-            fn getEntryPointCode(self: *T, entry_point_index: i64, target_index: i64, out_diagnostics: ?**IBlob) !*IBlob {
+            fn getEntryPointCode(self: *T, entry_point_index: i64, target_index: i64, out_diagnostics: ?**IBlob) !Owned(IBlob) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var code: *IBlob = undefined;
                 try vtable.getEntryPointCode(@ptrCast(self), entry_point_index, target_index, &code, diagnostics).check();
-                return code;
+                return owned(code);
             }
 
-            fn getResultAsFileSystem(self: *T, entry_point_index: i64, target_index: i64) !*IMutableFileSystem {
+            fn getResultAsFileSystem(self: *T, entry_point_index: i64, target_index: i64) !Owned(IMutableFileSystem) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var file_system: *IMutableFileSystem = undefined;
                 try vtable.getResultAsFileSystem(@ptrCast(self), entry_point_index, target_index, &file_system).check();
-                return file_system;
+                return owned(file_system);
             }
 
-            fn getEntryPointHash(self: *T, entry_point_index: i64, target_index: i64) *IBlob {
+            fn getEntryPointHash(self: *T, entry_point_index: i64, target_index: i64) Owned(IBlob) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var hash: *IBlob = undefined;
-                try vtable.getEntryPointHash(@ptrCast(self), entry_point_index, target_index, &hash).check();
-                return hash;
+                vtable.getEntryPointHash(@ptrCast(self), entry_point_index, target_index, &hash);
+                return owned(hash);
             }
 
-            fn specialize(self: *T, specialization_args: []const SpecializationArg, out_diagnostics: ?**IBlob) !*IComponentType {
+            fn specialize(self: *T, specialization_args: []const SpecializationArg, out_diagnostics: ?**IBlob) !Owned(IComponentType) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var component_type: *IComponentType = undefined;
                 try vtable.specialize(@ptrCast(self), specialization_args.ptr, @intCast(specialization_args.len), &component_type, diagnostics).check();
-                return component_type;
+                return owned(component_type);
             }
 
-            fn link(self: *T, out_diagnostics: ?**IBlob) !*IComponentType {
+            fn link(self: *T, out_diagnostics: ?**IBlob) !Owned(IComponentType) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var linked_component_type: *IComponentType = undefined;
                 try vtable.link(@ptrCast(self), &linked_component_type, diagnostics).check();
-                return linked_component_type;
+                return owned(linked_component_type);
             }
 
-            fn getEntryPointHostCallable(self: *T, entry_point_index: i32, target_index: i32, out_diagnostics: ?**IBlob) !*ISharedLibrary {
+            fn getEntryPointHostCallable(self: *T, entry_point_index: i32, target_index: i32, out_diagnostics: ?**IBlob) !Owned(ISharedLibrary) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var shared_library: *ISharedLibrary = undefined;
                 try vtable.getEntryPointHostCallable(@ptrCast(self), entry_point_index, target_index, &shared_library, diagnostics).check();
-                return shared_library;
+                return owned(shared_library);
             }
 
-            fn renameEntryPoint(self: *T, new_name: [*:0]const u8) !*IComponentType {
+            fn renameEntryPoint(self: *T, new_name: [*:0]const u8) !Owned(IComponentType) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var entry_point: *IComponentType = undefined;
                 try vtable.renameEntryPoint(@ptrCast(self), new_name, &entry_point).check();
-                return entry_point;
+                return owned(entry_point);
             }
 
-            fn linkWithOptions(self: *T, compiler_option_entries: []const CompilerOptionEntry, out_diagnostics: ?**IBlob) !*IComponentType {
+            fn linkWithOptions(self: *T, compiler_option_entries: []const CompilerOptionEntry, out_diagnostics: ?**IBlob) !Owned(IComponentType) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var linked_component_type: *IComponentType = undefined;
                 try vtable.linkWithOptions(@ptrCast(self), &linked_component_type, @intCast(compiler_option_entries.len), compiler_option_entries.ptr, diagnostics).check();
-                return linked_component_type;
+                return owned(linked_component_type);
             }
 
-            fn getTargetCode(self: *T, target_index: i64, out_diagnostics: ?**IBlob) !*IBlob {
+            fn getTargetCode(self: *T, target_index: i64, out_diagnostics: ?**IBlob) !Owned(IBlob) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var code: *IBlob = undefined;
                 try vtable.getTargetCode(@ptrCast(self), target_index, &code, diagnostics).check();
-                return code;
+                return owned(code);
             }
 
-            fn getTargetMetadata(self: *T, target_index: i64, out_diagnostics: ?**IBlob) !*IMetadata {
+            fn getTargetMetadata(self: *T, target_index: i64, out_diagnostics: ?**IBlob) !Owned(IMetadata) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var metadata: *IMetadata = undefined;
                 try vtable.getTargetMetadata(@ptrCast(self), target_index, &metadata, diagnostics).check();
-                return metadata;
+                return owned(metadata);
             }
 
-            fn getEntryPointMetadata(self: *T, entry_point_index: i64, target_index: i64, out_diagnostics: ?**IBlob) !*IMetadata {
+            fn getEntryPointMetadata(self: *T, entry_point_index: i64, target_index: i64, out_diagnostics: ?**IBlob) !Owned(IMetadata) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var metadata: *IMetadata = undefined;
                 try vtable.getEntryPointMetadata(@ptrCast(self), entry_point_index, target_index, &metadata, diagnostics).check();
-                return metadata;
+                return owned(metadata);
             }
         };
     }
@@ -2896,6 +3003,12 @@ pub const ITypeConformance = extern struct {
 
     pub const uuid = UUID.init(0x73eb3147, 0xe544, 0x41b5, .{ 0xb8, 0xf0, 0xa2, 0x44, 0xdf, 0x21, 0x94, 0xb });
 
+    pub const queryInterface = IUnknown.Mixin(@This()).queryInterface;
+    pub const addRef = IUnknown.Mixin(@This()).addRef;
+    pub const release = IUnknown.Mixin(@This()).release;
+    pub const getSession = IComponentType.Mixin(@This()).getSession;
+    pub const getLayout = IComponentType.Mixin(@This()).getLayout;
+
     const VTable = IComponentType.VTable;
     const Mixin = IComponentType.Mixin;
 };
@@ -2919,22 +3032,24 @@ pub const IComponentType2 = extern struct {
 
     fn Mixin(comptime T: type) type {
         return struct {
-            fn getTargetCompileResult(self: *T, target_index: i64, out_diagnostics: ?**IBlob) !*ICompileResult {
+            fn getTargetCompileResult(self: *T, target_index: i64, out_diagnostics: ?**IBlob) !Owned(ICompileResult) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var compile_result: *ICompileResult = undefined;
                 try vtable.getTargetCompileResult(@ptrCast(self), target_index, &compile_result, diagnostics).check();
-                return compile_result;
+                return owned(compile_result);
             }
 
-            fn getEntryPointCompileResult(self: *T, entry_point_index: i64, target_index: i64, out_diagnostics: ?**IBlob) callconv(mcall) !*ICompileResult {
+            fn getEntryPointCompileResult(self: *T, entry_point_index: i64, target_index: i64, out_diagnostics: ?**IBlob) callconv(mcall) !Owned(ICompileResult) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var compile_result: *ICompileResult = undefined;
                 try vtable.getEntryPointCompileResult(@ptrCast(self), entry_point_index, target_index, &compile_result, diagnostics).check();
-                return compile_result;
+                return owned(compile_result);
             }
         };
     }
@@ -2995,11 +3110,11 @@ pub const IModule = extern struct {
 
     fn Mixin(comptime T: type) type {
         return struct {
-            fn findEntryPointByName(self: *T, name: [*:0]const u8) !*IEntryPoint {
+            fn findEntryPointByName(self: *T, name: [*:0]const u8) !Owned(IEntryPoint) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var entry_point: *IEntryPoint = undefined;
                 try vtable.findEntryPointByName(@ptrCast(self), name, &entry_point).check();
-                return entry_point;
+                return owned(entry_point);
             }
 
             fn getDefinedEntryPointCount(self: *T) i32 {
@@ -3007,18 +3122,18 @@ pub const IModule = extern struct {
                 return vtable.getDefinedEntryPointCount(@ptrCast(self));
             }
 
-            fn getDefinedEntryPoint(self: *T, index: i32) !*IEntryPoint {
+            fn getDefinedEntryPoint(self: *T, index: i32) !Owned(IEntryPoint) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var entry_point: *IEntryPoint = undefined;
                 try vtable.getDefinedEntryPoint(@ptrCast(self), index, &entry_point).check();
-                return entry_point;
+                return owned(entry_point);
             }
 
-            fn serialize(self: *T) !*IBlob {
+            fn serialize(self: *T) !Owned(IBlob) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var serialized_blob: *IBlob = undefined;
                 try vtable.serialize(@ptrCast(self), &serialized_blob).check();
-                return serialized_blob;
+                return owned(serialized_blob);
             }
 
             fn writeToFile(self: *T, file_name: [*:0]const u8) !void {
@@ -3041,13 +3156,14 @@ pub const IModule = extern struct {
                 return vtable.getUniqueIdentity(@ptrCast(self));
             }
 
-            fn findAndCheckEntryPoint(self: *T, name: [*:0]const u8, stage: Stage, out_diagnostics: ?**IBlob) !*IEntryPoint {
+            fn findAndCheckEntryPoint(self: *T, name: [*:0]const u8, stage: Stage, out_diagnostics: ?**IBlob) !Owned(IEntryPoint) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var entry_point: *IEntryPoint = undefined;
                 try vtable.findAndCheckEntryPoint(@ptrCast(self), name, stage, &entry_point, diagnostics).check();
-                return entry_point;
+                return owned(entry_point);
             }
 
             fn getDependencyFileCount(self: *T) i32 {
@@ -3065,11 +3181,11 @@ pub const IModule = extern struct {
                 return vtable.getModuleReflection(@ptrCast(self));
             }
 
-            fn disassemble(self: *T) !*IBlob {
+            fn disassemble(self: *T) !Owned(IBlob) {
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var disassembled_blob: *IBlob = undefined;
                 try vtable.disassemble(@ptrCast(self), &disassembled_blob).check();
-                return disassembled_blob;
+                return owned(disassembled_blob);
             }
         };
     }
@@ -3100,18 +3216,20 @@ pub const IModulePrecompileService_Experimental = extern struct {
         return struct {
             fn precompileForTarget(self: *T, target: CompileTarget, out_diagnostics: ?**IBlob) !void {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 try vtable.precompileForTarget(@ptrCast(self), target, diagnostics).check();
             }
 
-            fn getPrecompiledTargetCode(self: *T, target: CompileTarget, out_diagnostics: ?**IBlob) !*IBlob {
+            fn getPrecompiledTargetCode(self: *T, target: CompileTarget, out_diagnostics: ?**IBlob) !Owned(IBlob) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var code: *IBlob = undefined;
                 try vtable.getPrecompiledTargetCode(@ptrCast(self), target, &code, diagnostics).check();
-                return code;
+                return owned(code);
             }
 
             fn getModuleDependencyCount(self: *T) usize {
@@ -3119,14 +3237,15 @@ pub const IModulePrecompileService_Experimental = extern struct {
                 return @intCast(vtable.getModuleDependencyCount(@ptrCast(self)));
             }
 
-            /// The returned module should not be manually released
-            fn getModuleDependency(self: *T, dependency_index: i64, out_diagnostics: ?**IBlob) !*IModule {
+            fn getModuleDependency(self: *T, dependency_index: i64, out_diagnostics: ?**IBlob) !Owned(IModule) {
                 const diagnostics = getDiagnosticsPtr(out_diagnostics);
-                defer logDiagnostics(diagnostics, out_diagnostics);
+                const previous_diagnostics = snapshotDiagnostics(out_diagnostics);
+                defer logDiagnostics(diagnostics, out_diagnostics, previous_diagnostics);
                 const vtable: *const VTable = @ptrCast(self.vtable);
                 var module: *IModule = undefined;
                 try vtable.getModuleDependency(@ptrCast(self), dependency_index, &module, diagnostics).check();
-                return module;
+                // Slang hands out the module without a reference of its own
+                return Owned(IModule).retain(module);
             }
         };
     }
@@ -3171,7 +3290,7 @@ pub const LanguageVersion = enum(i32) {
     pub const latest = LanguageVersion.@"2026";
 };
 
-const GlobalSessionDesc = extern struct {
+pub const GlobalSessionDesc = extern struct {
     _structure_size: u32 = @sizeOf(@This()),
     api_version: u32 = API_VERSION,
     min_language_version: LanguageVersion = .@"2025",
@@ -3184,28 +3303,28 @@ const GlobalSessionDesc = extern struct {
 /// @param data Pointer to the binary data to store in the blob. Must not be null.
 /// @param size Size of the data in bytes. Must be greater than 0.
 /// @return The created blob on success, or nullptr on failure.
-pub fn createBlob(data: []const u8) ?*IBlob {
-    return cdef.slang_createBlob(data.ptr, data.len);
+pub fn createBlob(data: []const u8) ?Owned(IBlob) {
+    return owned(cdef.slang_createBlob(data.ptr, data.len) orelse return null);
 }
 
 /// Create a global session, with the built-in core module.
 ///
 /// @param apiVersion Pass in SLANG_API_VERSION
 /// @param outGlobalSession (out)The created global session.
-pub fn createGlobalSession2(api_version: i64) !*IGlobalSession {
+pub fn createGlobalSession2(api_version: i64) !Owned(IGlobalSession) {
     var global_session: *IGlobalSession = undefined;
     try cdef.slang_createGlobalSession(api_version, &global_session).check();
-    return global_session;
+    return owned(global_session);
 }
 
 /// Create a global session, with the built-in core module.
 ///
 /// @param desc Description of the global session.
 /// @param outGlobalSession (out)The created global session.
-pub fn createGlobalSession(desc: GlobalSessionDesc) !*IGlobalSession {
+pub fn createGlobalSession(desc: GlobalSessionDesc) !Owned(IGlobalSession) {
     var global_session: *IGlobalSession = undefined;
     try cdef.slang_createGlobalSession2(&desc, &global_session).check();
-    return global_session;
+    return owned(global_session);
 }
 
 /// Create a global session, but do not set up the core module. The core module can
@@ -3215,10 +3334,10 @@ pub fn createGlobalSession(desc: GlobalSessionDesc) !*IGlobalSession {
 /// @param outGlobalSession (out)The created global session that doesn't have a core module setup.
 ///
 /// NOTE! API is experimental and not ready for production code
-pub fn createGlobalSessionWithoutCoreModule(api_version: i64) !*IGlobalSession {
+pub fn createGlobalSessionWithoutCoreModule(api_version: i64) !Owned(IGlobalSession) {
     var global_session: *IGlobalSession = undefined;
     try cdef.slang_createGlobalSessionWithoutCoreModule(api_version, &global_session).check();
-    return global_session;
+    return owned(global_session);
 }
 
 /// Returns a blob that contains the serialized core module.
@@ -3232,11 +3351,71 @@ pub fn createGlobalSessionWithoutCoreModule(api_version: i64) !*IGlobalSession {
 /// reporting them as leaks. This function should only be called after all Slang objects
 /// have been released. No other Slang functions such as `createGlobalSession`
 /// should be called after this function.
-pub const shutdown = cdef.slang_shutdown;
+///
+/// With `track_com_lifetimes` enabled, every object handed out by the bindings that wasn't
+/// released yet is logged first.
+pub fn shutdown() void {
+    if (track_com_lifetimes) com_tracker.logLiveObjects();
+    cdef.slang_shutdown();
+}
+
+/// Writes every object handed out by the bindings that wasn't released yet, with the stack
+/// trace of where it was handed out. Does nothing unless `track_com_lifetimes` is enabled.
+pub fn writeLiveObjects(writer: *std.Io.Writer) !void {
+    if (track_com_lifetimes) try com_tracker.writeLiveObjects(writer);
+}
+
+/// Number of objects handed out by the bindings that weren't released yet, always 0 unless
+/// `track_com_lifetimes` is enabled.
+pub fn liveObjectCount() usize {
+    return if (track_com_lifetimes) com_tracker.liveCount() else 0;
+}
 
 /// Return the last signaled internal error message.
 pub const getLastInternalErrorMessage = cdef.slang_getLastInternalErrorMessage;
 
+// Utilities built on top of the bindings
+pub const DynamicTypeTable = @import("dynamic_dispatch.zig").DynamicTypeTable;
+pub const ObjectPacker = @import("dynamic_dispatch.zig").ObjectPacker;
+pub const TypeLayoutCache = @import("type_cache.zig").TypeLayoutCache;
+pub const StreamWriter = @import("writer.zig").StreamWriter;
+pub const RingWriter = @import("writer.zig").RingWriter;
+pub const CountingWriter = @import("writer.zig").CountingWriter;
+pub const MemoryLibraryLoader = @import("shared_library.zig").MemoryLibraryLoader;
+pub const SessionPool = @import("session_pool.zig").SessionPool;
+pub const residentSetSize = @import("session_pool.zig").residentSetSize;
+pub const DeclIndex = @import("decl_index.zig").DeclIndex;
+pub const HotReloader = @import("hot_reload.zig").HotReloader;
+pub const compileLibrary = @import("batch_compile.zig").compileLibrary;
+pub const BatchOptions = @import("batch_compile.zig").BatchOptions;
+pub const BatchResult = @import("batch_compile.zig").BatchResult;
+pub const compileStreaming = @import("stream_compile.zig").compileStreaming;
+pub const StreamOptions = @import("stream_compile.zig").StreamOptions;
+pub const OutputSink = @import("stream_compile.zig").OutputSink;
+pub const DirectorySink = @import("stream_compile.zig").DirectorySink;
+pub const OptionPreset = @import("option_preset.zig").OptionPreset;
+pub const optionPreset = @import("option_preset.zig").optionPreset;
+pub const fingerprintOptions = @import("option_preset.zig").fingerprint;
+pub const ArchiveWriter = @import("shader_archive.zig").ArchiveWriter;
+pub const ShaderArchive = @import("shader_archive.zig").ShaderArchive;
+pub const BlobLoader = @import("blob_loader.zig").BlobLoader;
+pub const OwnedBlob = @import("blob_loader.zig").OwnedBlob;
+pub const SliceBlob = @import("blob_loader.zig").SliceBlob;
+pub const analyzeUniforms = @import("uniform_packing.zig").analyzeUniforms;
+pub const PackingRules = @import("uniform_packing.zig").PackingRules;
+pub const PackingReport = @import("uniform_packing.zig").PackingReport;
+pub const tuneThreadGroupSize = @import("thread_group_tuner.zig").tuneThreadGroupSize;
+pub const TuneOptions = @import("thread_group_tuner.zig").TuneOptions;
+pub const TuneResult = @import("thread_group_tuner.zig").TuneResult;
+pub const RemoteCacheClient = @import("remote_cache.zig").Client;
+pub const RemoteCacheServer = @import("remote_cache.zig").Server;
+pub const remoteCacheKey = @import("remote_cache.zig").entryPointKey;
+pub const MemoryAccounting = @import("memory_accounting.zig").MemoryAccounting;
+pub const SessionAccount = @import("memory_accounting.zig").SessionAccount;
+pub const CountingAllocator = @import("memory_accounting.zig").CountingAllocator;
+pub const Owned = @import("owned.zig").Owned;
+pub const own = @import("owned.zig").own;
+
 const cdef = struct {
     extern fn spGetBuildTagString() [*:0]const u8;
     extern fn slang_createBlob(data: [*]const u8, size: usize) ?*IBlob;
@@ -3264,7 +3443,7 @@ const cdef = struct {
     extern fn spReflectionType_GetFieldCount(self: *TypeReflection) u32;
     extern fn spReflectionType_GetFieldByIndex(self: *TypeReflection, index: u32) *VariableReflection;
     extern fn spReflectionType_GetElementCount(self: *TypeReflection) usize;
-    extern fn spReflectionType_GetSpecializedElementCount(self: *TypeReflection, reflection: *ShaderReflection) usize;
+    extern fn spReflectionType_GetSpecializedElementCount(self: *TypeReflection, reflection: ?*ShaderReflection) usize;
     extern fn spReflectionType_GetElementType(self: *TypeReflection) *TypeReflection;
     extern fn spReflectionType_GetRowCount(self: *TypeReflection) u32;
     extern fn spReflectionType_GetColumnCount(self: *TypeReflection) u32;
@@ -3385,7 +3564,7 @@ const cdef = struct {
     extern fn spReflectionEntryPoint_getParameterCount(self: *EntryPointReflection) u32;
     extern fn spReflectionEntryPoint_getParameterByIndex(self: *EntryPointReflection, index: u32) *VariableLayoutReflection;
     extern fn spReflectionEntryPoint_getStage(self: *EntryPointReflection) Stage;
-    extern fn spReflectionEntryPoint_getComputeThreadGroupSize(self: *EntryPointReflection, axis_count: u64, out_size_along_axis: *u64) void;
+    extern fn spReflectionEntryPoint_getComputeThreadGroupSize(self: *EntryPointReflection, axis_count: u64, out_size_along_axis: [*]u64) void;
     extern fn spReflectionEntryPoint_getComputeWaveSize(self: *EntryPointReflection, out_wave_size: *u64) void;
     extern fn spReflectionEntryPoint_usesAnySampleRateInput(self: *EntryPointReflection) i32;
     extern fn spReflectionEntryPoint_getVarLayout(self: *EntryPointReflection) *VariableLayoutReflection;
@@ -3432,7 +3611,7 @@ const cdef = struct {
     // DeclReflection
     extern fn spReflectionDecl_getChildrenCount(self: *DeclReflection) u32;
     extern fn spReflectionDecl_getChild(self: *DeclReflection, index: u32) *DeclReflection;
-    extern fn spReflectionDecl_getName(self: *DeclReflection) [*:0]const u8;
+    extern fn spReflectionDecl_getName(self: *DeclReflection) ?[*:0]const u8;
     extern fn spReflectionDecl_getKind(self: *DeclReflection) DeclKind;
     extern fn spReflectionDecl_castToFunction(self: *DeclReflection) *FunctionReflection;
     extern fn spReflectionDecl_castToVariable(self: *DeclReflection) ?*VariableReflection;
@@ -3452,12 +3631,12 @@ test "check" {
 }
 
 test "compile" {
-    const global_session = try createGlobalSession(.{});
+    var global_session = try createGlobalSession(.{});
     defer global_session.release();
 
     const target_desc = TargetDesc{
         .format = .spirv,
-        .profile = global_session.findProfile("spirv_1_5"),
+        .profile = global_session.borrow().findProfile("spirv_1_5"),
     };
     const session_desc = SessionDesc{
         .targets = &.{target_desc},
@@ -3468,35 +3647,54 @@ test "compile" {
         },
         .default_matrix_layout_mode = .row_major,
     };
-    const session = try global_session.createSession(session_desc);
+    var session = try global_session.borrow().createSession(session_desc);
     defer session.release();
 
-    const module = session.loadModule("test.slang", null) orelse return error.ModuleLoadFailed;
+    var module = session.borrow().loadModule("test.slang", null) orelse return error.ModuleLoadFailed;
     defer module.release();
 
-    const entry_point = try module.findEntryPointByName("computeMain");
+    var entry_point = try module.borrow().findEntryPointByName("computeMain");
     defer entry_point.release();
 
     const component_types = [_]*IComponentType{
-        @ptrCast(module), @ptrCast(entry_point),
+        @ptrCast(module.borrow()), @ptrCast(entry_point.borrow()),
     };
-    const program = try session.createCompositeComponentType(&component_types, null);
+    var program = try session.borrow().createCompositeComponentType(&component_types, null);
     defer program.release();
 
-    const linked_program = try program.link(null);
+    var linked_program = try program.borrow().link(null);
     defer linked_program.release();
 
-    const reflection = linked_program.getLayout(0, null) orelse return error.ReflectionFailed;
+    const reflection = linked_program.borrow().getLayout(0, null) orelse return error.ReflectionFailed;
     try std.testing.expectEqual(1, reflection.getEntryPointCount());
     try std.testing.expectEqual(3, reflection.getParameterCount());
 
-    const spirv_code = try linked_program.getEntryPointCode(0, 0, null);
+    var spirv_code = try linked_program.borrow().getEntryPointCode(0, 0, null);
     defer spirv_code.release();
-    try std.testing.expect(spirv_code.getBufferSize() != 0);
+    try std.testing.expect(spirv_code.borrow().getBufferSize() != 0);
+}
+
+const abi_gen = @import("abi_gen.zig");
+extern const slang_abi_values: [abi_gen.checks.len]i64;
+extern const slang_abi_value_count: u32;
+
+test "struct layouts and enum values" {
+    try std.testing.expectEqual(abi_gen.checks.len, slang_abi_value_count);
+
+    var failures: usize = 0;
+    for (abi_gen.checks, &slang_abi_values) |check, slang_value| {
+        if (slang_value == abi_gen.missing) {
+            std.debug.print("{s}: `{s}` does not name anything in slang.h, add an override in abi_gen.zig\n", .{ check.name, check.cpp });
+            failures += 1;
+        } else if (slang_value != check.value) {
+            std.debug.print("{s}: is {d} in zig but {d} in slang.h\n", .{ check.name, check.value, slang_value });
+            failures += 1;
+        }
+    }
+    try std.testing.expectEqual(0, failures);
 }
 
-extern const slang_args_buffer: [1024]u8;
-extern const slang_args_buffer_end: u32;
+extern fn slang_args_buffer_get(out_len: *u32) [*]const u8;
 extern var slang_test_interfaces: SlangTestInterfaces;
 
 const SlangTestInterfaces = extern struct {
@@ -3523,35 +3721,38 @@ const SlangTestInterfaces = extern struct {
 };
 
 const Rng = std.Random.DefaultPrng;
-const FUNC_ITER_COUNT = 10_000;
+const abi_test_iterations = @import("options").abi_test_iterations;
+const args_buffer_size = 4096;
+const out_param_size = 256;
 
 test "vtables and argument passing" {
     var seed: u64 = undefined;
     try std.posix.getrandom(std.mem.asBytes(&seed));
-    var rng = Rng.init(seed);
     // TODO: I think there is a way to print this only if the test failed
     std.log.info("Seed for this run was 0x{X}\n", .{seed});
 
-    try testSlangVTable("IUnknown", &rng);
-    try testSlangVTable("ICastable", &rng);
-    try testSlangVTable("IClonable", &rng);
-    try testSlangVTable("IBlob", &rng);
-    try testSlangVTable("IFileSystem", &rng);
-    try testSlangVTable("ISharedLibrary", &rng);
-    try testSlangVTable("ISharedLibraryLoader", &rng);
-    try testSlangVTable("IFileSystemExt", &rng);
-    try testSlangVTable("IMutableFileSystem", &rng);
-    try testSlangVTable("IWriter", &rng);
-    try testSlangVTable("IProfiler", &rng);
-    try testSlangVTable("IGlobalSession", &rng);
-    try testSlangVTable("ISession", &rng);
-    try testSlangVTable("IMetadata", &rng);
-    try testSlangVTable("ICompileResult", &rng);
-    try testSlangVTable("IComponentType", &rng);
-    try testSlangVTable("IEntryPoint", &rng);
-    try testSlangVTable("IComponentType2", &rng);
-    try testSlangVTable("IModule", &rng);
-    try testSlangVTable("IModulePrecompileService_Experimental", &rng);
+    // The C++ side records the arguments into thread local buffers, so every interface gets its
+    // own thread and its own rng derived from the seed of the run
+    const interfaces = std.meta.fields(SlangTestInterfaces);
+    var results: [interfaces.len]anyerror!void = undefined;
+    var threads: [interfaces.len]std.Thread = undefined;
+    var spawned: usize = 0;
+    defer for (threads[0..spawned]) |thread| thread.join();
+
+    inline for (interfaces, 0..) |field, i| {
+        const Runner = struct {
+            fn run(thread_seed: u64, result: *anyerror!void) void {
+                var rng = Rng.init(thread_seed);
+                result.* = testSlangVTable(field.name, &rng);
+            }
+        };
+        threads[i] = try std.Thread.spawn(.{}, Runner.run, .{ seed +% i, &results[i] });
+        spawned += 1;
+    }
+
+    for (threads) |thread| thread.join();
+    spawned = 0;
+    for (results) |result| try result;
 }
 
 fn testSlangVTable(comptime interface_name: []const u8, rng: *Rng) !void {
@@ -3566,7 +3767,7 @@ fn testSlangVTableImpl(vtable: anytype, this: anytype, type_name: []const u8, rn
                 const base_vtable = @field(vtable, field.name);
                 try testSlangVTableImpl(base_vtable, this, type_name, rng);
             },
-            .pointer => for (0..FUNC_ITER_COUNT) |_| {
+            .pointer => for (0..abi_test_iterations) |_| {
                 const fn_ptr = @field(vtable, field.name);
                 try testSlangFunction(fn_ptr, @ptrCast(this), type_name, field.name, rng);
             },
@@ -3577,9 +3778,14 @@ fn testSlangVTableImpl(vtable: anytype, this: anytype, type_name: []const u8, rn
 
 fn testSlangFunction(fn_ptr: anytype, this: *anyopaque, type_name: []const u8, func_name: []const u8, rng: *Rng) !void {
     const F = std.meta.Child(@TypeOf(fn_ptr));
+    const params = @typeInfo(F).@"fn".params;
     var args: std.meta.ArgsTuple(F) = undefined;
 
-    var zig_args_buffer: [1024]u8 = undefined;
+    // Pointer arguments point into zeroed scratch memory, so the C++ side can write through them
+    var out_params: [params.len][out_param_size]u8 align(16) = undefined;
+    var out_param_offsets: [params.len]usize = undefined;
+
+    var zig_args_buffer: [args_buffer_size]u8 = undefined;
     var zig_args: std.ArrayList(u8) = .initBuffer(&zig_args_buffer);
     try zig_args.appendSliceBounded(type_name);
     try zig_args.appendBounded('.');
@@ -3588,10 +3794,69 @@ fn testSlangFunction(fn_ptr: anytype, this: *anyopaque, type_name: []const u8, f
     args[0] = @ptrCast(@alignCast(this));
     try zig_args.appendSliceBounded(std.mem.asBytes(&args[0]));
 
-    inline for (1..@typeInfo(F).@"fn".params.len) |i| {
-        rng.fill(std.mem.asBytes(&args[i]));
+    inline for (1..params.len) |i| {
+        if (comptime isDataPointer(params[i].type.?)) {
+            @memset(&out_params[i], 0);
+            args[i] = @ptrCast(@alignCast(&out_params[i]));
+        } else {
+            rng.fill(std.mem.asBytes(&args[i]));
+        }
         try zig_args.appendSliceBounded(std.mem.asBytes(&args[i]));
+        out_param_offsets[i] = zig_args.items.len;
     }
-    _ = @call(.auto, fn_ptr, args); // We are only interested in the side effects
-    try std.testing.expectEqualSlices(u8, slang_args_buffer[0..slang_args_buffer_end], zig_args.items);
+    const ret = @call(.auto, fn_ptr, args);
+
+    var slang_args_len: u32 = undefined;
+    const slang_args = slang_args_buffer_get(&slang_args_len)[0..slang_args_len];
+    try std.testing.expectEqualSlices(u8, slang_args, zig_args.items);
+
+    // Mirrors `ReturnValue` and `writeOutParam` in abi_test.cpp
+    const hash = std.hash.Fnv1a_64.hash(zig_args.items);
+    try std.testing.expectEqualSlices(u8, &expectedReturnBytes(@TypeOf(ret), hash), std.mem.asBytes(&ret));
+
+    inline for (1..params.len) |i| {
+        if (comptime outParamSize(params[i].type.?)) |size| {
+            var expected: [size]u8 = undefined;
+            for (&expected, 0..) |*byte, j| byte.* = @truncate(0x5a ^ out_param_offsets[i] ^ j);
+            try std.testing.expectEqualSlices(u8, &expected, out_params[i][0..size]);
+        }
+    }
+}
+
+fn expectedReturnBytes(comptime R: type, hash: u64) [@sizeOf(R)]u8 {
+    const Bits = std.meta.Int(.unsigned, @bitSizeOf(R));
+    return switch (@typeInfo(R)) {
+        .void => .{},
+        .bool => .{@intFromBool((hash & 1) != 0)},
+        .int => std.mem.toBytes(@as(Bits, @truncate(hash))),
+        // `Result` is a plain integer on the C++ side
+        .@"enum" => std.mem.toBytes(@as(Bits, if (R == Result) @truncate(hash) else @intCast(hash & 1))),
+        .pointer, .optional => std.mem.toBytes(@as(usize, @truncate((hash & ~@as(u64, 0xff)) | 0x100))),
+        else => @compileError("Unsupported return type " ++ @typeName(R)),
+    };
+}
+
+fn isDataPointer(comptime P: type) bool {
+    const info = switch (@typeInfo(P)) {
+        .pointer => |info| info,
+        .optional => |optional| switch (@typeInfo(optional.child)) {
+            .pointer => |info| info,
+            else => return false,
+        },
+        else => return false,
+    };
+    return @typeInfo(info.child) != .@"fn";
+}
+
+/// The number of bytes the C++ side writes through a parameter, which is the size of the pointee
+/// for mutable pointers to anything but interfaces and opaque types.
+fn outParamSize(comptime P: type) ?usize {
+    if (!isDataPointer(P)) return null;
+    const info = @typeInfo(if (@typeInfo(P) == .optional) std.meta.Child(P) else P).pointer;
+    if (info.is_const) return null;
+    return switch (@typeInfo(info.child)) {
+        .@"opaque" => null,
+        .@"struct" => if (@hasField(info.child, "vtable")) null else @sizeOf(info.child),
+        else => @sizeOf(info.child),
+    };
 }
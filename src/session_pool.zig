@@ -0,0 +1,281 @@
+//! Reuse of `ISession` objects between compiles with the same configuration.
+//!
+//! Sessions keep every module they have loaded, so handing out a warm session for a repeated
+//! compile skips parsing and checking the modules again. Sessions are keyed by a digest of the
+//! whole `SessionDesc`, including the strings and arrays it points to.
+
+const std = @import("std");
+const slang = @import("root.zig");
+
+const IGlobalSession = slang.IGlobalSession;
+const ISession = slang.ISession;
+const SessionDesc = slang.SessionDesc;
+
+pub const SessionPool = struct {
+    gpa: std.mem.Allocator,
+    global_session: *IGlobalSession,
+    options: Options,
+    mutex: std.Thread.Mutex = .{},
+    /// Signaled whenever a session goes back to the pool or a slot for a key frees up
+    condition: std.Thread.Condition = .{},
+    entries: std.ArrayList(*Entry) = .empty,
+    /// Number of sessions per key, including the ones that are still being created
+    counts: std.AutoHashMapUnmanaged(Key, u32) = .empty,
+    /// Estimated memory of all pooled sessions, see `Entry.memory`
+    total_memory: usize = 0,
+    tick: u64 = 0,
+    stats: Stats = .{},
+
+    pub const Key = [16]u8;
+
+    pub const Options = struct {
+        /// `acquire` blocks once this many sessions with the same key are in use
+        max_sessions_per_key: u32 = 4,
+        /// Idle sessions are evicted, least recently used first, while the estimated memory of
+        /// all sessions is above this
+        memory_budget: usize = 1 << 30,
+    };
+
+    pub const Stats = struct {
+        hits: u64 = 0,
+        misses: u64 = 0,
+        waits: u64 = 0,
+        evictions: u64 = 0,
+    };
+
+    const Entry = struct {
+        session: slang.Owned(ISession),
+        key: Key,
+        in_use: bool,
+        last_used: u64 = 0,
+        /// Growth of the resident set size during the first lease of the session, which is when
+        /// the modules get loaded. It is only an estimate, other threads allocate at the same time.
+        memory: ?usize = null,
+        rss_at_creation: usize,
+    };
+
+    /// A session that is checked out of the pool. Give it back with `release`, or with `discard`
+    /// if it should not be reused.
+    pub const Lease = struct {
+        pool: *SessionPool,
+        entry: *Entry,
+
+        pub fn session(self: Lease) *ISession {
+            return self.entry.session.borrow();
+        }
+
+        pub fn release(self: Lease) void {
+            self.pool.put(self.entry, false);
+        }
+
+        pub fn discard(self: Lease) void {
+            self.pool.put(self.entry, true);
+        }
+    };
+
+    pub fn init(gpa: std.mem.Allocator, global_session: *IGlobalSession, options: Options) SessionPool {
+        return SessionPool{
+            .gpa = gpa,
+            .global_session = global_session,
+            .options = options,
+        };
+    }
+
+    /// Releases every session. None of them may still be leased.
+    pub fn deinit(self: *SessionPool) void {
+        for (self.entries.items) |entry| {
+            std.debug.assert(!entry.in_use);
+            entry.session.release();
+            self.gpa.destroy(entry);
+        }
+        self.entries.deinit(self.gpa);
+        self.counts.deinit(self.gpa);
+    }
+
+    pub fn digest(desc: SessionDesc) Key {
+        var hasher = std.crypto.hash.Blake3.init(.{});
+        desc.hash(&hasher);
+        var key: Key = undefined;
+        hasher.final(&key);
+        return key;
+    }
+
+    /// Returns an idle session created from an identical `desc`, or creates a new one. Blocks
+    /// while `max_sessions_per_key` sessions for `desc` are leased.
+    pub fn acquire(self: *SessionPool, desc: SessionDesc) !Lease {
+        const key = digest(desc);
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        while (true) {
+            if (self.findIdle(key)) |entry| {
+                entry.in_use = true;
+                self.stats.hits += 1;
+                return Lease{ .pool = self, .entry = entry };
+            }
+            const count = self.counts.get(key) orelse 0;
+            if (count < self.options.max_sessions_per_key) break;
+
+            self.stats.waits += 1;
+            self.condition.wait(&self.mutex);
+        }
+
+        const count = try self.counts.getOrPutValue(self.gpa, key, 0);
+        count.value_ptr.* += 1;
+        self.stats.misses += 1;
+
+        // Creating a session takes a while, don't hold up the other threads in the meantime
+        self.mutex.unlock();
+        const created = self.create(key, desc);
+        self.mutex.lock();
+
+        const entry = created catch |err| {
+            self.releaseSlot(key);
+            return err;
+        };
+        self.entries.append(self.gpa, entry) catch |err| {
+            entry.session.release();
+            self.gpa.destroy(entry);
+            self.releaseSlot(key);
+            return err;
+        };
+        return Lease{ .pool = self, .entry = entry };
+    }
+
+    /// Releases every idle session.
+    pub fn evictIdle(self: *SessionPool) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        var i: usize = 0;
+        while (i < self.entries.items.len) {
+            if (self.entries.items[i].in_use) {
+                i += 1;
+            } else {
+                self.removeAt(i);
+                self.stats.evictions += 1;
+            }
+        }
+    }
+
+    fn create(self: *SessionPool, key: Key, desc: SessionDesc) !*Entry {
+        const entry = try self.gpa.create(Entry);
+        errdefer self.gpa.destroy(entry);
+
+        const rss = residentSetSize() catch 0;
+        entry.* = Entry{
+            .session = try self.global_session.createSession(desc),
+            .key = key,
+            .in_use = true,
+            .rss_at_creation = rss,
+        };
+        return entry;
+    }
+
+    fn put(self: *SessionPool, entry: *Entry, discard: bool) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        defer self.condition.broadcast();
+
+        std.debug.assert(entry.in_use);
+        entry.in_use = false;
+        self.tick += 1;
+        entry.last_used = self.tick;
+
+        if (entry.memory == null) {
+            const rss = residentSetSize() catch entry.rss_at_creation;
+            entry.memory = rss -| entry.rss_at_creation;
+            self.total_memory += entry.memory.?;
+        }
+
+        if (discard) {
+            const index = std.mem.indexOfScalar(*Entry, self.entries.items, entry).?;
+            self.removeAt(index);
+        }
+        self.evictOverBudget();
+    }
+
+    fn findIdle(self: *SessionPool, key: Key) ?*Entry {
+        var best: ?*Entry = null;
+        for (self.entries.items) |entry| {
+            if (entry.in_use or !std.mem.eql(u8, &entry.key, &key)) continue;
+            // Prefer the most recently used session, its memory is the most likely to be cached
+            if (best == null or entry.last_used > best.?.last_used) best = entry;
+        }
+        return best;
+    }
+
+    fn evictOverBudget(self: *SessionPool) void {
+        while (self.total_memory > self.options.memory_budget) {
+            var oldest: ?usize = null;
+            for (self.entries.items, 0..) |entry, i| {
+                if (entry.in_use) continue;
+                if (oldest == null or entry.last_used < self.entries.items[oldest.?].last_used) oldest = i;
+            }
+            self.removeAt(oldest orelse return);
+            self.stats.evictions += 1;
+        }
+    }
+
+    fn removeAt(self: *SessionPool, index: usize) void {
+        const entry = self.entries.swapRemove(index);
+        std.debug.assert(!entry.in_use);
+        self.total_memory -= entry.memory orelse 0;
+        self.releaseSlot(entry.key);
+        entry.session.release();
+        self.gpa.destroy(entry);
+    }
+
+    fn releaseSlot(self: *SessionPool, key: Key) void {
+        const count = self.counts.getPtr(key).?;
+        count.* -= 1;
+        if (count.* == 0) _ = self.counts.remove(key);
+        self.condition.broadcast();
+    }
+};
+
+/// Resident set size of the current process, read from `/proc/self/statm`.
+pub fn residentSetSize() !usize {
+    var buffer: [128]u8 = undefined;
+    const statm = try std.fs.cwd().readFile("/proc/self/statm", &buffer);
+    var fields = std.mem.tokenizeScalar(u8, statm, ' ');
+    _ = fields.next() orelse return error.InvalidStatm;
+    const resident_pages = try std.fmt.parseInt(usize, fields.next() orelse return error.InvalidStatm, 10);
+    return resident_pages * std.heap.pageSize();
+}
+
+test "session pool" {
+    var global_session = try slang.createGlobalSession(.{});
+    defer global_session.release();
+    // The budget is out of the way, it depends on the memory of the whole test process
+    var pool = SessionPool.init(std.testing.allocator, global_session.borrow(), .{ .memory_budget = std.math.maxInt(usize) });
+    defer pool.deinit();
+
+    const spirv = SessionDesc{ .targets = &.{.{ .format = .spirv }} };
+    const hlsl = SessionDesc{ .targets = &.{.{ .format = .hlsl }} };
+
+    const first = try pool.acquire(spirv);
+    const second = try pool.acquire(spirv);
+    try std.testing.expect(first.session() != second.session());
+    const session = first.session();
+    first.release();
+
+    // The idle session is handed out again, a discarded one is gone
+    const again = try pool.acquire(spirv);
+    try std.testing.expectEqual(session, again.session());
+    again.release();
+    second.discard();
+    try std.testing.expectEqual(1, pool.entries.items.len);
+
+    const other = try pool.acquire(hlsl);
+    try std.testing.expect(other.session() != session);
+    pool.evictIdle();
+    try std.testing.expectEqual(1, pool.entries.items.len);
+    other.release();
+    pool.evictIdle();
+    try std.testing.expectEqual(0, pool.entries.items.len);
+    try std.testing.expectEqual(0, pool.counts.count());
+
+    try std.testing.expectEqual(SessionPool.Stats{ .hits = 1, .misses = 3, .waits = 0, .evictions = 2 }, pool.stats);
+}
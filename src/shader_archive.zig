@@ -0,0 +1,351 @@
+//! A single file holding the code of many shader variants, for loading them without a file each.
+//!
+//! `ArchiveWriter` collects code by key, usually the `getEntryPointHash` of the variant, stores
+//! identical code only once, and indexes the keys with a minimal perfect hash (hash and displace):
+//! every key falls into a bucket, and every bucket stores the seed that sends its keys to free
+//! slots of a table with exactly one slot per key. `ShaderArchive` maps the file and answers
+//! lookups with two hashes and one key comparison, returning slices into the mapping.
+//!
+//! All integers are little endian. The layout is
+//! - header: magic, version, key count, bucket count, payload count, reserved, all `u32`
+//! - one `u32` seed per bucket
+//! - one slot per key, in slot order: key offset, key length and payload index, all `u32`
+//! - one payload per distinct code: offset from the start of the file and length, both `u64`
+//! - the key bytes
+//! - the code, every payload aligned to `payload_alignment`
+
+const std = @import("std");
+const slang = @import("root.zig");
+
+const IComponentType = slang.IComponentType;
+const Wyhash = std.hash.Wyhash;
+
+const magic = "SLAR";
+const version = 1;
+const header_size = 24;
+const slot_size = 12;
+const payload_size = 16;
+/// Enough for SPIR-V words and anything else the code is read as
+pub const payload_alignment = 16;
+/// Average number of keys per bucket, more makes the index smaller and building it slower
+const keys_per_bucket = 4;
+const bucket_seed = 0;
+
+pub const ArchiveWriter = struct {
+    gpa: std.mem.Allocator,
+    /// Owned copies of the keys, in the order they were added
+    keys: std.ArrayList([]const u8) = .empty,
+    /// Index into `payloads` for every key
+    key_payloads: std.ArrayList(u32) = .empty,
+    key_set: std.StringHashMapUnmanaged(void) = .empty,
+    /// Owned copies of every distinct code, found by their content
+    payloads: std.ArrayList([]const u8) = .empty,
+    payload_set: std.StringHashMapUnmanaged(u32) = .empty,
+
+    pub fn init(gpa: std.mem.Allocator) ArchiveWriter {
+        return ArchiveWriter{ .gpa = gpa };
+    }
+
+    pub fn deinit(self: *ArchiveWriter) void {
+        for (self.keys.items) |key| self.gpa.free(key);
+        for (self.payloads.items) |payload| self.gpa.free(payload);
+        self.keys.deinit(self.gpa);
+        self.key_payloads.deinit(self.gpa);
+        self.key_set.deinit(self.gpa);
+        self.payloads.deinit(self.gpa);
+        self.payload_set.deinit(self.gpa);
+    }
+
+    pub fn add(self: *ArchiveWriter, key: []const u8, code: []const u8) !void {
+        if (self.key_set.contains(key)) return error.DuplicateKey;
+        if (self.keys.items.len == std.math.maxInt(u32)) return error.TooManyKeys;
+        try self.keys.ensureUnusedCapacity(self.gpa, 1);
+        try self.key_payloads.ensureUnusedCapacity(self.gpa, 1);
+        try self.key_set.ensureUnusedCapacity(self.gpa, 1);
+        const owned_key = try self.gpa.dupe(u8, key);
+        errdefer self.gpa.free(owned_key);
+
+        const payload_entry = try self.payload_set.getOrPut(self.gpa, code);
+        if (!payload_entry.found_existing) {
+            errdefer self.payload_set.removeByPtr(payload_entry.key_ptr);
+            const owned_code = try self.gpa.dupe(u8, code);
+            errdefer self.gpa.free(owned_code);
+            try self.payloads.append(self.gpa, owned_code);
+            payload_entry.key_ptr.* = owned_code;
+            payload_entry.value_ptr.* = @intCast(self.payloads.items.len - 1);
+        }
+
+        self.key_set.putAssumeCapacity(owned_key, {});
+        self.keys.appendAssumeCapacity(owned_key);
+        self.key_payloads.appendAssumeCapacity(payload_entry.value_ptr.*);
+    }
+
+    /// Adds the code of an entry point of a linked program, keyed by its `getEntryPointHash`.
+    pub fn addEntryPoint(self: *ArchiveWriter, linked: *IComponentType, entry_point_index: i32, target_index: i32) !void {
+        var hash = linked.getEntryPointHash(entry_point_index, target_index);
+        defer hash.release();
+        var code = try linked.getEntryPointCode(entry_point_index, target_index, null);
+        defer code.release();
+        try self.add(hash.borrow().getBuffer(), code.borrow().getBuffer());
+    }
+
+    pub fn write(self: *const ArchiveWriter, writer: *std.Io.Writer) !void {
+        const key_count: u32 = @intCast(self.keys.items.len);
+        const bucket_count: u32 = @max(1, std.math.divCeil(u32, key_count, keys_per_bucket) catch unreachable);
+        const payload_count: u32 = @intCast(self.payloads.items.len);
+
+        const seeds = try self.gpa.alloc(u32, bucket_count);
+        defer self.gpa.free(seeds);
+        const slots = try self.gpa.alloc(u32, key_count);
+        defer self.gpa.free(slots);
+        try self.buildIndex(seeds, slots);
+
+        try writer.writeAll(magic);
+        for ([_]u32{ version, key_count, bucket_count, payload_count, 0 }) |value| {
+            try writer.writeInt(u32, value, .little);
+        }
+        for (seeds) |seed| try writer.writeInt(u32, seed, .little);
+
+        var keys_size: u64 = 0;
+        for (slots) |key_index| {
+            const key = self.keys.items[key_index];
+            try writer.writeInt(u32, @intCast(keys_size), .little);
+            try writer.writeInt(u32, @intCast(key.len), .little);
+            try writer.writeInt(u32, self.key_payloads.items[key_index], .little);
+            keys_size += key.len;
+        }
+        if (keys_size > std.math.maxInt(u32)) return error.KeysTooLarge;
+
+        const keys_offset = header_size + 4 * @as(u64, bucket_count) + slot_size * @as(u64, key_count) +
+            payload_size * @as(u64, payload_count);
+        const data_offset = std.mem.alignForward(u64, keys_offset + keys_size, payload_alignment);
+        var offset = data_offset;
+        for (self.payloads.items) |payload| {
+            try writer.writeInt(u64, offset, .little);
+            try writer.writeInt(u64, @intCast(payload.len), .little);
+            offset = std.mem.alignForward(u64, offset + payload.len, payload_alignment);
+        }
+
+        for (slots) |key_index| try writer.writeAll(self.keys.items[key_index]);
+        try writer.splatByteAll(0, @intCast(data_offset - keys_offset - keys_size));
+        for (self.payloads.items) |payload| {
+            try writer.writeAll(payload);
+            const padding = std.mem.alignForward(usize, payload.len, payload_alignment) - payload.len;
+            try writer.splatByteAll(0, padding);
+        }
+    }
+
+    /// Writes the archive to `path` atomically, readers never see a partial archive.
+    pub fn writeFile(self: *const ArchiveWriter, dir: std.fs.Dir, path: []const u8) !void {
+        var buffer: [64 * 1024]u8 = undefined;
+        var file = try dir.atomicFile(path, .{ .write_buffer = &buffer });
+        defer file.deinit();
+        try self.write(&file.file_writer.interface);
+        try file.file_writer.interface.flush();
+        try file.finish();
+    }
+
+    /// Finds a seed for every bucket so that all keys land in different slots. Buckets with more
+    /// keys are placed first, while most slots are still free.
+    fn buildIndex(self: *const ArchiveWriter, seeds: []u32, slots: []u32) !void {
+        const gpa = self.gpa;
+        const key_count = slots.len;
+        @memset(seeds, 0);
+        if (key_count == 0) return;
+
+        const bucket_of = try gpa.alloc(u32, key_count);
+        defer gpa.free(bucket_of);
+        // Keys grouped by bucket, bucket `b` owns `grouped[starts[b]..starts[b + 1]]`
+        const starts = try gpa.alloc(u32, seeds.len + 1);
+        defer gpa.free(starts);
+        const grouped = try gpa.alloc(u32, key_count);
+        defer gpa.free(grouped);
+
+        @memset(starts, 0);
+        for (self.keys.items, bucket_of) |key, *bucket| {
+            bucket.* = @intCast(Wyhash.hash(bucket_seed, key) % seeds.len);
+            starts[bucket.* + 1] += 1;
+        }
+        for (1..starts.len) |i| starts[i] += starts[i - 1];
+        const fill = try gpa.dupe(u32, starts[0..seeds.len]);
+        defer gpa.free(fill);
+        for (bucket_of, 0..) |bucket, key_index| {
+            grouped[fill[bucket]] = @intCast(key_index);
+            fill[bucket] += 1;
+        }
+
+        const order = try gpa.alloc(u32, seeds.len);
+        defer gpa.free(order);
+        for (order, 0..) |*bucket, i| bucket.* = @intCast(i);
+        std.sort.pdq(u32, order, starts, struct {
+            fn moreKeys(bucket_starts: []u32, a: u32, b: u32) bool {
+                return bucket_starts[a + 1] - bucket_starts[a] > bucket_starts[b + 1] - bucket_starts[b];
+            }
+        }.moreKeys);
+
+        var taken = try std.DynamicBitSetUnmanaged.initEmpty(gpa, key_count);
+        defer taken.deinit(gpa);
+        var candidate: [64]u32 = undefined;
+
+        for (order) |bucket| {
+            const keys = grouped[starts[bucket]..starts[bucket + 1]];
+            if (keys.len == 0) break;
+            if (keys.len > candidate.len) return error.PerfectHashFailed;
+
+            var seed: u32 = bucket_seed + 1;
+            search: while (true) : (seed += 1) {
+                if (seed == std.math.maxInt(u32)) return error.PerfectHashFailed;
+                for (keys, 0..) |key_index, i| {
+                    const slot: u32 = @intCast(Wyhash.hash(seed, self.keys.items[key_index]) % key_count);
+                    if (taken.isSet(slot)) continue :search;
+                    if (std.mem.indexOfScalar(u32, candidate[0..i], slot) != null) continue :search;
+                    candidate[i] = slot;
+                }
+                break;
+            }
+            seeds[bucket] = seed;
+            for (keys, candidate[0..keys.len]) |key_index, slot| {
+                taken.set(slot);
+                slots[slot] = key_index;
+            }
+        }
+    }
+};
+
+/// A read only view of an archive, either mapped from a file with `open` or over bytes that are
+/// already in memory with `fromBytes`.
+pub const ShaderArchive = struct {
+    bytes: []const u8,
+    mapping: ?[]align(std.heap.page_size_min) const u8 = null,
+    key_count: u32,
+    bucket_count: u32,
+    payload_count: u32,
+    seeds: []const u8,
+    slots: []const u8,
+    payloads: []const u8,
+    keys: []const u8,
+
+    pub fn open(dir: std.fs.Dir, path: []const u8) !ShaderArchive {
+        const file = try dir.openFile(path, .{});
+        // The mapping stays valid after the file is closed
+        defer file.close();
+        const size = std.math.cast(usize, try file.getEndPos()) orelse return error.FileTooBig;
+        if (size < header_size) return error.InvalidArchive;
+
+        const mapping = try std.posix.mmap(null, size, std.posix.PROT.READ, .{ .TYPE = .PRIVATE }, file.handle, 0);
+        errdefer std.posix.munmap(mapping);
+        var archive = try fromBytes(mapping);
+        archive.mapping = mapping;
+        return archive;
+    }
+
+    /// Validates the tables, the bytes have to outlive the archive.
+    pub fn fromBytes(bytes: []const u8) !ShaderArchive {
+        if (bytes.len < header_size or !std.mem.eql(u8, bytes[0..4], magic)) return error.InvalidArchive;
+        if (readU32(bytes, 4) != version) return error.UnsupportedArchiveVersion;
+
+        const key_count = readU32(bytes, 8);
+        const bucket_count = readU32(bytes, 12);
+        const payload_count = readU32(bytes, 16);
+        if (bucket_count == 0) return error.InvalidArchive;
+
+        const tables_size = 4 * @as(u64, bucket_count) + slot_size * @as(u64, key_count) +
+            payload_size * @as(u64, payload_count);
+        if (tables_size > bytes.len - header_size) return error.InvalidArchive;
+        const seeds_offset: usize = header_size;
+        const slots_offset = seeds_offset + 4 * @as(usize, bucket_count);
+        const payloads_offset = slots_offset + slot_size * @as(usize, key_count);
+        const keys_offset = payloads_offset + payload_size * @as(usize, payload_count);
+
+        const archive = ShaderArchive{
+            .bytes = bytes,
+            .key_count = key_count,
+            .bucket_count = bucket_count,
+            .payload_count = payload_count,
+            .seeds = bytes[seeds_offset..slots_offset],
+            .slots = bytes[slots_offset..payloads_offset],
+            .payloads = bytes[payloads_offset..keys_offset],
+            .keys = bytes[keys_offset..],
+        };
+
+        // Checked once here, so lookups can slice without checking
+        for (0..key_count) |slot| {
+            const key_offset = readU32(archive.slots, slot * slot_size);
+            const key_len = readU32(archive.slots, slot * slot_size + 4);
+            const payload = readU32(archive.slots, slot * slot_size + 8);
+            if (@as(u64, key_offset) + key_len > archive.keys.len) return error.InvalidArchive;
+            if (payload >= payload_count) return error.InvalidArchive;
+        }
+        for (0..payload_count) |payload| {
+            const offset = readU64(archive.payloads, payload * payload_size);
+            const len = readU64(archive.payloads, payload * payload_size + 8);
+            if (offset > bytes.len or len > bytes.len - offset) return error.InvalidArchive;
+        }
+        return archive;
+    }
+
+    pub fn close(self: *ShaderArchive) void {
+        if (self.mapping) |mapping| std.posix.munmap(mapping);
+        self.* = undefined;
+    }
+
+    pub fn count(self: *const ShaderArchive) usize {
+        return self.key_count;
+    }
+
+    /// The code stored for `key`, pointing into the archive.
+    pub fn get(self: *const ShaderArchive, key: []const u8) ?[]const u8 {
+        if (self.key_count == 0) return null;
+        const bucket: usize = @intCast(Wyhash.hash(bucket_seed, key) % self.bucket_count);
+        const seed = readU32(self.seeds, bucket * 4);
+        const slot: usize = @intCast(Wyhash.hash(seed, key) % self.key_count);
+
+        const key_offset = readU32(self.slots, slot * slot_size);
+        const key_len = readU32(self.slots, slot * slot_size + 4);
+        // Keys that are not in the archive still land in some slot
+        if (!std.mem.eql(u8, self.keys[key_offset..][0..key_len], key)) return null;
+
+        const payload = readU32(self.slots, slot * slot_size + 8);
+        const offset: usize = @intCast(readU64(self.payloads, payload * payload_size));
+        const len: usize = @intCast(readU64(self.payloads, payload * payload_size + 8));
+        return self.bytes[offset..][0..len];
+    }
+};
+
+fn readU32(bytes: []const u8, offset: usize) u32 {
+    return std.mem.readInt(u32, bytes[offset..][0..4], .little);
+}
+
+fn readU64(bytes: []const u8, offset: usize) u64 {
+    return std.mem.readInt(u64, bytes[offset..][0..8], .little);
+}
+
+test "shader archive" {
+    const gpa = std.testing.allocator;
+    var writer = ArchiveWriter.init(gpa);
+    defer writer.deinit();
+
+    var key_buffer: [16]u8 = undefined;
+    for (0..100) |i| {
+        const key = try std.fmt.bufPrint(&key_buffer, "variant {d}", .{i});
+        // Every tenth variant has the same code
+        const code: []const u8 = if (i % 10 == 0) "shared code" else key;
+        try writer.add(key, code);
+    }
+    try std.testing.expectError(error.DuplicateKey, writer.add("variant 0", "other code"));
+    try std.testing.expectEqual(91, writer.payloads.items.len);
+
+    var bytes: std.Io.Writer.Allocating = .init(gpa);
+    defer bytes.deinit();
+    try writer.write(&bytes.writer);
+
+    const archive = try ShaderArchive.fromBytes(bytes.written());
+    try std.testing.expectEqual(100, archive.count());
+    for (0..100) |i| {
+        const key = try std.fmt.bufPrint(&key_buffer, "variant {d}", .{i});
+        const code = archive.get(key) orelse return error.TestUnexpectedResult;
+        try std.testing.expectEqualStrings(if (i % 10 == 0) "shared code" else key, code);
+        try std.testing.expect(std.mem.isAligned(@intFromPtr(code.ptr) - @intFromPtr(bytes.written().ptr), payload_alignment));
+    }
+    try std.testing.expectEqual(null, archive.get("variant 100"));
+}
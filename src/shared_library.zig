@@ -0,0 +1,336 @@
+//! An `ISharedLibraryLoader` that loads shared objects from memory.
+//!
+//! The contents of a library are copied into a `memfd` and opened through `/proc/self/fd`, so
+//! kernels produced with `getEntryPointCode` can be loaded without touching the disk. Loaded
+//! libraries are cached by the hash of their contents, which makes identical compiles share one
+//! `dlopen` handle, and their exported symbols are resolved once from `.dynsym` into a hash map.
+//! Only available on linux.
+
+const std = @import("std");
+const builtin = @import("builtin");
+const slang = @import("root.zig");
+const log = std.log.scoped(.slang);
+
+const IUnknown = slang.IUnknown;
+const ICastable = slang.ICastable;
+const ISharedLibrary = slang.ISharedLibrary;
+const ISharedLibraryLoader = slang.ISharedLibraryLoader;
+const UUID = slang.UUID;
+const Result = slang.Result;
+const mcall = slang.mcall;
+
+const Hash = [std.crypto.hash.Blake3.digest_length]u8;
+
+/// Libraries that slang asks for by path are read and loaded from memory, so they share the cache
+/// with `loadFromMemory`. Names that are not files, like the downstream compilers, are handed to
+/// `dlopen` as is. The loader is owned by the caller and has to outlive the global session it is
+/// set on, reference counting is a noop.
+pub const MemoryLibraryLoader = struct {
+    interface: ISharedLibraryLoader,
+    gpa: std.mem.Allocator,
+    mutex: std.Thread.Mutex = .{},
+    cache: std.AutoHashMapUnmanaged(Hash, *MemoryLibrary) = .empty,
+    stats: Stats = .{},
+
+    pub const Stats = struct {
+        hits: u64 = 0,
+        misses: u64 = 0,
+    };
+
+    const max_library_size = 1 << 30;
+
+    pub fn init(gpa: std.mem.Allocator) MemoryLibraryLoader {
+        if (builtin.os.tag != .linux) @compileError("MemoryLibraryLoader relies on memfd_create, which is only available on linux");
+        return MemoryLibraryLoader{
+            .interface = .{ .vtable = &loader_vtable },
+            .gpa = gpa,
+        };
+    }
+
+    /// Drops the references held by the cache. Libraries that are still referenced elsewhere
+    /// stay loaded until they are released.
+    pub fn deinit(self: *MemoryLibraryLoader) void {
+        var libraries = self.cache.valueIterator();
+        while (libraries.next()) |library| library.*.interface.release();
+        self.cache.deinit(self.gpa);
+    }
+
+    pub fn asLoader(self: *MemoryLibraryLoader) *ISharedLibraryLoader {
+        return &self.interface;
+    }
+
+    /// Loads a shared object from its contents, or returns the cached library if the same
+    /// contents were loaded before.
+    pub fn loadFromMemory(self: *MemoryLibraryLoader, bytes: []const u8) !slang.Owned(ISharedLibrary) {
+        var hash: Hash = undefined;
+        std.crypto.hash.Blake3.hash(bytes, &hash, .{});
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const entry = try self.cache.getOrPut(self.gpa, hash);
+        if (entry.found_existing) {
+            self.stats.hits += 1;
+        } else {
+            errdefer self.cache.removeByPtr(entry.key_ptr);
+            entry.value_ptr.* = try MemoryLibrary.openMemory(self.gpa, bytes);
+            self.stats.misses += 1;
+        }
+
+        return slang.Owned(ISharedLibrary).retain(&entry.value_ptr.*.interface);
+    }
+
+    /// Unloads the cached libraries that are not referenced outside of the cache.
+    pub fn evictUnused(self: *MemoryLibraryLoader) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        var entries = self.cache.iterator();
+        while (entries.next()) |entry| {
+            const library = entry.value_ptr.*;
+            if (library.ref_count.load(.acquire) != 1) continue;
+            self.cache.removeByPtr(entry.key_ptr);
+            library.interface.release();
+        }
+    }
+
+    fn loadPath(self: *MemoryLibraryLoader, path: [:0]const u8) !*ISharedLibrary {
+        const bytes = std.fs.cwd().readFileAlloc(self.gpa, path, max_library_size) catch |err| switch (err) {
+            error.FileNotFound, error.IsDir => {
+                const library = try MemoryLibrary.openSystem(self.gpa, path);
+                return &library.interface;
+            },
+            else => return err,
+        };
+        defer self.gpa.free(bytes);
+        var library = try self.loadFromMemory(bytes);
+        return library.leak();
+    }
+
+    const loader_vtable = ISharedLibraryLoader.VTable{
+        .base = .{
+            .queryInterface = &queryInterface,
+            .addRef = &addRef,
+            .release = &release,
+        },
+        .loadSharedLibrary = &loadSharedLibrary,
+    };
+
+    fn queryInterface(this: *IUnknown, uuid: *const UUID, out_object: **anyopaque) callconv(mcall) Result {
+        if (!uuid.eql(IUnknown.uuid) and !uuid.eql(ISharedLibraryLoader.uuid)) return .no_interface;
+        out_object.* = this;
+        return .ok;
+    }
+
+    fn addRef(_: *IUnknown) callconv(mcall) u32 {
+        return 1;
+    }
+
+    fn release(_: *IUnknown) callconv(mcall) u32 {
+        return 1;
+    }
+
+    fn loadSharedLibrary(this: *ISharedLibraryLoader, path: [*:0]const u8, out_shared_library: **ISharedLibrary) callconv(mcall) Result {
+        const self: *MemoryLibraryLoader = @fieldParentPtr("interface", this);
+        out_shared_library.* = self.loadPath(std.mem.span(path)) catch |err| {
+            log.err("Failed to load shared library '{s}': {s}", .{ path, @errorName(err) });
+            return switch (err) {
+                error.OutOfMemory => .out_of_memory,
+                error.FileNotFound => .not_found,
+                else => .fail,
+            };
+        };
+        return .ok;
+    }
+};
+
+const MemoryLibrary = struct {
+    interface: ISharedLibrary,
+    gpa: std.mem.Allocator,
+    handle: *anyopaque,
+    /// The memfd of a library loaded from memory. It stays open as long as the library is loaded,
+    /// since the loader hands out the already loaded object for a path it has seen, and a closed
+    /// fd number gets reused by the next memfd.
+    fd: ?std.posix.fd_t = null,
+    ref_count: std.atomic.Value(u32) = .init(1),
+    /// Owns the symbol names and the map
+    arena: std.heap.ArenaAllocator,
+    /// Exported symbols resolved at load time. Lookups that miss fall back to `dlsym`.
+    symbols: std.StringHashMapUnmanaged(*anyopaque) = .empty,
+
+    fn openMemory(gpa: std.mem.Allocator, bytes: []const u8) !*MemoryLibrary {
+        const fd = try std.posix.memfd_create("slang-shared-library", std.os.linux.MFD.CLOEXEC);
+        errdefer std.posix.close(fd);
+
+        const file = std.fs.File{ .handle = fd };
+        try file.writeAll(bytes);
+
+        var path_buffer: [64]u8 = undefined;
+        const path = try std.fmt.bufPrintZ(&path_buffer, "/proc/self/fd/{d}", .{fd});
+        const handle = try dlopen(path);
+        const library = create(gpa, handle) catch |err| {
+            _ = std.c.dlclose(handle);
+            return err;
+        };
+        errdefer library.destroy();
+        try library.resolveSymbols(bytes);
+        library.fd = fd;
+        return library;
+    }
+
+    fn openSystem(gpa: std.mem.Allocator, name: [:0]const u8) !*MemoryLibrary {
+        const handle = dlopen(name) catch handle: {
+            // Slang asks for libraries by their base name, e.g. `slang-glslang`
+            if (std.mem.indexOfScalar(u8, name, '/') != null) return error.FileNotFound;
+            var path_buffer: [std.fs.max_path_bytes]u8 = undefined;
+            const path = try std.fmt.bufPrintZ(&path_buffer, "lib{s}.so", .{name});
+            break :handle dlopen(path) catch return error.FileNotFound;
+        };
+        errdefer _ = std.c.dlclose(handle);
+        return create(gpa, handle);
+    }
+
+    fn dlopen(path: [:0]const u8) !*anyopaque {
+        return std.c.dlopen(path, .{ .NOW = true }) orelse {
+            if (std.c.dlerror()) |message| log.debug("dlopen: {s}", .{message});
+            return error.DlopenFailed;
+        };
+    }
+
+    fn create(gpa: std.mem.Allocator, handle: *anyopaque) !*MemoryLibrary {
+        const library = try gpa.create(MemoryLibrary);
+        library.* = MemoryLibrary{
+            .interface = .{ .vtable = &library_vtable },
+            .gpa = gpa,
+            .handle = handle,
+            .arena = std.heap.ArenaAllocator.init(gpa),
+        };
+        return library;
+    }
+
+    fn destroy(self: *MemoryLibrary) void {
+        _ = std.c.dlclose(self.handle);
+        if (self.fd) |fd| std.posix.close(fd);
+        self.arena.deinit();
+        self.gpa.destroy(self);
+    }
+
+    /// Resolves every function and object exported through `.dynsym`. Anything other than a 64 bit
+    /// little endian ELF file is left to the `dlsym` fallback.
+    fn resolveSymbols(self: *MemoryLibrary, bytes: []const u8) !void {
+        const elf = std.elf;
+        if (builtin.cpu.arch.endian() != .little) return;
+        if (bytes.len < @sizeOf(elf.Elf64_Ehdr) or !std.mem.eql(u8, bytes[0..4], elf.MAGIC)) return;
+        if (bytes[elf.EI_CLASS] != elf.ELFCLASS64 or bytes[elf.EI_DATA] != elf.ELFDATA2LSB) return;
+
+        const header = try readStruct(elf.Elf64_Ehdr, bytes, 0);
+        for (0..header.e_shnum) |i| {
+            const section = try readStruct(elf.Elf64_Shdr, bytes, header.e_shoff + i * header.e_shentsize);
+            if (section.sh_type != elf.SHT_DYNSYM) continue;
+
+            const strings = try readStruct(elf.Elf64_Shdr, bytes, header.e_shoff + @as(u64, section.sh_link) * header.e_shentsize);
+            if (strings.sh_offset > bytes.len) return error.InvalidElf;
+
+            const arena = self.arena.allocator();
+            const count = section.sh_size / @sizeOf(elf.Elf64_Sym);
+            try self.symbols.ensureTotalCapacity(arena, @intCast(count));
+
+            for (0..count) |j| {
+                const symbol = try readStruct(elf.Elf64_Sym, bytes, section.sh_offset + j * @sizeOf(elf.Elf64_Sym));
+                const kind = symbol.st_info & 0xf;
+                const binding = symbol.st_info >> 4;
+                if (symbol.st_shndx == elf.SHN_UNDEF) continue;
+                if (kind != elf.STT_FUNC and kind != elf.STT_OBJECT) continue;
+                if (binding != elf.STB_GLOBAL and binding != elf.STB_WEAK) continue;
+
+                const name_offset = strings.sh_offset + symbol.st_name;
+                if (name_offset >= bytes.len) return error.InvalidElf;
+                const name = std.mem.sliceTo(bytes[@intCast(name_offset)..], 0);
+                if (name.len == 0) continue;
+
+                const name_z = try arena.dupeZ(u8, name);
+                const address = std.c.dlsym(self.handle, name_z) orelse continue;
+                self.symbols.putAssumeCapacity(name_z, address);
+            }
+            return;
+        }
+    }
+
+    fn readStruct(comptime T: type, bytes: []const u8, offset: u64) !T {
+        if (offset > bytes.len or bytes.len - offset < @sizeOf(T)) return error.InvalidElf;
+        return std.mem.bytesToValue(T, bytes[@intCast(offset)..][0..@sizeOf(T)]);
+    }
+
+    const library_vtable = ISharedLibrary.VTable{
+        .base = .{
+            .base = .{
+                .queryInterface = &queryInterface,
+                .addRef = &addRef,
+                .release = &release,
+            },
+            .castAs = &castAs,
+        },
+        .findSymbolAddressByName = &findSymbolAddressByName,
+    };
+
+    fn fromInterface(this: anytype) *MemoryLibrary {
+        return @fieldParentPtr("interface", @as(*ISharedLibrary, @ptrCast(this)));
+    }
+
+    fn isImplemented(uuid: *const UUID) bool {
+        return uuid.eql(IUnknown.uuid) or uuid.eql(ICastable.uuid) or uuid.eql(ISharedLibrary.uuid);
+    }
+
+    fn queryInterface(this: *IUnknown, uuid: *const UUID, out_object: **anyopaque) callconv(mcall) Result {
+        if (!isImplemented(uuid)) return .no_interface;
+        _ = addRef(this);
+        out_object.* = this;
+        return .ok;
+    }
+
+    fn addRef(this: *IUnknown) callconv(mcall) u32 {
+        return fromInterface(this).ref_count.fetchAdd(1, .monotonic) + 1;
+    }
+
+    fn release(this: *IUnknown) callconv(mcall) u32 {
+        const self = fromInterface(this);
+        const ref_count = self.ref_count.fetchSub(1, .acq_rel) - 1;
+        if (ref_count == 0) self.destroy();
+        return ref_count;
+    }
+
+    fn castAs(this: *ICastable, guid: *const UUID) callconv(mcall) ?*anyopaque {
+        return if (isImplemented(guid)) this else null;
+    }
+
+    fn findSymbolAddressByName(this: *ISharedLibrary, name: [*:0]const u8) callconv(mcall) ?*const anyopaque {
+        const self = fromInterface(this);
+        if (self.symbols.get(std.mem.span(name))) |address| return address;
+        return std.c.dlsym(self.handle, name);
+    }
+};
+
+test "memory library loader" {
+    if (builtin.os.tag != .linux) return error.SkipZigTest;
+
+    var loader = MemoryLibraryLoader.init(std.testing.allocator);
+    defer loader.deinit();
+
+    // Both export `test_library_value` with a different result, built by build.zig
+    const Value = *const fn () callconv(.c) u32;
+    var first = try loader.loadFromMemory(@embedFile("test_library_1.so"));
+    defer first.release();
+    var second = try loader.loadFromMemory(@embedFile("test_library_2.so"));
+    defer second.release();
+    try std.testing.expect(first.borrow() != second.borrow());
+
+    const first_value: Value = @ptrCast(first.borrow().findSymbolAddressByName("test_library_value").?);
+    const second_value: Value = @ptrCast(second.borrow().findSymbolAddressByName("test_library_value").?);
+    try std.testing.expectEqual(1, first_value());
+    try std.testing.expectEqual(2, second_value());
+
+    var again = try loader.loadFromMemory(@embedFile("test_library_1.so"));
+    defer again.release();
+    try std.testing.expectEqual(first.borrow(), again.borrow());
+    try std.testing.expectEqual(MemoryLibraryLoader.Stats{ .hits = 1, .misses = 2 }, loader.stats);
+}
@@ -0,0 +1,343 @@
+//! Compiles libraries too big to keep in memory at once, with bounded memory per worker.
+//!
+//! Unlike `compileLibrary`, nothing outlives the entry points it was made for. Every module is
+//! linked in windows of a few entry points, the code of a window is handed to the sink as soon as
+//! it is generated, and its component types and blobs are released before the next window starts.
+//! The modules themselves stay loaded in the session, which is why every worker replaces its
+//! session once it has loaded too many modules or the process has grown past a resident set size
+//! limit.
+
+const std = @import("std");
+const slang = @import("root.zig");
+const residentSetSize = @import("session_pool.zig").residentSetSize;
+
+const IGlobalSession = slang.IGlobalSession;
+const ISession = slang.ISession;
+const IModule = slang.IModule;
+const IComponentType = slang.IComponentType;
+const IBlob = slang.IBlob;
+const Owned = slang.Owned;
+const SessionDesc = slang.SessionDesc;
+
+const log = std.log.scoped(.slang_stream);
+
+pub const StreamOptions = struct {
+    session_desc: SessionDesc,
+    /// Names or paths, as given to `ISession.loadModule`
+    modules: []const []const u8,
+    /// Defaults to the number of cpus
+    thread_count: ?usize = null,
+    /// Number of entry points linked together, at most 256. A larger window links less often but
+    /// keeps more code alive at once.
+    window_size: u32 = 16,
+    /// A worker replaces its session after loading this many modules, imports included
+    max_loaded_modules: usize = 256,
+    /// A worker replaces its session when the resident set size of the whole process is above
+    /// this after a module
+    max_resident_set_size: ?usize = null,
+};
+
+/// Receives the code of every entry point. It is called from every worker thread at the same
+/// time, so `write` has to be thread safe.
+pub const OutputSink = struct {
+    context: ?*anyopaque,
+    write: *const fn (context: ?*anyopaque, output: Output) anyerror!void,
+
+    pub const Output = struct {
+        module: []const u8,
+        entry_point: []const u8,
+        target_index: u32,
+        /// Only valid during the call, take a reference with `Owned(IBlob).retain` to keep it
+        code: *IBlob,
+    };
+};
+
+pub const StreamStats = struct {
+    /// Entry points compiled for every target, the others are in `failed_entry_points`
+    entry_points: usize = 0,
+    failed_modules: usize = 0,
+    failed_entry_points: usize = 0,
+    session_recycles: usize = 0,
+};
+
+/// Writes every output to `<dir>/<module stem>-<hash>.<entry point><extension>`, with one
+/// extension per target of the session. The hash is of the whole module name, so modules with the
+/// same stem in different directories don't overwrite each other.
+pub const DirectorySink = struct {
+    dir: std.fs.Dir,
+    extensions: []const []const u8,
+
+    pub fn sink(self: *DirectorySink) OutputSink {
+        return OutputSink{ .context = self, .write = write };
+    }
+
+    /// The name of the file `output` is written to
+    pub fn fileName(self: *const DirectorySink, buffer: *[std.fs.max_name_bytes]u8, output: OutputSink.Output) ![]u8 {
+        return std.fmt.bufPrint(buffer, "{s}-{x:0>8}.{s}{s}", .{
+            std.fs.path.stem(output.module),
+            @as(u32, @truncate(std.hash.Wyhash.hash(0, output.module))),
+            output.entry_point,
+            self.extensions[output.target_index],
+        });
+    }
+
+    fn write(context: ?*anyopaque, output: OutputSink.Output) anyerror!void {
+        const self: *DirectorySink = @ptrCast(@alignCast(context.?));
+        var name_buffer: [std.fs.max_name_bytes]u8 = undefined;
+        const name = try self.fileName(&name_buffer, output);
+        try self.dir.writeFile(.{ .sub_path = name, .data = output.code.getBuffer() });
+    }
+};
+
+/// Compiles every entry point of `options.modules` and hands the code to `sink`. Failures are
+/// logged and counted, they do not stop the other modules.
+pub fn compileStreaming(options: StreamOptions, sink: OutputSink) !StreamStats {
+    var shared = Shared{ .options = options, .sink = sink };
+
+    const cpu_count = options.thread_count orelse std.Thread.getCpuCount() catch 1;
+    const worker_count = std.math.clamp(@min(cpu_count, options.modules.len), 1, max_workers);
+    var threads: [max_workers]std.Thread = undefined;
+    var spawned: usize = 0;
+    {
+        defer for (threads[0..spawned]) |thread| thread.join();
+        for (1..worker_count) |_| {
+            threads[spawned] = try std.Thread.spawn(.{}, runWorker, .{&shared});
+            spawned += 1;
+        }
+        runWorker(&shared);
+    }
+
+    if (shared.fatal_error) |err| return err;
+    return shared.stats;
+}
+
+const max_workers = 64;
+const max_window_size = 256;
+
+const Shared = struct {
+    options: StreamOptions,
+    sink: OutputSink,
+    next_module: std.atomic.Value(usize) = .init(0),
+    mutex: std.Thread.Mutex = .{},
+    stats: StreamStats = .{},
+    fatal_error: ?anyerror = null,
+
+    fn add(self: *Shared, stats: StreamStats) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.stats.entry_points += stats.entry_points;
+        self.stats.failed_modules += stats.failed_modules;
+        self.stats.failed_entry_points += stats.failed_entry_points;
+        self.stats.session_recycles += stats.session_recycles;
+    }
+
+    fn fail(self: *Shared, err: anyerror) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.fatal_error == null) self.fatal_error = err;
+        // Stops the other workers after their current module
+        self.next_module.store(self.options.modules.len, .monotonic);
+    }
+};
+
+fn runWorker(shared: *Shared) void {
+    var worker = Worker{ .shared = shared };
+    defer {
+        if (worker.session) |*session| session.release();
+        if (worker.global_session) |*global_session| global_session.release();
+        shared.add(worker.stats);
+    }
+    worker.run() catch |err| shared.fail(err);
+}
+
+const Worker = struct {
+    shared: *Shared,
+    global_session: ?Owned(IGlobalSession) = null,
+    session: ?Owned(ISession) = null,
+    stats: StreamStats = .{},
+    sink_error: ?anyerror = null,
+
+    fn run(self: *Worker) !void {
+        const options = self.shared.options;
+        self.global_session = try slang.createGlobalSession(.{});
+
+        while (true) {
+            const index = self.shared.next_module.fetchAdd(1, .monotonic);
+            if (index >= options.modules.len) return;
+
+            if (self.session == null) self.session = try self.global_session.?.borrow().createSession(options.session_desc);
+            const name = options.modules[index];
+            self.compileModule(name) catch |err| switch (err) {
+                error.OutOfMemory => return err,
+                error.SinkFailed => return self.sink_error.?,
+                else => {
+                    log.err("{s}: {s}", .{ name, @errorName(err) });
+                    self.stats.failed_modules += 1;
+                },
+            };
+            if (self.shouldRecycle()) {
+                self.session.?.release();
+                self.session = null;
+                self.stats.session_recycles += 1;
+            }
+        }
+    }
+
+    fn shouldRecycle(self: *Worker) bool {
+        const options = self.shared.options;
+        if (self.session.?.borrow().getLoadedModuleCount() >= options.max_loaded_modules) return true;
+        const limit = options.max_resident_set_size orelse return false;
+        const rss = residentSetSize() catch return false;
+        return rss >= limit;
+    }
+
+    fn compileModule(self: *Worker, name: []const u8) !void {
+        var name_buffer: [std.fs.max_path_bytes:0]u8 = undefined;
+        const name_z = try std.fmt.bufPrintZ(&name_buffer, "{s}", .{name});
+        var module = self.session.?.borrow().loadModule(name_z, null) orelse return error.ModuleLoadFailed;
+        defer module.release();
+
+        const entry_point_count: u32 = @intCast(module.borrow().getDefinedEntryPointCount());
+        const window_size = std.math.clamp(self.shared.options.window_size, 1, max_window_size);
+        var first: u32 = 0;
+        while (first < entry_point_count) : (first += window_size) {
+            const count = @min(window_size, entry_point_count - first);
+            self.compileWindow(name, module.borrow(), first, count) catch |err| switch (err) {
+                error.OutOfMemory, error.SinkFailed => return err,
+                else => {
+                    log.err("{s}: entry points {d}..{d}: {s}", .{ name, first, first + count, @errorName(err) });
+                    self.stats.failed_entry_points += count;
+                },
+            };
+        }
+    }
+
+    fn compileWindow(self: *Worker, module_name: []const u8, module: *IModule, first: u32, count: u32) !void {
+        var components_buffer: [1 + max_window_size]*IComponentType = undefined;
+        var components = std.ArrayList(*IComponentType).initBuffer(&components_buffer);
+        components.appendAssumeCapacity(@ptrCast(module));
+        defer for (components.items[1..]) |component| component.release();
+        for (first..first + count) |index| {
+            var entry_point = try module.getDefinedEntryPoint(@intCast(index));
+            components.appendAssumeCapacity(@ptrCast(entry_point.leak()));
+        }
+
+        var composite = try self.session.?.borrow().createCompositeComponentType(components.items, null);
+        defer composite.release();
+        var linked = try composite.borrow().link(null);
+        defer linked.release();
+
+        const target_count = self.shared.options.session_desc.targets.len;
+        for (components.items[1..], 0..) |component, entry_point_index| {
+            const entry_point: *slang.IEntryPoint = @ptrCast(component);
+            const entry_point_name = std.mem.span(entry_point.getFunctionReflection().getName());
+            var failed = false;
+            for (0..target_count) |target_index| {
+                var code = linked.borrow().getEntryPointCode(@intCast(entry_point_index), @intCast(target_index), null) catch |err| {
+                    log.err("{s}: {s}: {s}", .{ module_name, entry_point_name, @errorName(err) });
+                    failed = true;
+                    continue;
+                };
+                defer code.release();
+                self.shared.sink.write(self.shared.sink.context, .{
+                    .module = module_name,
+                    .entry_point = entry_point_name,
+                    .target_index = @intCast(target_index),
+                    .code = code.borrow(),
+                }) catch |err| {
+                    // Not a problem with the shader, so it stops the whole compile
+                    self.sink_error = err;
+                    return error.SinkFailed;
+                };
+            }
+            // Counted once, however many of its targets failed
+            if (failed) {
+                self.stats.failed_entry_points += 1;
+            } else {
+                self.stats.entry_points += 1;
+            }
+        }
+    }
+};
+
+test "compile streaming" {
+    const gpa = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    const shader =
+        \\[shader("compute")]
+        \\[numthreads(1, 1, 1)]
+        \\void main(uniform RWStructuredBuffer<float> output) { output[0] = 1; }
+        \\
+    ;
+    // Has no implementation for either target, so only its code generation fails
+    const broken =
+        \\[shader("compute")]
+        \\[numthreads(1, 1, 1)]
+        \\void broken(uniform RWStructuredBuffer<float> output) {
+        \\    __target_switch { case hlsl: output[0] = 1; }
+        \\}
+        \\
+    ;
+    // Same stem in two directories
+    try tmp.dir.makePath("lights");
+    try tmp.dir.makePath("shadows");
+    try tmp.dir.writeFile(.{ .sub_path = "lights/shading.slang", .data = shader ++ broken });
+    try tmp.dir.writeFile(.{ .sub_path = "shadows/shading.slang", .data = shader });
+    try tmp.dir.writeFile(.{ .sub_path = "blur.slang", .data = shader });
+    const dir = try tmp.dir.realpathAlloc(gpa, ".");
+    defer gpa.free(dir);
+    const search_path = try gpa.dupeZ(u8, dir);
+    defer gpa.free(search_path);
+
+    const Outputs = struct {
+        arena: std.heap.ArenaAllocator,
+        mutex: std.Thread.Mutex = .{},
+        /// Keyed by the name `DirectorySink` would write to, counts how often it was delivered
+        names: std.StringHashMapUnmanaged(u32) = .empty,
+        directory: DirectorySink = .{ .dir = undefined, .extensions = &.{ ".spv", ".glsl" } },
+
+        fn write(context: ?*anyopaque, output: OutputSink.Output) anyerror!void {
+            const self: *@This() = @ptrCast(@alignCast(context.?));
+            try std.testing.expect(output.code.getBufferSize() > 0);
+            var name_buffer: [std.fs.max_name_bytes]u8 = undefined;
+            const name = try self.directory.fileName(&name_buffer, output);
+
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            const arena = self.arena.allocator();
+            const entry = try self.names.getOrPutValue(arena, try arena.dupe(u8, name), 0);
+            entry.value_ptr.* += 1;
+        }
+    };
+    var outputs: Outputs = .{ .arena = .init(gpa) };
+    defer outputs.arena.deinit();
+
+    var global_session = try slang.createGlobalSession(.{});
+    defer global_session.release();
+    const modules = [_][]const u8{ "lights/shading.slang", "shadows/shading.slang", "blur.slang" };
+    const stats = try compileStreaming(.{
+        .session_desc = .{
+            .targets = &.{
+                .{ .format = .spirv, .profile = global_session.borrow().findProfile("spirv_1_5") },
+                .{ .format = .glsl, .profile = global_session.borrow().findProfile("glsl_450") },
+            },
+            .search_paths = &.{search_path},
+        },
+        .modules = &modules,
+        .thread_count = 2,
+        .max_loaded_modules = 1,
+    }, .{ .context = &outputs, .write = Outputs.write });
+
+    try std.testing.expectEqual(3, stats.entry_points);
+    try std.testing.expectEqual(1, stats.failed_entry_points);
+    try std.testing.expectEqual(0, stats.failed_modules);
+    // Every module fills the session on its own
+    try std.testing.expectEqual(modules.len, stats.session_recycles);
+
+    // Three entry points for two targets, each under a name of its own and delivered once
+    try std.testing.expectEqual(6, outputs.names.count());
+    var counts = outputs.names.valueIterator();
+    while (counts.next()) |count| try std.testing.expectEqual(1, count.*);
+}
@@ -0,0 +1,7 @@
+//! Built twice by build.zig with a different `value`, for the test of `MemoryLibraryLoader`.
+
+const options = @import("options");
+
+export fn test_library_value() u32 {
+    return options.value;
+}
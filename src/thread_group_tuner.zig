@@ -0,0 +1,232 @@
+//! Times a compute entry point with different thread group sizes on the CPU.
+//!
+//! The entry point declares its size with macros, e.g.
+//! `[numthreads(THREAD_GROUP_SIZE_X, THREAD_GROUP_SIZE_Y, THREAD_GROUP_SIZE_Z)]`. Every candidate
+//! size is compiled in a session of its own, since the macros are part of the session, for the
+//! host callable target with `getEntryPointHostCallable`, and dispatched over the same problem
+//! size a few times. CPU timings do not predict GPU timings, but they do show sizes that are
+//! pathologically slow, and they are cheap enough to run in CI.
+//!
+//! Compiling for the host needs the downstream C++ compiler that slang uses for CPU targets.
+
+const std = @import("std");
+const slang = @import("root.zig");
+
+const IGlobalSession = slang.IGlobalSession;
+const IComponentType = slang.IComponentType;
+const SessionDesc = slang.SessionDesc;
+const PreprocessorMacroDesc = slang.PreprocessorMacroDesc;
+
+const log = std.log.scoped(.slang_tuner);
+
+pub const TuneOptions = struct {
+    /// The targets are replaced with the host callable target, the macros are extended with the
+    /// thread group size
+    session_desc: SessionDesc,
+    /// Name or path of the module, as given to `ISession.loadModule`
+    module_name: [:0]const u8,
+    entry_point: [:0]const u8,
+    candidates: []const [3]u32,
+    /// Number of threads along each axis, the group count of every candidate is rounded up to
+    /// cover it
+    problem_size: [3]u32,
+    /// Passed to the entry point as is, laid out as the host callable target expects
+    entry_point_params: ?*anyopaque = null,
+    global_params: ?*anyopaque = null,
+    /// Timed dispatches per candidate, after one untimed warm up
+    repetitions: u32 = 5,
+    macro_names: [3][:0]const u8 = .{ "THREAD_GROUP_SIZE_X", "THREAD_GROUP_SIZE_Y", "THREAD_GROUP_SIZE_Z" },
+};
+
+pub const TuneResult = struct {
+    gpa: std.mem.Allocator,
+    candidates: []const Candidate,
+    /// Index of the fastest candidate, null when none of them compiled
+    best: ?usize,
+
+    pub const Candidate = struct {
+        size: [3]u32,
+        /// As reflected by slang. When it differs from `size`, because the entry point ignores
+        /// the macros, the candidate fails with `error.ThreadGroupSizeMismatch`.
+        reflected_size: [3]u64 = @splat(0),
+        wave_size: u64 = 0,
+        /// Median of the timed dispatches
+        time_ns: ?u64 = null,
+        err: ?anyerror = null,
+    };
+
+    pub fn deinit(self: *TuneResult) void {
+        self.gpa.free(self.candidates);
+    }
+
+    pub fn write(self: *const TuneResult, w: *std.Io.Writer) !void {
+        for (self.candidates, 0..) |candidate, i| {
+            const marker: u8 = if (self.best == i) '*' else ' ';
+            try w.print("{c} {d:>4} x {d:>4} x {d:>4}", .{ marker, candidate.size[0], candidate.size[1], candidate.size[2] });
+            if (candidate.time_ns) |time_ns| {
+                try w.print("  {D:>10}  reflected {d}x{d}x{d}", .{
+                    time_ns,
+                    candidate.reflected_size[0],
+                    candidate.reflected_size[1],
+                    candidate.reflected_size[2],
+                });
+                if (candidate.wave_size != 0) try w.print(", wave size {d}", .{candidate.wave_size});
+            } else if (candidate.err) |err| {
+                try w.print("  failed: {s}", .{@errorName(err)});
+            }
+            try w.writeByte('\n');
+        }
+    }
+};
+
+/// Compiles and times every candidate. A candidate that fails to compile is recorded with its
+/// error instead of stopping the others.
+pub fn tuneThreadGroupSize(gpa: std.mem.Allocator, global_session: *IGlobalSession, options: TuneOptions) !TuneResult {
+    const candidates = try gpa.alloc(TuneResult.Candidate, options.candidates.len);
+    errdefer gpa.free(candidates);
+
+    var best: ?usize = null;
+    for (candidates, options.candidates, 0..) |*candidate, size, i| {
+        candidate.* = .{ .size = size };
+        timeCandidate(gpa, global_session, options, candidate) catch |err| switch (err) {
+            error.OutOfMemory => return err,
+            else => {
+                log.warn("{d}x{d}x{d}: {s}", .{ size[0], size[1], size[2], @errorName(err) });
+                candidate.err = err;
+                continue;
+            },
+        };
+        if (best == null or candidate.time_ns.? < candidates[best.?].time_ns.?) best = i;
+    }
+    return TuneResult{ .gpa = gpa, .candidates = candidates, .best = best };
+}
+
+/// What the host callable target expects as the first argument of a compute entry point, the
+/// range of groups to run.
+const ComputeVaryingInput = extern struct {
+    start_group_id: [3]u32,
+    end_group_id: [3]u32,
+};
+
+const ComputeFn = *const fn (
+    varying_input: *ComputeVaryingInput,
+    entry_point_params: ?*anyopaque,
+    global_params: ?*anyopaque,
+) callconv(.c) void;
+
+fn timeCandidate(
+    gpa: std.mem.Allocator,
+    global_session: *IGlobalSession,
+    options: TuneOptions,
+    candidate: *TuneResult.Candidate,
+) !void {
+    for (candidate.size) |size| if (size == 0) return error.InvalidThreadGroupSize;
+
+    var value_buffers: [3][16]u8 = undefined;
+    const macros = try gpa.alloc(PreprocessorMacroDesc, options.session_desc.preprpcessor_macros.len + 3);
+    defer gpa.free(macros);
+    @memcpy(macros[0..options.session_desc.preprpcessor_macros.len], options.session_desc.preprpcessor_macros);
+    for (macros[macros.len - 3 ..], options.macro_names, candidate.size, &value_buffers) |*macro, name, size, *buffer| {
+        macro.* = .{ .name = name, .value = try std.fmt.bufPrintZ(buffer, "{d}", .{size}) };
+    }
+
+    var session_desc = options.session_desc;
+    session_desc.targets = &.{.{ .format = .shader_host_callable }};
+    session_desc.preprpcessor_macros = macros;
+    var session = try global_session.createSession(session_desc);
+    defer session.release();
+
+    var module = session.borrow().loadModule(options.module_name, null) orelse return error.ModuleLoadFailed;
+    defer module.release();
+    var entry_point = try module.borrow().findEntryPointByName(options.entry_point);
+    defer entry_point.release();
+    const components = [_]*IComponentType{ @ptrCast(module.borrow()), @ptrCast(entry_point.borrow()) };
+    var composite = try session.borrow().createCompositeComponentType(&components, null);
+    defer composite.release();
+    var linked = try composite.borrow().link(null);
+    defer linked.release();
+
+    const layout = linked.borrow().getLayout(0, null) orelse return error.ReflectionFailed;
+    const reflection = layout.getEntryPointByIndex(0);
+    candidate.reflected_size = reflection.getComputeThreadGroupSize();
+    candidate.wave_size = reflection.getComputeWaveSize();
+    // An entry point that ignores the macros runs a different amount of work per group than the
+    // group count below is computed for
+    for (candidate.reflected_size, candidate.size) |reflected, size| {
+        if (reflected != size) return error.ThreadGroupSizeMismatch;
+    }
+
+    var library = try linked.borrow().getEntryPointHostCallable(0, 0, null);
+    defer library.release();
+    const symbol = library.borrow().findSymbolAddressByName(options.entry_point) orelse return error.EntryPointNotFound;
+    const compute: ComputeFn = @ptrCast(@alignCast(symbol));
+
+    var varying_input = ComputeVaryingInput{ .start_group_id = @splat(0), .end_group_id = undefined };
+    for (&varying_input.end_group_id, options.problem_size, candidate.size) |*groups, threads, size| {
+        groups.* = std.math.divCeil(u32, threads, size) catch unreachable;
+    }
+
+    const times = try gpa.alloc(u64, @max(1, options.repetitions));
+    defer gpa.free(times);
+    compute(&varying_input, options.entry_point_params, options.global_params);
+    for (times) |*time| {
+        var timer = try std.time.Timer.start();
+        compute(&varying_input, options.entry_point_params, options.global_params);
+        time.* = timer.read();
+    }
+    std.sort.pdq(u64, times, {}, std.sort.asc(u64));
+    candidate.time_ns = times[times.len / 2];
+}
+
+test "thread group tuner" {
+    const gpa = std.testing.allocator;
+    var global_session = try slang.createGlobalSession(.{});
+    defer global_session.release();
+    // Needs the downstream C++ compiler, which CI machines don't always have
+    global_session.borrow().checkCompileTargetSupport(.shader_host_callable) catch return error.SkipZigTest;
+
+    const shader =
+        \\[shader("compute")]
+        \\[numthreads(THREAD_GROUP_SIZE_X, THREAD_GROUP_SIZE_Y, THREAD_GROUP_SIZE_Z)]
+        \\void tuned(uint3 threadId : SV_DispatchThreadID) {}
+        \\
+        \\[shader("compute")]
+        \\[numthreads(8, 1, 1)]
+        \\void fixed(uint3 threadId : SV_DispatchThreadID) {}
+        \\
+    ;
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    try tmp.dir.writeFile(.{ .sub_path = "tuned.slang", .data = shader });
+    const dir = try tmp.dir.realpathAlloc(gpa, ".");
+    defer gpa.free(dir);
+    const search_path = try gpa.dupeZ(u8, dir);
+    defer gpa.free(search_path);
+
+    var options: TuneOptions = .{
+        .session_desc = .{ .search_paths = &.{search_path} },
+        .module_name = "tuned",
+        .entry_point = "tuned",
+        .candidates = &.{ .{ 1, 1, 1 }, .{ 4, 1, 1 }, .{ 8, 2, 1 } },
+        .problem_size = .{ 64, 4, 1 },
+        .repetitions = 2,
+    };
+    var result = try tuneThreadGroupSize(gpa, global_session.borrow(), options);
+    defer result.deinit();
+    try std.testing.expect(result.best != null);
+    for (result.candidates, options.candidates) |candidate, size| {
+        try std.testing.expectEqual(null, candidate.err);
+        try std.testing.expect(candidate.time_ns != null);
+        try std.testing.expectEqual([3]u64{ size[0], size[1], size[2] }, candidate.reflected_size);
+    }
+
+    // Keeps its own size whatever the macros say
+    options.entry_point = "fixed";
+    options.candidates = &.{ .{ 4, 1, 1 }, .{ 8, 1, 1 } };
+    var fixed = try tuneThreadGroupSize(gpa, global_session.borrow(), options);
+    defer fixed.deinit();
+    try std.testing.expectEqual(error.ThreadGroupSizeMismatch, fixed.candidates[0].err.?);
+    try std.testing.expectEqual([3]u64{ 8, 1, 1 }, fixed.candidates[0].reflected_size);
+    try std.testing.expectEqual(null, fixed.candidates[1].err);
+    try std.testing.expectEqual(1, fixed.best);
+}
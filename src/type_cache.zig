@@ -0,0 +1,257 @@
+//! Memoization in front of `ISession.specializeType` and `ISession.getTypeLayout`.
+//!
+//! Both calls return pointers owned by the session that stay valid for as long as the session
+//! is alive, so their results can be cached for the lifetime of the session. The cache does not
+//! keep the session alive by itself, call `deinit` before releasing the session.
+
+const std = @import("std");
+const slang = @import("root.zig");
+
+const ISession = slang.ISession;
+const IBlob = slang.IBlob;
+const TypeReflection = slang.TypeReflection;
+const TypeLayoutReflection = slang.TypeLayoutReflection;
+const SpecializationArg = slang.SpecializationArg;
+const LayoutRules = slang.LayoutRules;
+
+pub const TypeLayoutCache = struct {
+    session: *ISession,
+    /// Owns the copies of the specialization argument lists and expression strings
+    arena: std.heap.ArenaAllocator,
+    specialized: std.HashMapUnmanaged(SpecializeKey, *TypeReflection, SpecializeContext, std.hash_map.default_max_load_percentage) = .empty,
+    layouts: std.AutoHashMapUnmanaged(LayoutKey, *TypeLayoutReflection) = .empty,
+    stats: Stats = .{},
+
+    pub const Stats = struct {
+        specialize_hits: u64 = 0,
+        specialize_misses: u64 = 0,
+        layout_hits: u64 = 0,
+        layout_misses: u64 = 0,
+
+        /// Fraction of lookups of either kind that were served from the cache
+        pub fn hitRate(self: Stats) f64 {
+            const hits = self.specialize_hits + self.layout_hits;
+            const total = hits + self.specialize_misses + self.layout_misses;
+            if (total == 0) return 0;
+            return @as(f64, @floatFromInt(hits)) / @as(f64, @floatFromInt(total));
+        }
+    };
+
+    const Arg = union(enum) {
+        type: *TypeReflection,
+        expr: []const u8,
+    };
+
+    const SpecializeKey = struct {
+        type: *TypeReflection,
+        args: []const Arg,
+    };
+
+    const LayoutKey = struct {
+        type: *TypeReflection,
+        target_index: i64,
+        rules: LayoutRules,
+    };
+
+    const SpecializeContext = struct {
+        pub fn hash(_: SpecializeContext, key: SpecializeKey) u64 {
+            var hasher = std.hash.Wyhash.init(0);
+            hasher.update(std.mem.asBytes(&key.type));
+            for (key.args) |arg| hashArg(&hasher, arg);
+            return hasher.final();
+        }
+
+        pub fn eql(_: SpecializeContext, a: SpecializeKey, b: SpecializeKey) bool {
+            if (a.type != b.type or a.args.len != b.args.len) return false;
+            for (a.args, b.args) |arg_a, arg_b| {
+                if (!argEql(arg_a, arg_b)) return false;
+            }
+            return true;
+        }
+    };
+
+    /// Looks up the borrowed `SpecializationArg` list directly, so hits never allocate
+    const SpecializeLookupContext = struct {
+        pub fn hash(_: SpecializeLookupContext, key: SpecializeLookupKey) u64 {
+            var hasher = std.hash.Wyhash.init(0);
+            hasher.update(std.mem.asBytes(&key.type));
+            for (key.args) |arg| hashArg(&hasher, fromSlang(arg));
+            return hasher.final();
+        }
+
+        pub fn eql(_: SpecializeLookupContext, a: SpecializeLookupKey, b: SpecializeKey) bool {
+            if (a.type != b.type or a.args.len != b.args.len) return false;
+            for (a.args, b.args) |arg_a, arg_b| {
+                if (!argEql(fromSlang(arg_a), arg_b)) return false;
+            }
+            return true;
+        }
+    };
+
+    const SpecializeLookupKey = struct {
+        type: *TypeReflection,
+        args: []const SpecializationArg,
+    };
+
+    pub fn init(gpa: std.mem.Allocator, session: *ISession) TypeLayoutCache {
+        return TypeLayoutCache{
+            .session = session,
+            .arena = std.heap.ArenaAllocator.init(gpa),
+        };
+    }
+
+    pub fn deinit(self: *TypeLayoutCache) void {
+        const gpa = self.arena.child_allocator;
+        self.specialized.deinit(gpa);
+        self.layouts.deinit(gpa);
+        self.arena.deinit();
+    }
+
+    /// Cached version of `ISession.specializeType`. Diagnostics are only produced on a miss.
+    /// Failures are not cached, the next call with the same arguments asks slang again.
+    pub fn specializeType(
+        self: *TypeLayoutCache,
+        type_: *TypeReflection,
+        specialization_args: []const SpecializationArg,
+        out_diagnostics: ?**IBlob,
+    ) !*TypeReflection {
+        const gpa = self.arena.child_allocator;
+        const lookup = SpecializeLookupKey{ .type = type_, .args = specialization_args };
+        const entry = try self.specialized.getOrPutContextAdapted(gpa, lookup, SpecializeLookupContext{}, SpecializeContext{});
+        if (entry.found_existing) {
+            self.stats.specialize_hits += 1;
+            return entry.value_ptr.*;
+        }
+        errdefer self.specialized.removeByPtr(entry.key_ptr);
+
+        self.stats.specialize_misses += 1;
+        const specialized = self.session.specializeType(type_, specialization_args, out_diagnostics) orelse {
+            return error.SpecializeTypeFailed;
+        };
+        entry.key_ptr.* = .{ .type = type_, .args = try self.dupeArgs(specialization_args) };
+        entry.value_ptr.* = specialized;
+        return specialized;
+    }
+
+    /// Cached version of `ISession.getTypeLayout`. Diagnostics are only produced on a miss.
+    pub fn getTypeLayout(
+        self: *TypeLayoutCache,
+        type_: *TypeReflection,
+        target_index: i64,
+        rules: LayoutRules,
+        out_diagnostics: ?**IBlob,
+    ) !*TypeLayoutReflection {
+        const gpa = self.arena.child_allocator;
+        const key = LayoutKey{ .type = type_, .target_index = target_index, .rules = rules };
+        const entry = try self.layouts.getOrPut(gpa, key);
+        if (entry.found_existing) {
+            self.stats.layout_hits += 1;
+            return entry.value_ptr.*;
+        }
+
+        entry.value_ptr.* = self.session.getTypeLayout(type_, target_index, rules, out_diagnostics);
+        self.stats.layout_misses += 1;
+        return entry.value_ptr.*;
+    }
+
+    /// Specializes `type_` and returns the layout of the result, both going through the cache.
+    pub fn getSpecializedTypeLayout(
+        self: *TypeLayoutCache,
+        type_: *TypeReflection,
+        specialization_args: []const SpecializationArg,
+        target_index: i64,
+        rules: LayoutRules,
+        out_diagnostics: ?**IBlob,
+    ) !*TypeLayoutReflection {
+        const specialized = try self.specializeType(type_, specialization_args, out_diagnostics);
+        return self.getTypeLayout(specialized, target_index, rules, out_diagnostics);
+    }
+
+    fn dupeArgs(self: *TypeLayoutCache, specialization_args: []const SpecializationArg) ![]const Arg {
+        const arena = self.arena.allocator();
+        const args = try arena.alloc(Arg, specialization_args.len);
+        for (args, specialization_args) |*arg, slang_arg| {
+            arg.* = switch (fromSlang(slang_arg)) {
+                .type => |t| .{ .type = t },
+                .expr => |expr| .{ .expr = try arena.dupe(u8, expr) },
+            };
+        }
+        return args;
+    }
+
+    fn fromSlang(arg: SpecializationArg) Arg {
+        return switch (arg.kind) {
+            .type => .{ .type = arg.data.type },
+            .expr => .{ .expr = std.mem.span(arg.data.expr) },
+            .unknown => .{ .expr = "" },
+        };
+    }
+
+    fn hashArg(hasher: *std.hash.Wyhash, arg: Arg) void {
+        switch (arg) {
+            .type => |t| {
+                hasher.update("t");
+                hasher.update(std.mem.asBytes(&t));
+            },
+            .expr => |expr| {
+                hasher.update("e");
+                hasher.update(std.mem.asBytes(&expr.len));
+                hasher.update(expr);
+            },
+        }
+    }
+
+    fn argEql(a: Arg, b: Arg) bool {
+        return switch (a) {
+            .type => |t| b == .type and b.type == t,
+            .expr => |expr| b == .expr and std.mem.eql(u8, b.expr, expr),
+        };
+    }
+};
+
+test "type layout cache" {
+    var global_session = try slang.createGlobalSession(.{});
+    defer global_session.release();
+    var session = try global_session.borrow().createSession(.{
+        .targets = &.{.{ .format = .spirv, .profile = global_session.borrow().findProfile("spirv_1_5") }},
+    });
+    defer session.release();
+
+    const source =
+        \\interface IShape { float area(); }
+        \\struct Circle : IShape { float radius; float area() { return 3.14 * radius * radius; } }
+        \\struct Square : IShape { float side; float4 color; float area() { return side * side; } }
+        \\struct Shapes<T : IShape> { T first; T second; }
+    ;
+    var module = session.borrow().loadModuleFromSourceString("type_cache", "type_cache.slang", source, null) orelse return error.ModuleLoadFailed;
+    defer module.release();
+    const reflection = module.borrow().getLayout(0, null) orelse return error.ReflectionFailed;
+
+    var cache = TypeLayoutCache.init(std.testing.allocator, session.borrow());
+    defer cache.deinit();
+
+    const shapes = reflection.findTypeByName("Shapes");
+    const circle_args = [_]SpecializationArg{.fromType(reflection.findTypeByName("Circle"))};
+    const square_args = [_]SpecializationArg{.fromType(reflection.findTypeByName("Square"))};
+
+    const circles = try cache.specializeType(shapes, &circle_args, null);
+    try std.testing.expectEqual(circles, try cache.specializeType(shapes, &circle_args, null));
+    const squares = try cache.specializeType(shapes, &square_args, null);
+    try std.testing.expect(circles != squares);
+    try std.testing.expectEqual(TypeLayoutCache.Stats{ .specialize_hits = 1, .specialize_misses = 2 }, cache.stats);
+
+    const layout = try cache.getTypeLayout(squares, 0, .default, null);
+    try std.testing.expectEqual(layout, try cache.getSpecializedTypeLayout(shapes, &square_args, 0, .default, null));
+    try std.testing.expect(layout.getSize(.uniform) > (try cache.getTypeLayout(circles, 0, .default, null)).getSize(.uniform));
+    try std.testing.expectEqual(2, cache.stats.layout_misses);
+    try std.testing.expectEqual(1, cache.stats.layout_hits);
+
+    // An argument that doesn't conform fails every time instead of being cached
+    var diagnostics: *IBlob = IBlob.init;
+    const invalid_args = [_]SpecializationArg{.fromType(reflection.findTypeByName("float"))};
+    try std.testing.expectError(error.SpecializeTypeFailed, cache.specializeType(shapes, &invalid_args, &diagnostics));
+    if (diagnostics != IBlob.init) diagnostics.release();
+    try std.testing.expectError(error.SpecializeTypeFailed, cache.specializeType(shapes, &invalid_args, null));
+    try std.testing.expectEqual(4, cache.stats.specialize_misses);
+    try std.testing.expectEqual(2, cache.specialized.count());
+}
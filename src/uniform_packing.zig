@@ -0,0 +1,536 @@
+//! Finds the padding in uniform structs and proposes field orders that need less of it.
+//!
+//! Every struct used as the element of a constant buffer or parameter block in a linked program is
+//! read from the reflection of each target: its size, the offset and size of its fields, and how
+//! many of its bytes hold no data. The layout of the struct is then simulated under every
+//! `PackingRules`, for the declared order and for a few reordered candidates, and the smallest one
+//! is proposed. The proposal for the rules a target actually uses is compiled as a new struct with
+//! `loadModuleFromSourceString` and measured by slang, so the report never relies on the simulator
+//! alone.
+
+const std = @import("std");
+const slang = @import("root.zig");
+
+const ISession = slang.ISession;
+const IModule = slang.IModule;
+const IComponentType = slang.IComponentType;
+const TypeLayoutReflection = slang.TypeLayoutReflection;
+const VariableLayoutReflection = slang.VariableLayoutReflection;
+const TargetDesc = slang.TargetDesc;
+
+const log = std.log.scoped(.slang_packing);
+
+/// Rules for laying out a uniform buffer
+pub const PackingRules = enum {
+    /// GLSL and Vulkan uniform buffers, arrays and structs are aligned to 16 bytes
+    std140,
+    /// GLSL and Vulkan storage buffers, Metal
+    std430,
+    /// Everything aligned to its scalar, like `force_glsl_scalar_buffer_layout` and CPU targets
+    scalar,
+    /// D3D constant buffers, nothing may straddle a 16 byte register
+    d3d_cbuffer,
+
+    /// The rules slang uses for constant buffers of `target`.
+    pub fn forTarget(target: TargetDesc) PackingRules {
+        if (target.force_glsl_scalar_buffer_layout) return .scalar;
+        return switch (target.format) {
+            .hlsl, .dxbc, .dxbc_asm, .dxil, .dxil_asm => .d3d_cbuffer,
+            .glsl, .spirv, .spirv_asm, .wgsl, .wgsl_spirv, .wgsl_spirv_asm => .std140,
+            .metal, .metal_lib, .metal_lib_asm => .std430,
+            else => .scalar,
+        };
+    }
+};
+
+pub const PackingReport = struct {
+    arena: std.heap.ArenaAllocator,
+    structs: []const StructReport,
+
+    pub fn deinit(self: *PackingReport) void {
+        self.arena.deinit();
+    }
+
+    pub fn write(self: *const PackingReport, w: *std.Io.Writer) !void {
+        for (self.structs) |report| {
+            try w.print("{s} (target {d}): {d} bytes, {d} wasted ({d:.1}%)\n", .{
+                report.name,
+                report.target_index,
+                report.size,
+                report.wasted(),
+                report.wastedPercent(),
+            });
+            for (report.fields) |field| {
+                try w.print("    {d:>5} {d:>5}  {s}\n", .{ field.offset, field.size, field.name });
+            }
+            for (std.enums.values(PackingRules)) |rules| {
+                const proposal = report.proposals.get(rules);
+                try w.print("  {t}: {d} -> {d} bytes", .{ rules, proposal.size_before, proposal.size_after });
+                if (rules == report.rules) {
+                    if (report.verified_size) |size| try w.print(", {d} bytes compiled", .{size});
+                }
+                try w.writeByte('\n');
+            }
+            const best = report.proposals.get(report.rules);
+            if (best.size_after < best.size_before) {
+                try w.writeAll("  proposed order:");
+                for (best.order) |index| try w.print(" {s}", .{report.fields[index].name});
+                try w.writeByte('\n');
+            }
+        }
+    }
+};
+
+pub const StructReport = struct {
+    name: []const u8,
+    target_index: u32,
+    /// The rules of the target
+    rules: PackingRules,
+    /// As reported by slang
+    size: usize,
+    /// Bytes holding data, the padding inside nested structs and arrays excluded
+    used: usize,
+    /// Only the fields with uniform data, in declaration order
+    fields: []const Field,
+    proposals: std.EnumArray(PackingRules, Proposal),
+    /// Size of the proposal for `rules` as compiled by slang, null when the proposal keeps the
+    /// declared order or compiling it failed
+    verified_size: ?usize,
+
+    pub const Field = struct {
+        name: []const u8,
+        offset: usize,
+        size: usize,
+    };
+
+    pub fn wasted(self: StructReport) usize {
+        return self.size -| self.used;
+    }
+
+    pub fn wastedPercent(self: StructReport) f64 {
+        if (self.size == 0) return 0;
+        return 100 * @as(f64, @floatFromInt(self.wasted())) / @as(f64, @floatFromInt(self.size));
+    }
+};
+
+pub const Proposal = struct {
+    /// Simulated size in the declared order
+    size_before: usize,
+    /// Simulated size in `order`
+    size_after: usize,
+    /// Indices into `StructReport.fields`
+    order: []const u32,
+};
+
+/// Analyzes the uniform structs of `program`, which has to be linked from `module` in `session`.
+/// `targets` are the targets of the session. The proposals are compiled in `session` as extra
+/// modules that import `module`, so nested struct types resolve.
+pub fn analyzeUniforms(
+    gpa: std.mem.Allocator,
+    session: *ISession,
+    module: *IModule,
+    program: *IComponentType,
+    targets: []const TargetDesc,
+) !PackingReport {
+    var arena_state = std.heap.ArenaAllocator.init(gpa);
+    errdefer arena_state.deinit();
+    var analyzer = Analyzer{
+        .arena = arena_state.allocator(),
+        .session = session,
+        .module_name = std.mem.span(module.getName()),
+    };
+
+    for (targets, 0..) |target, target_index| {
+        const layout = program.getLayout(@intCast(target_index), null) orelse return error.ReflectionFailed;
+        analyzer.seen.clearRetainingCapacity();
+        for (0..layout.getParameterCount()) |i| {
+            try analyzer.visitParameter(layout.getParameterByIndex(@intCast(i)), @intCast(target_index), target);
+        }
+        for (0..layout.getEntryPointCount()) |i| {
+            const entry_point = layout.getEntryPointByIndex(i);
+            for (0..entry_point.getParameterCount()) |j| {
+                try analyzer.visitParameter(entry_point.getParameterByIndex(@intCast(j)), @intCast(target_index), target);
+            }
+        }
+    }
+
+    return PackingReport{
+        .arena = arena_state,
+        .structs = analyzer.structs.items,
+    };
+}
+
+const Analyzer = struct {
+    arena: std.mem.Allocator,
+    session: *ISession,
+    module_name: []const u8,
+    structs: std.ArrayList(StructReport) = .empty,
+    /// Struct names already analyzed for the current target
+    seen: std.StringHashMapUnmanaged(void) = .empty,
+    checks: u32 = 0,
+
+    fn visitParameter(self: *Analyzer, parameter: *VariableLayoutReflection, target_index: u32, target: TargetDesc) !void {
+        const type_layout = parameter.getTypeLayout();
+        switch (type_layout.getKind()) {
+            .constant_buffer, .parameter_block => {
+                try self.visitStruct(type_layout.getElementTypeLayout(), target_index, target);
+            },
+            else => {},
+        }
+    }
+
+    fn visitStruct(self: *Analyzer, type_layout: *TypeLayoutReflection, target_index: u32, target: TargetDesc) anyerror!void {
+        if (type_layout.getKind() != .@"struct" or type_layout.getSize(.uniform) == 0) return;
+        const name = std.mem.span(type_layout.getName());
+        const entry = try self.seen.getOrPut(self.arena, name);
+        if (entry.found_existing) return;
+
+        var fields: std.ArrayList(StructReport.Field) = .empty;
+        var members: std.ArrayList(Member) = .empty;
+        for (0..type_layout.getFieldCount()) |i| {
+            const field = type_layout.getFieldByIndex(@intCast(i));
+            const field_layout = field.getTypeLayout();
+            // Nested structs get a report of their own
+            try self.visitStruct(field_layout.unwrapArray(), target_index, target);
+
+            const size = field_layout.getSize(.uniform);
+            if (size == 0) continue;
+            const shape = try shapeOf(self.arena, field_layout) orelse {
+                log.debug("{s}: can not simulate the layout of '{s}', skipping the struct", .{ name, field.getName() });
+                return;
+            };
+            try fields.append(self.arena, .{
+                .name = std.mem.span(field.getName()),
+                .offset = field.getOffset(.uniform),
+                .size = size,
+            });
+            try members.append(self.arena, .{ .field = field, .shape = shape });
+        }
+
+        const shapes = try self.arena.alloc(Shape, members.items.len);
+        for (shapes, members.items) |*shape, member| shape.* = member.shape;
+        var used: usize = 0;
+        for (shapes) |shape| used += dataSize(shape);
+
+        var proposals: std.EnumArray(PackingRules, Proposal) = undefined;
+        for (std.enums.values(PackingRules)) |rules| {
+            proposals.set(rules, try propose(self.arena, rules, shapes));
+        }
+
+        const rules = PackingRules.forTarget(target);
+        var report = StructReport{
+            .name = name,
+            .target_index = target_index,
+            .rules = rules,
+            .size = type_layout.getSize(.uniform),
+            .used = used,
+            .fields = fields.items,
+            .proposals = proposals,
+            .verified_size = null,
+        };
+        const proposal = proposals.get(rules);
+        if (!isIdentity(proposal.order)) {
+            report.verified_size = self.compileProposal(members.items, proposal.order, target_index) catch |err| blk: {
+                log.warn("{s}: compiling the proposed order failed: {s}", .{ name, @errorName(err) });
+                break :blk null;
+            };
+        }
+        try self.structs.append(self.arena, report);
+    }
+
+    const Member = struct {
+        field: *VariableLayoutReflection,
+        shape: Shape,
+    };
+
+    /// Declares the reordered struct in a new module and returns the size slang gives it.
+    fn compileProposal(self: *Analyzer, members: []const Member, order: []const u32, target_index: u32) !usize {
+        self.checks += 1;
+        var source: std.Io.Writer.Allocating = .init(self.arena);
+        const w = &source.writer;
+        try w.print("import {s};\nstruct packing_check_{d} {{\n", .{ self.module_name, self.checks });
+        for (order) |index| {
+            const field = members[index].field;
+            const field_layout = field.getTypeLayout();
+            const element = field_layout.unwrapArray();
+            if (element.getKind() == .matrix) {
+                switch (element.getMatrixLayoutMode()) {
+                    .row_major => try w.writeAll("    row_major "),
+                    .column_major => try w.writeAll("    column_major "),
+                    .unknown => try w.writeAll("    "),
+                }
+            } else try w.writeAll("    ");
+
+            var type_name = try element.getType().getFullName();
+            defer type_name.release();
+            try w.print("{s} {s}", .{ type_name.borrow().getBuffer(), field.getName() });
+            var array = field_layout;
+            while (array.isArray()) : (array = array.getElementTypeLayout()) {
+                try w.print("[{d}]", .{array.getElementCount(null)});
+            }
+            try w.writeAll(";\n");
+        }
+        try w.print("}};\nConstantBuffer<packing_check_{d}> packing_check;\n", .{self.checks});
+
+        const module_name = try std.fmt.allocPrintSentinel(self.arena, "packing_check_{d}", .{self.checks}, 0);
+        const path = try std.fmt.allocPrintSentinel(self.arena, "packing_check_{d}.slang", .{self.checks}, 0);
+        const source_z = try self.arena.dupeZ(u8, source.written());
+        var module = self.session.loadModuleFromSourceString(module_name, path, source_z, null) orelse return error.ModuleLoadFailed;
+        defer module.release();
+
+        const components = [_]*IComponentType{@ptrCast(module.borrow())};
+        var composite = try self.session.createCompositeComponentType(&components, null);
+        defer composite.release();
+        var linked = try composite.borrow().link(null);
+        defer linked.release();
+        const layout = linked.borrow().getLayout(target_index, null) orelse return error.ReflectionFailed;
+
+        for (0..layout.getParameterCount()) |i| {
+            const parameter = layout.getParameterByIndex(@intCast(i));
+            if (!std.mem.eql(u8, std.mem.span(parameter.getName()), "packing_check")) continue;
+            return parameter.getTypeLayout().getElementTypeLayout().getSize(.uniform);
+        }
+        return error.ReflectionFailed;
+    }
+};
+
+/// The parts of a type that decide its uniform layout. Matrices are arrays of vectors.
+const Shape = union(enum) {
+    scalar: u32,
+    vector: Vector,
+    array: Array,
+    structure: []const Shape,
+
+    const Vector = struct { scalar: u32, count: u32 };
+    const Array = struct { element: *const Shape, count: u32 };
+};
+
+const Layout = struct {
+    size: u32,
+    alignment: u32,
+};
+
+fn shapeOf(arena: std.mem.Allocator, type_layout: *TypeLayoutReflection) !?Shape {
+    switch (type_layout.getKind()) {
+        .scalar => return .{ .scalar = scalarSize(type_layout.getScalarType()) orelse return null },
+        .vector => return .{ .vector = .{
+            .scalar = scalarSize(type_layout.getScalarType()) orelse return null,
+            .count = @intCast(type_layout.getElementCount(null)),
+        } },
+        .matrix => {
+            const rows = type_layout.getRowCount();
+            const columns = type_layout.getColumnCount();
+            const row_major = type_layout.getMatrixLayoutMode() == .row_major;
+            const vector = try arena.create(Shape);
+            vector.* = .{ .vector = .{
+                .scalar = scalarSize(type_layout.getScalarType()) orelse return null,
+                .count = if (row_major) columns else rows,
+            } };
+            return .{ .array = .{ .element = vector, .count = if (row_major) rows else columns } };
+        },
+        .array => {
+            const count = type_layout.getElementCount(null);
+            if (count == 0 or count == slang.UNBOUNDED_SIZE) return null;
+            const element = try arena.create(Shape);
+            element.* = try shapeOf(arena, type_layout.getElementTypeLayout()) orelse return null;
+            return .{ .array = .{ .element = element, .count = @intCast(count) } };
+        },
+        .@"struct" => {
+            var members: std.ArrayList(Shape) = .empty;
+            for (0..type_layout.getFieldCount()) |i| {
+                const field_layout = type_layout.getFieldByIndex(@intCast(i)).getTypeLayout();
+                if (field_layout.getSize(.uniform) == 0) continue;
+                try members.append(arena, try shapeOf(arena, field_layout) orelse return null);
+            }
+            return .{ .structure = members.items };
+        },
+        else => return null,
+    }
+}
+
+fn scalarSize(scalar: slang.ScalarType) ?u32 {
+    return switch (scalar) {
+        .int8, .uint8 => 1,
+        .int16, .uint16, .float16 => 2,
+        // Booleans take a whole word in uniform buffers
+        .bool, .int32, .uint32, .float32 => 4,
+        .int64, .uint64, .float64 => 8,
+        else => null,
+    };
+}
+
+fn layoutOf(rules: PackingRules, shape: Shape) Layout {
+    switch (shape) {
+        .scalar => |size| return .{ .size = size, .alignment = size },
+        .vector => |vector| {
+            const alignment = switch (rules) {
+                .std140, .std430 => vector.scalar * if (vector.count == 3) 4 else vector.count,
+                .scalar, .d3d_cbuffer => vector.scalar,
+            };
+            return .{ .size = vector.scalar * vector.count, .alignment = alignment };
+        },
+        .array => |array| {
+            const element = layoutOf(rules, array.element.*);
+            const alignment = switch (rules) {
+                .std140, .d3d_cbuffer => @max(element.alignment, 16),
+                .std430, .scalar => element.alignment,
+            };
+            const stride = std.mem.alignForward(u32, element.size, alignment);
+            // D3D does not pad the last element, the next field may start inside its register
+            const size = switch (rules) {
+                .d3d_cbuffer => stride * (array.count - 1) + element.size,
+                else => stride * array.count,
+            };
+            return .{ .size = size, .alignment = alignment };
+        },
+        .structure => |members| {
+            var offset: u32 = 0;
+            var alignment: u32 = switch (rules) {
+                .std140, .d3d_cbuffer => 16,
+                .std430, .scalar => 1,
+            };
+            for (members) |member| {
+                offset = place(rules, offset, member);
+                const member_layout = layoutOf(rules, member);
+                offset += member_layout.size;
+                alignment = @max(alignment, member_layout.alignment);
+            }
+            const size = switch (rules) {
+                .d3d_cbuffer => offset,
+                else => std.mem.alignForward(u32, offset, alignment),
+            };
+            return .{ .size = size, .alignment = alignment };
+        },
+    }
+}
+
+/// The offset a field of `shape` gets when the previous field ends at `offset`.
+fn place(rules: PackingRules, offset: u32, shape: Shape) u32 {
+    const layout = layoutOf(rules, shape);
+    const aligned = std.mem.alignForward(u32, offset, layout.alignment);
+    if (rules == .d3d_cbuffer and aligned % 16 + layout.size > 16) {
+        return std.mem.alignForward(u32, aligned, 16);
+    }
+    return aligned;
+}
+
+fn structSize(rules: PackingRules, shapes: []const Shape, order: []const u32) u32 {
+    var offset: u32 = 0;
+    var alignment: u32 = switch (rules) {
+        .std140, .d3d_cbuffer => 16,
+        .std430, .scalar => 1,
+    };
+    for (order) |index| {
+        offset = place(rules, offset, shapes[index]) + layoutOf(rules, shapes[index]).size;
+        alignment = @max(alignment, layoutOf(rules, shapes[index]).alignment);
+    }
+    // Padded to the alignment of the struct, a whole number of registers for std140 and D3D
+    return std.mem.alignForward(u32, offset, alignment);
+}
+
+fn dataSize(shape: Shape) usize {
+    return switch (shape) {
+        .scalar => |size| size,
+        .vector => |vector| vector.scalar * vector.count,
+        .array => |array| dataSize(array.element.*) * array.count,
+        .structure => |members| blk: {
+            var size: usize = 0;
+            for (members) |member| size += dataSize(member);
+            break :blk size;
+        },
+    };
+}
+
+/// Tries the declared order, the fields sorted by alignment and size, and a greedy order that
+/// always takes the field leaving the least padding, and keeps the smallest.
+fn propose(arena: std.mem.Allocator, rules: PackingRules, shapes: []const Shape) !Proposal {
+    const declared = try arena.alloc(u32, shapes.len);
+    for (declared, 0..) |*index, i| index.* = @intCast(i);
+    const size_before = structSize(rules, shapes, declared);
+    var best = Proposal{ .size_before = size_before, .size_after = size_before, .order = declared };
+
+    const Context = struct {
+        rules: PackingRules,
+        shapes: []const Shape,
+
+        fn largerFirst(context: @This(), a: u32, b: u32) bool {
+            const layout_a = layoutOf(context.rules, context.shapes[a]);
+            const layout_b = layoutOf(context.rules, context.shapes[b]);
+            if (layout_a.alignment != layout_b.alignment) return layout_a.alignment > layout_b.alignment;
+            return layout_a.size > layout_b.size;
+        }
+    };
+    const sorted = try arena.dupe(u32, declared);
+    std.sort.insertion(u32, sorted, Context{ .rules = rules, .shapes = shapes }, Context.largerFirst);
+    const sorted_size = structSize(rules, shapes, sorted);
+    if (sorted_size < best.size_after) best = .{ .size_before = size_before, .size_after = sorted_size, .order = sorted };
+
+    const greedy = try arena.alloc(u32, shapes.len);
+    const remaining = try arena.dupe(u32, sorted);
+    var remaining_len = remaining.len;
+    var offset: u32 = 0;
+    for (greedy) |*slot| {
+        var pick: usize = 0;
+        var pick_padding: u32 = std.math.maxInt(u32);
+        // `remaining` is sorted larger first, so ties go to the larger field
+        for (remaining[0..remaining_len], 0..) |index, i| {
+            const padding = place(rules, offset, shapes[index]) - offset;
+            if (padding < pick_padding) {
+                pick = i;
+                pick_padding = padding;
+            }
+        }
+        const index = remaining[pick];
+        std.mem.copyForwards(u32, remaining[pick .. remaining_len - 1], remaining[pick + 1 .. remaining_len]);
+        remaining_len -= 1;
+        slot.* = index;
+        offset = place(rules, offset, shapes[index]) + layoutOf(rules, shapes[index]).size;
+    }
+    const greedy_size = structSize(rules, shapes, greedy);
+    if (greedy_size < best.size_after) best = .{ .size_before = size_before, .size_after = greedy_size, .order = greedy };
+
+    return best;
+}
+
+fn isIdentity(order: []const u32) bool {
+    for (order, 0..) |index, i| {
+        if (index != i) return false;
+    }
+    return true;
+}
+
+test "uniform packing" {
+    var global_session = try slang.createGlobalSession(.{});
+    defer global_session.release();
+    const targets = [_]TargetDesc{.{ .format = .spirv, .profile = global_session.borrow().findProfile("spirv_1_5") }};
+    var session = try global_session.borrow().createSession(.{ .targets = &targets });
+    defer session.release();
+
+    const source =
+        \\struct Material { float roughness; float4 albedo; float metallic; float4 emission; }
+        \\ConstantBuffer<Material> material;
+        \\[shader("compute")] [numthreads(1, 1, 1)]
+        \\void main() {}
+    ;
+    var module = session.borrow().loadModuleFromSourceString("uniform_packing", "uniform_packing.slang", source, null) orelse return error.ModuleLoadFailed;
+    defer module.release();
+    var entry_point = try module.borrow().findEntryPointByName("main");
+    defer entry_point.release();
+    const components = [_]*IComponentType{ @ptrCast(module.borrow()), @ptrCast(entry_point.borrow()) };
+    var composite = try session.borrow().createCompositeComponentType(&components, null);
+    defer composite.release();
+    var linked = try composite.borrow().link(null);
+    defer linked.release();
+
+    var report = try analyzeUniforms(std.testing.allocator, session.borrow(), module.borrow(), linked.borrow(), &targets);
+    defer report.deinit();
+
+    try std.testing.expectEqual(1, report.structs.len);
+    const material = report.structs[0];
+    try std.testing.expectEqual(64, material.size);
+    try std.testing.expectEqual(40, material.used);
+    const proposal = material.proposals.get(.std140);
+    try std.testing.expectEqual(64, proposal.size_before);
+    try std.testing.expectEqual(48, proposal.size_after);
+    try std.testing.expectEqual(48, material.verified_size);
+}
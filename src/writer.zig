@@ -0,0 +1,314 @@
+//! Zig implementations of `IWriter`.
+//!
+//! `beginAppendBuffer` hands out memory that belongs to the destination, so text produced by
+//! slang is written in place instead of going through a temporary buffer first. The writers are
+//! owned by the caller and have to outlive every slang object they are given to, reference
+//! counting is a noop like for `IBlob.init`.
+
+const std = @import("std");
+const slang = @import("root.zig");
+
+const IUnknown = slang.IUnknown;
+const IWriter = slang.IWriter;
+const UUID = slang.UUID;
+const Result = slang.Result;
+const WriterMode = slang.WriterMode;
+const mcall = slang.mcall;
+
+/// Forwards everything to a `std.Io.Writer`. Appends are served from the buffer of the
+/// destination, only requests larger than that buffer go through a separately allocated one.
+pub const StreamWriter = struct {
+    interface: IWriter,
+    out: *std.Io.Writer,
+    gpa: std.mem.Allocator,
+    overflow: std.ArrayList(u8) = .empty,
+    mode: WriterMode = .text,
+    is_console: bool = false,
+    /// The last error that was reported to slang as a failed `Result`
+    err: ?anyerror = null,
+
+    pub fn init(gpa: std.mem.Allocator, out: *std.Io.Writer) StreamWriter {
+        return StreamWriter{
+            .interface = .{ .vtable = vtableFor(StreamWriter) },
+            .out = out,
+            .gpa = gpa,
+        };
+    }
+
+    pub fn deinit(self: *StreamWriter) void {
+        self.overflow.deinit(self.gpa);
+    }
+
+    pub fn asWriter(self: *StreamWriter) *IWriter {
+        return &self.interface;
+    }
+
+    fn beginAppendBuffer(self: *StreamWriter, max_len: usize) ![]u8 {
+        if (max_len <= self.out.buffer.len) {
+            return self.out.writableSliceGreedy(max_len);
+        }
+        try self.overflow.resize(self.gpa, max_len);
+        return self.overflow.items;
+    }
+
+    fn endAppendBuffer(self: *StreamWriter, buffer: []u8) !void {
+        if (self.overflow.items.len != 0 and buffer.ptr == self.overflow.items.ptr) {
+            defer self.overflow.clearRetainingCapacity();
+            return self.out.writeAll(buffer);
+        }
+        self.out.advance(buffer.len);
+    }
+
+    fn writeAll(self: *StreamWriter, bytes: []const u8) !void {
+        return self.out.writeAll(bytes);
+    }
+
+    fn flush(self: *StreamWriter) !void {
+        return self.out.flush();
+    }
+};
+
+/// Keeps the last `capacity` bytes that were written in a caller provided buffer. The buffer has
+/// an extra spill region at the end, so appends that wrap around can still be handed out as one
+/// contiguous slice, which limits the size of a single append to the size of the spill region.
+pub const RingWriter = struct {
+    interface: IWriter,
+    buffer: []u8,
+    capacity: usize,
+    head: usize = 0,
+    total_written: u64 = 0,
+    mode: WriterMode = .text,
+    is_console: bool = false,
+    err: ?anyerror = null,
+
+    /// The last `spill_len` bytes of `buffer` are reserved for appends that wrap around.
+    pub fn init(buffer: []u8, spill_len: usize) RingWriter {
+        std.debug.assert(spill_len < buffer.len and spill_len <= buffer.len - spill_len);
+        return RingWriter{
+            .interface = .{ .vtable = vtableFor(RingWriter) },
+            .buffer = buffer,
+            .capacity = buffer.len - spill_len,
+        };
+    }
+
+    pub fn asWriter(self: *RingWriter) *IWriter {
+        return &self.interface;
+    }
+
+    /// The retained bytes from oldest to newest, split in two where the ring wraps around.
+    pub fn slices(self: *const RingWriter) [2][]const u8 {
+        if (self.total_written < self.capacity) {
+            return .{ self.buffer[0..self.head], &.{} };
+        }
+        return .{ self.buffer[self.head..self.capacity], self.buffer[0..self.head] };
+    }
+
+    pub fn reset(self: *RingWriter) void {
+        self.head = 0;
+        self.total_written = 0;
+    }
+
+    fn beginAppendBuffer(self: *RingWriter, max_len: usize) ![]u8 {
+        if (max_len > self.buffer.len - self.capacity) return error.BufferTooSmall;
+        return self.buffer[self.head..][0..max_len];
+    }
+
+    fn endAppendBuffer(self: *RingWriter, buffer: []u8) !void {
+        std.debug.assert(buffer.ptr == self.buffer[self.head..].ptr);
+        const end = self.head + buffer.len;
+        if (end > self.capacity) {
+            const wrapped = end - self.capacity;
+            @memcpy(self.buffer[0..wrapped], self.buffer[self.capacity..end]);
+        }
+        self.head = end % self.capacity;
+        self.total_written += buffer.len;
+    }
+
+    fn writeAll(self: *RingWriter, bytes: []const u8) !void {
+        self.total_written += bytes.len;
+        if (bytes.len >= self.capacity) {
+            @memcpy(self.buffer[0..self.capacity], bytes[bytes.len - self.capacity ..]);
+            self.head = 0;
+            return;
+        }
+
+        const first = @min(bytes.len, self.capacity - self.head);
+        @memcpy(self.buffer[self.head..][0..first], bytes[0..first]);
+        @memcpy(self.buffer[0 .. bytes.len - first], bytes[first..]);
+        self.head = (self.head + bytes.len) % self.capacity;
+    }
+
+    fn flush(_: *RingWriter) !void {}
+};
+
+/// Discards everything and only counts what was written. Appends are served from a caller
+/// provided scratch buffer, which limits the size of a single append.
+pub const CountingWriter = struct {
+    interface: IWriter,
+    scratch: []u8,
+    bytes_written: u64 = 0,
+    write_count: u64 = 0,
+    mode: WriterMode = .text,
+    is_console: bool = false,
+    err: ?anyerror = null,
+
+    pub fn init(scratch: []u8) CountingWriter {
+        return CountingWriter{
+            .interface = .{ .vtable = vtableFor(CountingWriter) },
+            .scratch = scratch,
+        };
+    }
+
+    pub fn asWriter(self: *CountingWriter) *IWriter {
+        return &self.interface;
+    }
+
+    fn beginAppendBuffer(self: *CountingWriter, max_len: usize) ![]u8 {
+        if (max_len > self.scratch.len) return error.BufferTooSmall;
+        return self.scratch[0..max_len];
+    }
+
+    fn endAppendBuffer(self: *CountingWriter, buffer: []u8) !void {
+        return self.writeAll(buffer);
+    }
+
+    fn writeAll(self: *CountingWriter, bytes: []const u8) !void {
+        self.bytes_written += bytes.len;
+        self.write_count += 1;
+    }
+
+    fn flush(_: *CountingWriter) !void {}
+};
+
+/// Builds the `IWriter` vtable for an implementation that has an `interface` field, the `mode`,
+/// `is_console` and `err` fields, and the `beginAppendBuffer`, `endAppendBuffer`, `writeAll`
+/// and `flush` methods. Errors are stored in `err` and reported to slang as `Result.fail`.
+fn vtableFor(comptime Self: type) *const IWriter.VTable {
+    return &struct {
+        const vtable = IWriter.VTable{
+            .base = .{
+                .queryInterface = &queryInterface,
+                .addRef = &addRef,
+                .release = &release,
+            },
+            .beginAppendBuffer = &beginAppendBuffer,
+            .endAppendBuffer = &endAppendBuffer,
+            .write = &write,
+            .flush = &flush,
+            .isConsole = &isConsole,
+            .setMode = &setMode,
+        };
+
+        fn fromInterface(this: *IWriter) *Self {
+            return @fieldParentPtr("interface", this);
+        }
+
+        fn queryInterface(this: *IUnknown, uuid: *const UUID, out_object: **anyopaque) callconv(mcall) Result {
+            if (!uuid.eql(IUnknown.uuid) and !uuid.eql(IWriter.uuid)) return .no_interface;
+            out_object.* = this;
+            return .ok;
+        }
+
+        fn addRef(_: *IUnknown) callconv(mcall) u32 {
+            return 1;
+        }
+
+        fn release(_: *IUnknown) callconv(mcall) u32 {
+            return 1;
+        }
+
+        fn beginAppendBuffer(this: *IWriter, max_num_chars: usize) callconv(mcall) ?[*]u8 {
+            const self = fromInterface(this);
+            const buffer = self.beginAppendBuffer(max_num_chars) catch |err| {
+                self.err = err;
+                return null;
+            };
+            return buffer.ptr;
+        }
+
+        fn endAppendBuffer(this: *IWriter, buffer: [*]u8, num_chars: usize) callconv(mcall) Result {
+            const self = fromInterface(this);
+            self.endAppendBuffer(buffer[0..num_chars]) catch |err| {
+                self.err = err;
+                return .fail;
+            };
+            return .ok;
+        }
+
+        fn write(this: *IWriter, chars: [*]const u8, num_chars: usize) callconv(mcall) Result {
+            const self = fromInterface(this);
+            self.writeAll(chars[0..num_chars]) catch |err| {
+                self.err = err;
+                return .fail;
+            };
+            return .ok;
+        }
+
+        fn flush(this: *IWriter) callconv(mcall) void {
+            const self = fromInterface(this);
+            self.flush() catch |err| {
+                self.err = err;
+            };
+        }
+
+        fn isConsole(this: *IWriter) callconv(mcall) bool {
+            return fromInterface(this).is_console;
+        }
+
+        fn setMode(this: *IWriter, mode: WriterMode) callconv(mcall) Result {
+            fromInterface(this).mode = mode;
+            return .ok;
+        }
+    }.vtable;
+}
+
+test "ring writer" {
+    var buffer: [16 + 8]u8 = undefined;
+    var ring = RingWriter.init(&buffer, 8);
+    const writer = ring.asWriter();
+
+    try writer.write("hello ");
+    try std.testing.expectEqualStrings("hello ", ring.slices()[0]);
+    try writer.write("01234567");
+
+    // Crosses the end of the ring, the part in the spill region gets moved to the front
+    const append = try writer.beginAppendBuffer(8);
+    @memcpy(append[0..5], "wrap!");
+    try writer.endAppendBuffer(append[0..5]);
+
+    const parts = ring.slices();
+    try std.testing.expectEqualStrings("lo 01234567wr", parts[0]);
+    try std.testing.expectEqualStrings("ap!", parts[1]);
+    try std.testing.expectEqual(19, ring.total_written);
+
+    // Larger than the spill region
+    try std.testing.expectError(error.AppendBufferFailed, writer.beginAppendBuffer(9));
+    try std.testing.expectEqual(error.BufferTooSmall, ring.err.?);
+}
+
+test "stream writer" {
+    const gpa = std.testing.allocator;
+    var out: std.Io.Writer.Allocating = try .initCapacity(gpa, 16);
+    defer out.deinit();
+    var stream = StreamWriter.init(gpa, &out.writer);
+    defer stream.deinit();
+    const writer = stream.asWriter();
+
+    try writer.write("hello ");
+    // Fits in the buffer of the destination, written in place
+    const append = try writer.beginAppendBuffer(4);
+    try std.testing.expectEqual(0, stream.overflow.items.len);
+    @memcpy(append[0..3], "abc");
+    try writer.endAppendBuffer(append[0..3]);
+
+    // Larger than the buffer of the destination, goes through the overflow buffer
+    const large = try writer.beginAppendBuffer(out.writer.buffer.len + 1);
+    try std.testing.expectEqual(stream.overflow.items.ptr, large.ptr);
+    @memset(large[0..20], 'x');
+    try writer.endAppendBuffer(large[0..20]);
+    try std.testing.expectEqual(0, stream.overflow.items.len);
+
+    writer.flush();
+    try std.testing.expectEqualStrings("hello abc" ++ "x" ** 20, out.written());
+    try std.testing.expectEqual(null, stream.err);
+}
@@ -0,0 +1,307 @@
+//! Measures how compile throughput scales with the number of threads and with how they share
+//! global sessions.
+//!
+//! Usage: bench_sessions [options] [inputs...]
+//!
+//! Every job creates a session, loads one module from source under a name of its own, links all
+//! of its entry points and generates their code. Every configuration runs the same number of
+//! jobs, spread over its threads. The inputs are the sources compiled round robin, without inputs
+//! a small built in compute shader is used.
+//!
+//!   -threads <list>   Comma separated thread counts, the default is the powers of two up to the
+//!                     number of cpus.
+//!   -jobs <n>         Jobs per configuration, the default is 64.
+//!   -profile <name>   SPIR-V profile to compile for, the default is spirv_1_5.
+//!   -unsafe-shared    Also run the `shared` strategy, which slang doesn't support and which may
+//!                     crash or corrupt its state.
+//!
+//! Strategies:
+//!   per_thread   Every thread creates its own global session.
+//!   serialized   One global session, every job holds a lock while it uses slang. This is the
+//!                supported way of sharing a global session and the baseline for contention.
+//!   shared       One global session used by all threads at once.
+//!
+//! The report has the throughput, the percentiles of the job latency, the scaling efficiency
+//! compared to one thread of the same strategy, and the growth of the resident set size. Memory is
+//! not always given back to the system between configurations, so the growth of later ones is an
+//! underestimate.
+
+const std = @import("std");
+const slang = @import("slang");
+
+const fatal = std.process.fatal;
+
+const max_file_size = 256 * 1024 * 1024;
+
+const default_source =
+    \\struct Particle { float3 position; float3 velocity; float life; };
+    \\RWStructuredBuffer<Particle> particles;
+    \\uniform float delta_time;
+    \\
+    \\float3 curl(float3 p) {
+    \\    return float3(sin(p.y * 1.7) - cos(p.z * 2.3), sin(p.z * 1.3) - cos(p.x * 2.9), sin(p.x * 3.1) - cos(p.y * 1.9));
+    \\}
+    \\
+    \\[shader("compute")]
+    \\[numthreads(64, 1, 1)]
+    \\void simulate(uint3 id : SV_DispatchThreadID) {
+    \\    Particle p = particles[id.x];
+    \\    for (int i = 0; i < 4; i++) p.velocity += curl(p.position * float(i + 1)) * delta_time;
+    \\    p.position += p.velocity * delta_time;
+    \\    p.life -= delta_time;
+    \\    particles[id.x] = p;
+    \\}
+    \\
+    \\[shader("compute")]
+    \\[numthreads(64, 1, 1)]
+    \\void reset(uint3 id : SV_DispatchThreadID) {
+    \\    if (particles[id.x].life <= 0) particles[id.x] = { float3(0), curl(float3(id)), 1 };
+    \\}
+;
+
+const Strategy = enum { per_thread, serialized, shared };
+
+const Options = struct {
+    thread_counts: []const usize,
+    jobs: usize = 64,
+    profile: [:0]const u8 = "spirv_1_5",
+    unsafe_shared: bool = false,
+    sources: []const [:0]const u8,
+};
+
+const Bench = struct {
+    options: *const Options,
+    strategy: Strategy,
+    /// Used by every thread unless the strategy is `per_thread`
+    global_session: *slang.IGlobalSession,
+    mutex: std.Thread.Mutex = .{},
+    next_job: std.atomic.Value(usize) = .init(0),
+    failed: std.atomic.Value(usize) = .init(0),
+    peak_rss: std.atomic.Value(usize) = .init(0),
+    /// Nanoseconds per job, every job writes its own slot
+    latencies: []u64,
+
+    fn run(bench: *Bench) void {
+        var own_session: ?slang.Owned(slang.IGlobalSession) = null;
+        defer if (own_session) |*global_session| global_session.release();
+        if (bench.strategy == .per_thread) {
+            own_session = slang.createGlobalSession(.{}) catch {
+                // Every job this thread would have taken is left to the others
+                _ = bench.failed.fetchAdd(1, .monotonic);
+                return;
+            };
+        }
+        const global_session = if (own_session) |owned| owned.borrow() else bench.global_session;
+
+        while (true) {
+            const job = bench.next_job.fetchAdd(1, .monotonic);
+            if (job >= bench.latencies.len) break;
+
+            var timer = std.time.Timer.start() catch unreachable;
+            {
+                if (bench.strategy == .serialized) bench.mutex.lock();
+                defer if (bench.strategy == .serialized) bench.mutex.unlock();
+                compile(global_session, bench.options, job) catch {
+                    _ = bench.failed.fetchAdd(1, .monotonic);
+                };
+            }
+            bench.latencies[job] = timer.read();
+
+            const rss = slang.residentSetSize() catch 0;
+            _ = bench.peak_rss.fetchMax(rss, .monotonic);
+        }
+    }
+};
+
+fn compile(global_session: *slang.IGlobalSession, options: *const Options, job: usize) !void {
+    var session = try global_session.createSession(.{
+        .targets = &.{.{ .format = .spirv, .profile = global_session.findProfile(options.profile) }},
+    });
+    defer session.release();
+
+    var name_buffer: [32]u8 = undefined;
+    const name = try std.fmt.bufPrintZ(&name_buffer, "bench_{d}", .{job});
+    const source = options.sources[job % options.sources.len];
+    var module = session.borrow().loadModuleFromSourceString(name, name, source, null) orelse return error.ModuleLoadFailed;
+    defer module.release();
+
+    var components: [17]*slang.IComponentType = undefined;
+    components[0] = @ptrCast(module.borrow());
+    const entry_point_count: usize = @intCast(@min(module.borrow().getDefinedEntryPointCount(), components.len - 1));
+    var created: usize = 0;
+    defer for (components[1..][0..created]) |component| component.release();
+    for (components[1..][0..entry_point_count], 0..) |*component, i| {
+        var entry_point = try module.borrow().getDefinedEntryPoint(@intCast(i));
+        component.* = @ptrCast(entry_point.leak());
+        created += 1;
+    }
+
+    var composite = try session.borrow().createCompositeComponentType(components[0 .. 1 + entry_point_count], null);
+    defer composite.release();
+    var linked = try composite.borrow().link(null);
+    defer linked.release();
+    for (0..entry_point_count) |i| {
+        var code = try linked.borrow().getEntryPointCode(@intCast(i), 0, null);
+        code.release();
+    }
+}
+
+const Row = struct {
+    strategy: Strategy,
+    threads: usize,
+    seconds: f64,
+    failed: usize,
+    p50: u64,
+    p90: u64,
+    p99: u64,
+    rss_growth: usize,
+
+    fn throughput(row: Row, jobs: usize) f64 {
+        return @as(f64, @floatFromInt(jobs)) / row.seconds;
+    }
+};
+
+fn runConfiguration(gpa: std.mem.Allocator, options: *const Options, strategy: Strategy, thread_count: usize) !Row {
+    // Taken first, so the memory of every strategy includes its global sessions
+    const rss_before = slang.residentSetSize() catch 0;
+    var global_session = try slang.createGlobalSession(.{});
+    defer global_session.release();
+
+    const latencies = try gpa.alloc(u64, options.jobs);
+    defer gpa.free(latencies);
+    @memset(latencies, 0);
+
+    var bench = Bench{
+        .options = options,
+        .strategy = strategy,
+        .global_session = global_session.borrow(),
+        .latencies = latencies,
+    };
+    bench.peak_rss.store(rss_before, .monotonic);
+
+    const threads = try gpa.alloc(std.Thread, thread_count - 1);
+    defer gpa.free(threads);
+    var timer = try std.time.Timer.start();
+    var spawned: usize = 0;
+    defer for (threads[0..spawned]) |thread| thread.join();
+    for (threads) |*thread| {
+        thread.* = try std.Thread.spawn(.{}, Bench.run, .{&bench});
+        spawned += 1;
+    }
+    bench.run();
+    for (threads[0..spawned]) |thread| thread.join();
+    spawned = 0;
+    const elapsed = timer.read();
+
+    std.sort.pdq(u64, latencies, {}, std.sort.asc(u64));
+    return Row{
+        .strategy = strategy,
+        .threads = thread_count,
+        .seconds = @as(f64, @floatFromInt(elapsed)) / std.time.ns_per_s,
+        .failed = bench.failed.load(.monotonic),
+        .p50 = percentile(latencies, 50),
+        .p90 = percentile(latencies, 90),
+        .p99 = percentile(latencies, 99),
+        .rss_growth = bench.peak_rss.load(.monotonic) -| rss_before,
+    };
+}
+
+fn percentile(sorted: []const u64, p: usize) u64 {
+    if (sorted.len == 0) return 0;
+    return sorted[@min(sorted.len - 1, sorted.len * p / 100)];
+}
+
+pub fn main() !void {
+    var gpa_state: std.heap.DebugAllocator(.{}) = .init;
+    defer _ = gpa_state.deinit();
+    const gpa = gpa_state.allocator();
+
+    var arena_state = std.heap.ArenaAllocator.init(gpa);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    const options = try parseArgs(arena, try std.process.argsAlloc(arena));
+
+    var strategies: std.ArrayList(Strategy) = .empty;
+    try strategies.appendSlice(arena, &.{ .per_thread, .serialized });
+    if (options.unsafe_shared) try strategies.append(arena, .shared);
+
+    var stdout_buffer: [4096]u8 = undefined;
+    var stdout_writer = std.fs.File.stdout().writer(&stdout_buffer);
+    const stdout = &stdout_writer.interface;
+
+    try stdout.print("{d} jobs per configuration, {d} sources\n\n", .{ options.jobs, options.sources.len });
+    try stdout.print("{s:<12} {s:>7} {s:>10} {s:>10} {s:>10} {s:>10} {s:>10} {s:>11} {s:>6}\n", .{
+        "strategy", "threads", "jobs/s", "p50", "p90", "p99", "efficiency", "rss growth", "failed",
+    });
+    try stdout.flush();
+
+    for (strategies.items) |strategy| {
+        var single_thread: ?f64 = null;
+        for (options.thread_counts) |thread_count| {
+            const row = runConfiguration(gpa, &options, strategy, thread_count) catch |err| {
+                fatal("{t} with {d} threads failed: {s}", .{ strategy, thread_count, @errorName(err) });
+            };
+            const throughput = row.throughput(options.jobs);
+            // Relative to the first count of the sweep when it doesn't start at one thread
+            if (single_thread == null) single_thread = throughput / @as(f64, @floatFromInt(thread_count));
+            const efficiency = throughput / (single_thread.? * @as(f64, @floatFromInt(thread_count)));
+
+            try stdout.print("{s:<12} {d:>7} {d:>10.1} {D:>10} {D:>10} {D:>10} {d:>9.0}% {Bi:>11.1} {d:>6}\n", .{
+                @tagName(strategy), thread_count, throughput, row.p50, row.p90, row.p99,
+                efficiency * 100, row.rss_growth, row.failed,
+            });
+            try stdout.flush();
+        }
+    }
+}
+
+fn parseArgs(arena: std.mem.Allocator, args: []const [:0]const u8) !Options {
+    var thread_counts: std.ArrayList(usize) = .empty;
+    var sources: std.ArrayList([:0]const u8) = .empty;
+    var options = Options{ .thread_counts = &.{}, .sources = &.{} };
+
+    var i: usize = 1;
+    while (i < args.len) : (i += 1) {
+        const arg = args[i];
+        if (std.mem.eql(u8, arg, "-threads")) {
+            var it = std.mem.tokenizeScalar(u8, value(args, &i), ',');
+            while (it.next()) |count| {
+                const parsed = std.fmt.parseInt(usize, count, 10) catch fatal("invalid thread count '{s}'", .{count});
+                if (parsed == 0) fatal("thread counts have to be at least 1", .{});
+                try thread_counts.append(arena, parsed);
+            }
+        } else if (std.mem.eql(u8, arg, "-jobs")) {
+            const count = value(args, &i);
+            options.jobs = std.fmt.parseInt(usize, count, 10) catch fatal("invalid job count '{s}'", .{count});
+        } else if (std.mem.eql(u8, arg, "-profile")) {
+            options.profile = value(args, &i);
+        } else if (std.mem.eql(u8, arg, "-unsafe-shared")) {
+            options.unsafe_shared = true;
+        } else if (!std.mem.startsWith(u8, arg, "-")) {
+            const source = std.fs.cwd().readFileAllocOptions(arena, arg, max_file_size, null, .of(u8), 0) catch |err| {
+                fatal("unable to read '{s}': {s}", .{ arg, @errorName(err) });
+            };
+            try sources.append(arena, source);
+        } else {
+            fatal("unknown option '{s}'", .{arg});
+        }
+    }
+
+    if (thread_counts.items.len == 0) {
+        const cpu_count = std.Thread.getCpuCount() catch 1;
+        var count: usize = 1;
+        while (count < cpu_count) : (count *= 2) try thread_counts.append(arena, count);
+        try thread_counts.append(arena, cpu_count);
+    }
+    if (sources.items.len == 0) try sources.append(arena, default_source);
+    options.thread_counts = thread_counts.items;
+    options.sources = sources.items;
+    return options;
+}
+
+fn value(args: []const [:0]const u8, i: *usize) [:0]const u8 {
+    if (i.* + 1 == args.len) fatal("missing value for {s}", .{args[i.*]});
+    i.* += 1;
+    return args[i.*];
+}
@@ -0,0 +1,436 @@
+//! Generates Zig declarations for the parameters of a shader, so host code can fill uniform data
+//! with plain struct stores instead of looking up offsets through reflection at runtime.
+//!
+//! Usage: bindgen <input> -o <output.zig> [options]
+//!
+//!   -entry <name>       Entry point to include, can be repeated. The default is every entry
+//!                       point marked with `[shader(...)]`.
+//!   -depfile <path>     Write a Makefile style dependency file for the output.
+//!
+//! Everything else is passed on to `IGlobalSession.parseCommandLineArguments`, which has to
+//! produce exactly one target, the layouts are the ones of that target.
+//!
+//! The output contains an `extern struct` for every struct that is used as uniform data by a
+//! parameter or that is declared at the top level of the module, the latter are laid out with the
+//! default rules of the target. Padding is spelled out as fields, and every size and offset is
+//! checked at compile time. Parameters get a namespace with their descriptor set and binding
+//! indices and the struct of their uniform data, if any.
+
+const std = @import("std");
+const slang = @import("slang");
+
+const fatal = std.process.fatal;
+
+const max_file_size = 256 * 1024 * 1024;
+
+pub fn main() !void {
+    var arena_state = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    const args = try std.process.argsAlloc(arena);
+    var input: ?[:0]const u8 = null;
+    var output: ?[]const u8 = null;
+    var depfile: ?[]const u8 = null;
+    var entry_points: std.ArrayList([:0]const u8) = .empty;
+    var slang_args: std.ArrayList([*:0]const u8) = .empty;
+
+    var i: usize = 1;
+    while (i < args.len) : (i += 1) {
+        const arg = args[i];
+        if (std.mem.eql(u8, arg, "-o")) {
+            output = value(args, &i);
+        } else if (std.mem.eql(u8, arg, "-depfile")) {
+            depfile = value(args, &i);
+        } else if (std.mem.eql(u8, arg, "-entry")) {
+            try entry_points.append(arena, value(args, &i));
+        } else if (std.mem.eql(u8, arg, "-stage")) {
+            // Accepted for compatibility with slangc, the layouts don't depend on it
+            _ = value(args, &i);
+        } else if (input == null and !std.mem.startsWith(u8, arg, "-")) {
+            input = arg;
+        } else {
+            try slang_args.append(arena, arg.ptr);
+        }
+    }
+    const input_path = input orelse fatal("no input file", .{});
+    const output_path = output orelse fatal("no output file, pass one with -o", .{});
+
+    var global_session = try slang.createGlobalSession(.{});
+    defer global_session.release();
+    var parsed = try global_session.borrow().parseCommandLineArguments(slang_args.items);
+    defer parsed.deinit();
+    if (parsed.session_desc.targets.len != 1) {
+        fatal("expected exactly one -target, got {d}", .{parsed.session_desc.targets.len});
+    }
+    var session = try global_session.borrow().createSession(parsed.session_desc);
+    defer session.release();
+
+    const source = std.fs.cwd().readFileAllocOptions(arena, input_path, max_file_size, null, .of(u8), 0) catch |err| {
+        fatal("unable to read '{s}': {s}", .{ input_path, @errorName(err) });
+    };
+    var module = session.borrow().loadModuleFromSource(input_path, input_path, source, null) orelse {
+        fatal("unable to load '{s}'", .{input_path});
+    };
+    defer module.release();
+
+    var components: std.ArrayList(*slang.IComponentType) = .empty;
+    try components.append(arena, @ptrCast(module.borrow()));
+    defer for (components.items[1..]) |component| component.release();
+    if (entry_points.items.len == 0) {
+        for (0..@intCast(module.borrow().getDefinedEntryPointCount())) |index| {
+            var entry_point = try module.borrow().getDefinedEntryPoint(@intCast(index));
+            try components.append(arena, @ptrCast(entry_point.leak()));
+        }
+    } else for (entry_points.items) |name| {
+        var entry_point = try module.borrow().findEntryPointByName(name);
+        try components.append(arena, @ptrCast(entry_point.leak()));
+    }
+
+    var program = try session.borrow().createCompositeComponentType(components.items, null);
+    defer program.release();
+    var linked_program = try program.borrow().link(null);
+    defer linked_program.release();
+    const reflection = linked_program.borrow().getLayout(0, null) orelse fatal("unable to get the layout of '{s}'", .{input_path});
+
+    var generator = Generator{ .arena = arena, .reflection = reflection };
+    const code = try generator.generate(input_path, module.borrow().getModuleReflection());
+
+    const out_file = std.fs.cwd().createFile(output_path, .{}) catch |err| {
+        fatal("unable to create '{s}': {s}", .{ output_path, @errorName(err) });
+    };
+    defer out_file.close();
+    try out_file.writeAll(code);
+
+    if (depfile) |path| {
+        var buffer: [4096]u8 = undefined;
+        const file = try std.fs.cwd().createFile(path, .{});
+        defer file.close();
+        var file_writer = file.writer(&buffer);
+        const writer = &file_writer.interface;
+        try writer.print("{s}:", .{output_path});
+        for (0..@intCast(module.borrow().getDependencyFileCount())) |index| {
+            try writer.print(" \\\n  {s}", .{module.borrow().getDependencyFilePath(@intCast(index))});
+        }
+        try writer.writeAll("\n");
+        try writer.flush();
+    }
+}
+
+fn value(args: []const [:0]const u8, i: *usize) [:0]const u8 {
+    if (i.* + 1 == args.len) fatal("missing value for {s}", .{args[i.*]});
+    i.* += 1;
+    return args[i.*];
+}
+
+/// A Zig type that matches the uniform layout of a shader type.
+const Type = struct {
+    expr: []const u8,
+    size: usize,
+    /// Natural alignment of `expr` in Zig, which can be larger than what the layout rules ask for
+    alignment: usize,
+
+    fn bytes(arena: std.mem.Allocator, size: usize) !Type {
+        return Type{ .expr = try std.fmt.allocPrint(arena, "[{d}]u8", .{size}), .size = size, .alignment = 1 };
+    }
+};
+
+const Field = struct {
+    name: []const u8,
+    offset: usize,
+    type: Type,
+};
+
+const Generator = struct {
+    arena: std.mem.Allocator,
+    reflection: *slang.ShaderReflection,
+    structs: std.StringHashMapUnmanaged(Type) = .empty,
+    definitions: std.ArrayList(u8) = .empty,
+    uses_padded: bool = false,
+
+    fn generate(self: *Generator, input_path: []const u8, module_decl: *slang.DeclReflection) ![]const u8 {
+        var bindings: std.Io.Writer.Allocating = .init(self.arena);
+        const writer = &bindings.writer;
+
+        for (0..self.reflection.getParameterCount()) |index| {
+            try self.writeParameter(writer, self.reflection.getParameterByIndex(@intCast(index)));
+        }
+
+        var struct_decls = module_decl.getChildernOfKind(.@"struct");
+        while (struct_decls.next()) |decl| {
+            const type_layout = self.reflection.getTypeLayout(decl.getType(), .default);
+            _ = try self.structType(type_layout);
+        }
+
+        var out: std.Io.Writer.Allocating = .init(self.arena);
+        const w = &out.writer;
+        try w.print("//! Generated by tools/bindgen.zig from {s}, do not edit.\n\n", .{std.fs.path.basename(input_path)});
+        try w.writeAll("const std = @import(\"std\");\n");
+        if (self.uses_padded) {
+            try w.writeAll(
+                \\
+                \\/// An array element followed by the padding up to the array stride.
+                \\pub fn Padded(comptime T: type, comptime padding: usize) type {
+                \\    return extern struct {
+                \\        value: T,
+                \\        _padding: [padding]u8 = @splat(0),
+                \\    };
+                \\}
+                \\
+            );
+        }
+        try w.writeAll(bindings.written());
+        try w.writeAll(self.definitions.items);
+        return out.written();
+    }
+
+    fn writeParameter(self: *Generator, w: *std.Io.Writer, parameter: *slang.VariableLayoutReflection) !void {
+        const type_layout = parameter.getTypeLayout();
+        try w.print("\npub const {f} = struct {{\n", .{std.zig.fmtId(std.mem.span(parameter.getName()))});
+
+        switch (type_layout.getKind()) {
+            .parameter_block => {
+                try w.print("    pub const set = {d};\n", .{parameter.getOffset(.sub_element_register_space)});
+
+                // Uniform fields of a parameter block go into an implicit constant buffer
+                const element = type_layout.getElementTypeLayout();
+                const element_var = type_layout.getElementVarLayout();
+                if (element.getSize(.uniform) != 0) {
+                    const container = type_layout.getContainerVarLayout();
+                    try w.print("    pub const uniform_binding = {d};\n", .{container.getOffset(.descriptor_table_slot)});
+                    try w.print("    pub const Uniforms = {s};\n", .{(try self.typeOf(element)).expr});
+                }
+                for (0..element.getFieldCount()) |index| {
+                    const field = element.getFieldByIndex(@intCast(index));
+                    if (!hasCategory(field.getTypeLayout(), .descriptor_table_slot)) continue;
+                    const binding = element_var.getOffset(.descriptor_table_slot) + field.getOffset(.descriptor_table_slot);
+                    try w.print("    pub const {f} = {d};\n", .{ std.zig.fmtId(std.mem.span(field.getName())), binding });
+                }
+            },
+            .constant_buffer => {
+                if (type_layout.getParameterCategory() == .push_constant_buffer) {
+                    try w.writeAll("    pub const push_constant = true;\n");
+                } else {
+                    try w.print("    pub const set = {d};\n", .{parameter.getBindingSpace(.descriptor_table_slot)});
+                    try w.print("    pub const binding = {d};\n", .{parameter.getOffset(.descriptor_table_slot)});
+                }
+                try w.print("    pub const Uniforms = {s};\n", .{(try self.typeOf(type_layout.getElementTypeLayout())).expr});
+            },
+            else => {
+                try w.print("    pub const set = {d};\n", .{parameter.getBindingSpace(.descriptor_table_slot)});
+                try w.print("    pub const binding = {d};\n", .{parameter.getOffset(.descriptor_table_slot)});
+            },
+        }
+        try w.writeAll("};\n");
+    }
+
+    /// Types that take no uniform space, like textures and samplers, come out with a size of 0.
+    fn typeOf(self: *Generator, type_layout: *slang.TypeLayoutReflection) !Type {
+        const size = type_layout.getSize(.uniform);
+        switch (type_layout.getKind()) {
+            .scalar => if (scalarType(type_layout.getScalarType(), size)) |scalar| return scalar,
+            .vector => if (scalarType(type_layout.getScalarType(), null)) |scalar| {
+                const count = type_layout.getType().getElementCount(null);
+                if (count * scalar.size == size) return self.arrayOf(count, scalar);
+            },
+            .matrix => if (scalarType(type_layout.getScalarType(), null)) |scalar| {
+                // Every row or column is a vector that is padded to the alignment of the matrix
+                const rows = type_layout.getRowCount();
+                const columns = type_layout.getColumnCount();
+                const vector_count, const vector_len = switch (type_layout.getMatrixLayoutMode()) {
+                    .column_major => .{ columns, rows },
+                    else => .{ rows, columns },
+                };
+                const alignment: usize = @intCast(@max(1, type_layout.getAlignment(.uniform)));
+                const stride = std.mem.alignForward(usize, vector_len * scalar.size, alignment);
+                // The last vector is not padded under some rules, the fields can't describe that
+                if (vector_count * stride == size and stride % scalar.size == 0) {
+                    return self.arrayOf(vector_count, try self.arrayOf(stride / scalar.size, scalar));
+                }
+            },
+            .array => {
+                const count = type_layout.getType().getElementCount(null);
+                const element = try self.typeOf(type_layout.getElementTypeLayout());
+                const stride = type_layout.getElementStride(.uniform);
+                if (count != 0 and element.size == stride and count * stride == size) {
+                    return self.arrayOf(count, element);
+                }
+                if (count != 0 and element.size < stride and count * stride == size) {
+                    self.uses_padded = true;
+                    const padded = Type{
+                        .expr = try std.fmt.allocPrint(self.arena, "Padded({s}, {d})", .{ element.expr, stride - element.size }),
+                        .size = stride,
+                        .alignment = element.alignment,
+                    };
+                    return self.arrayOf(count, padded);
+                }
+            },
+            .@"struct" => return self.structType(type_layout),
+            else => {},
+        }
+        return Type.bytes(self.arena, size);
+    }
+
+    fn arrayOf(self: *Generator, count: usize, element: Type) !Type {
+        return Type{
+            .expr = try std.fmt.allocPrint(self.arena, "[{d}]{s}", .{ count, element.expr }),
+            .size = count * element.size,
+            .alignment = element.alignment,
+        };
+    }
+
+    fn structType(self: *Generator, type_layout: *slang.TypeLayoutReflection) !Type {
+        const size = type_layout.getSize(.uniform);
+        var name: []const u8 = std.mem.span(type_layout.getName());
+        if (self.structs.get(name)) |existing| {
+            if (existing.size == size) return existing;
+            // The same struct under different layout rules
+            name = try std.fmt.allocPrint(self.arena, "{s}_{d}", .{ name, size });
+            if (self.structs.get(name)) |existing_sized| return existing_sized;
+        }
+        // Registered before the fields, so self referencing types terminate
+        const placeholder = Type{ .expr = try std.fmt.allocPrint(self.arena, "{f}", .{std.zig.fmtId(name)}), .size = size, .alignment = 1 };
+        try self.structs.put(self.arena, name, placeholder);
+
+        var fields: std.ArrayList(Field) = .empty;
+        for (0..type_layout.getFieldCount()) |index| {
+            const field = type_layout.getFieldByIndex(@intCast(index));
+            const field_type = try self.typeOf(field.getTypeLayout());
+            if (field_type.size == 0) continue;
+            try fields.append(self.arena, .{
+                .name = std.mem.span(field.getName()),
+                .offset = field.getOffset(.uniform),
+                .type = field_type,
+            });
+        }
+        std.mem.sort(Field, fields.items, {}, struct {
+            fn lessThan(_: void, a: Field, b: Field) bool {
+                return a.offset < b.offset;
+            }
+        }.lessThan);
+
+        // Zig pads fields to their natural alignment, when the layout rules pack tighter than
+        // that every field gets `align(1)` instead
+        var alignment: usize = 1;
+        var packed_tighter = false;
+        for (fields.items) |field| {
+            alignment = @max(alignment, field.type.alignment);
+            if (field.offset % field.type.alignment != 0) packed_tighter = true;
+        }
+        if (size % alignment != 0) packed_tighter = true;
+        if (packed_tighter) alignment = 1;
+
+        var def: std.Io.Writer.Allocating = .init(self.arena);
+        const w = &def.writer;
+        try w.print("\npub const {s} = extern struct {{\n", .{placeholder.expr});
+        var cursor: usize = 0;
+        var pad_count: usize = 0;
+        for (fields.items) |field| {
+            if (field.offset < cursor) {
+                try w.print("    // `{s}` overlaps the previous field and was left out\n", .{field.name});
+                continue;
+            }
+            if (field.offset > cursor) {
+                try w.print("    _pad{d}: [{d}]u8 = @splat(0),\n", .{ pad_count, field.offset - cursor });
+                pad_count += 1;
+            }
+            const field_align = if (packed_tighter) " align(1)" else "";
+            try w.print("    {f}: {s}{s},\n", .{ std.zig.fmtId(field.name), field.type.expr, field_align });
+            cursor = field.offset + field.type.size;
+        }
+        if (size > cursor) {
+            try w.print("    _pad{d}: [{d}]u8 = @splat(0),\n", .{ pad_count, size - cursor });
+        }
+        try w.writeAll("\n    comptime {\n");
+        try w.print("        std.debug.assert(@sizeOf({s}) == {d});\n", .{ placeholder.expr, size });
+        for (fields.items) |field| {
+            try w.print("        std.debug.assert(@offsetOf({s}, \"{f}\") == {d});\n", .{ placeholder.expr, std.zig.fmtString(field.name), field.offset });
+        }
+        try w.writeAll("    }\n};\n");
+        try self.definitions.appendSlice(self.arena, def.written());
+
+        const result = Type{ .expr = placeholder.expr, .size = size, .alignment = alignment };
+        try self.structs.put(self.arena, name, result);
+        return result;
+    }
+};
+
+fn hasCategory(type_layout: *slang.TypeLayoutReflection, category: slang.ParameterCategory) bool {
+    for (0..type_layout.getCategoryCount()) |index| {
+        if (type_layout.getCategoryByIndex(@intCast(index)) == category) return true;
+    }
+    return false;
+}
+
+/// `size` is the size in the layout when known, bools for example take 4 bytes in most rules.
+fn scalarType(scalar: slang.ScalarType, size: ?usize) ?Type {
+    const expr: []const u8, const natural_size: usize = switch (scalar) {
+        .bool => if (size == 1) .{ "bool", 1 } else .{ "u32", 4 },
+        .int8 => .{ "i8", 1 },
+        .uint8 => .{ "u8", 1 },
+        .int16 => .{ "i16", 2 },
+        .uint16 => .{ "u16", 2 },
+        .float16 => .{ "f16", 2 },
+        .int32 => .{ "i32", 4 },
+        .uint32 => .{ "u32", 4 },
+        .float32 => .{ "f32", 4 },
+        .int64 => .{ "i64", 8 },
+        .uint64 => .{ "u64", 8 },
+        .float64 => .{ "f64", 8 },
+        else => return null,
+    };
+    if (size != null and size.? != natural_size) return null;
+    return Type{ .expr = expr, .size = natural_size, .alignment = natural_size };
+}
+
+test "generated layouts" {
+    const bindings = @import("bindgen_fixture");
+
+    var global_session = try slang.createGlobalSession(.{});
+    defer global_session.release();
+    var session = try global_session.borrow().createSession(.{
+        .targets = &.{.{ .format = .spirv, .profile = global_session.borrow().findProfile("spirv_1_5") }},
+    });
+    defer session.release();
+    var module = session.borrow().loadModuleFromSourceString("bindgen", "bindgen.slang", @embedFile("bindgen.slang"), null) orelse {
+        return error.ModuleLoadFailed;
+    };
+    defer module.release();
+    var entry_point = try module.borrow().findEntryPointByName("main");
+    defer entry_point.release();
+    const components = [_]*slang.IComponentType{ @ptrCast(module.borrow()), @ptrCast(entry_point.borrow()) };
+    var program = try session.borrow().createCompositeComponentType(&components, null);
+    defer program.release();
+    var linked = try program.borrow().link(null);
+    defer linked.release();
+    const reflection = linked.borrow().getLayout(0, null) orelse return error.NoLayout;
+
+    const material = for (0..reflection.getParameterCount()) |index| {
+        const parameter = reflection.getParameterByIndex(@intCast(index));
+        if (std.mem.eql(u8, std.mem.span(parameter.getName()), "material")) break parameter;
+    } else return error.ParameterNotFound;
+    const uniforms = material.getTypeLayout().getElementTypeLayout();
+    try expectLayout(bindings.material.Uniforms, uniforms);
+
+    const lights = uniforms.getFieldByIndex(@intCast(uniforms.findFieldIndexByName("lights")));
+    const Light = @typeInfo(@FieldType(bindings.material.Uniforms, "lights")).array.child;
+    try expectLayout(Light, lights.getTypeLayout().getElementTypeLayout());
+}
+
+/// Every field of `type_layout` has to be at the same offset and take the same size in `T`.
+fn expectLayout(comptime T: type, type_layout: *slang.TypeLayoutReflection) !void {
+    try std.testing.expectEqual(type_layout.getSize(.uniform), @sizeOf(T));
+    for (0..type_layout.getFieldCount()) |index| {
+        const field = type_layout.getFieldByIndex(@intCast(index));
+        const name = std.mem.span(field.getName());
+        var found = false;
+        inline for (@typeInfo(T).@"struct".fields) |zig_field| {
+            if (std.mem.eql(u8, zig_field.name, name)) {
+                try std.testing.expectEqual(field.getOffset(.uniform), @offsetOf(T, zig_field.name));
+                try std.testing.expectEqual(field.getTypeLayout().getSize(.uniform), @sizeOf(zig_field.type));
+                found = true;
+            }
+        }
+        if (!found) return error.MissingField;
+    }
+}
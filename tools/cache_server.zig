@@ -0,0 +1,81 @@
+//! The reference server of the remote compile cache, see `slang.RemoteCacheServer`.
+//!
+//! Usage: cache_server [options] <socket path>
+//!
+//!   -max-size <MiB>   Stop storing new entries past this size, the default is 1024.
+//!
+//! Every connection is served by a thread of its own. The entries are kept in memory and are lost
+//! when the server exits.
+
+const std = @import("std");
+const slang = @import("slang");
+
+const fatal = std.process.fatal;
+const log = std.log.scoped(.cache_server);
+
+pub fn main() !void {
+    var gpa_state: std.heap.DebugAllocator(.{}) = .init;
+    defer _ = gpa_state.deinit();
+    const gpa = gpa_state.allocator();
+
+    const args = try std.process.argsAlloc(gpa);
+    defer std.process.argsFree(gpa, args);
+
+    var socket_path: ?[]const u8 = null;
+    var max_size_mib: usize = 1024;
+    var i: usize = 1;
+    while (i < args.len) : (i += 1) {
+        const arg = args[i];
+        if (std.mem.eql(u8, arg, "-max-size")) {
+            i += 1;
+            if (i == args.len) fatal("missing value after -max-size", .{});
+            max_size_mib = std.fmt.parseInt(usize, args[i], 10) catch fatal("invalid size '{s}'", .{args[i]});
+        } else if (socket_path == null and !std.mem.startsWith(u8, arg, "-")) {
+            socket_path = arg;
+        } else {
+            fatal("unexpected argument '{s}'", .{arg});
+        }
+    }
+    const path = socket_path orelse fatal("no socket path", .{});
+
+    // A socket left behind by an earlier run would make the bind fail. Anything else at that path
+    // is most likely a typo and is left alone.
+    if (std.fs.cwd().statFile(path)) |stat| {
+        if (stat.kind != .unix_domain_socket) fatal("'{s}' exists and is not a socket", .{path});
+        std.fs.cwd().deleteFile(path) catch |err| {
+            fatal("unable to remove '{s}': {s}", .{ path, @errorName(err) });
+        };
+    } else |err| switch (err) {
+        error.FileNotFound => {},
+        else => fatal("unable to access '{s}': {s}", .{ path, @errorName(err) }),
+    }
+    const address = std.net.Address.initUnix(path) catch |err| {
+        fatal("invalid socket path '{s}': {s}", .{ path, @errorName(err) });
+    };
+    var listener = address.listen(.{}) catch |err| {
+        fatal("unable to listen on '{s}': {s}", .{ path, @errorName(err) });
+    };
+    defer listener.deinit();
+
+    var server = slang.RemoteCacheServer.init(gpa, max_size_mib * 1024 * 1024);
+    defer server.deinit();
+    log.info("listening on '{s}'", .{path});
+
+    while (true) {
+        const connection = listener.accept() catch |err| {
+            log.err("accept failed: {s}", .{@errorName(err)});
+            continue;
+        };
+        const thread = std.Thread.spawn(.{}, serve, .{ &server, connection.stream }) catch |err| {
+            log.err("unable to start a connection thread: {s}", .{@errorName(err)});
+            connection.stream.close();
+            continue;
+        };
+        thread.detach();
+    }
+}
+
+fn serve(server: *slang.RemoteCacheServer, stream: std.net.Stream) void {
+    defer stream.close();
+    server.serve(stream) catch |err| log.warn("connection closed: {s}", .{@errorName(err)});
+}
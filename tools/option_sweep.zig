@@ -0,0 +1,302 @@
+//! Relinks a program with every combination of a few compiler options and reports what each
+//! combination costs in compile time and produces in code size.
+//!
+//! Usage: option_sweep [options] <input> [slang arguments...]
+//!
+//! The slang arguments go through `IGlobalSession.parseCommandLineArguments` and pick the targets,
+//! every target of the session is measured. The program is made of the module and all of its
+//! entry points, it is loaded once and relinked with `linkWithOptions` for every combination of
+//!   - the optimization level
+//!   - `minimum_slang_optimization` off and on
+//!   - `loop_inversion` off and on
+//!   - SPIR-V emitted directly and through GLSL, only when a target is SPIR-V
+//!
+//!   -levels <list>   Comma separated optimization levels, the default is none,default,high,maximal.
+//!   -repeat <n>      Times every combination is measured, the median is reported. Default 3.
+//!   -no-glsl         Skip emitting SPIR-V through GLSL, which needs glslang.
+//!
+//! Every row has the time to link and to generate the code of all entry points, the size of the
+//! code, and for SPIR-V the number of instructions, functions and blocks, for text targets the
+//! number of lines. Rows marked with `*` are on the Pareto front of their target: no other
+//! combination is both faster to compile and produces smaller code.
+
+const std = @import("std");
+const slang = @import("slang");
+
+const fatal = std.process.fatal;
+
+const max_file_size = 256 * 1024 * 1024;
+
+const Config = struct {
+    level: slang.OptimizationLevel,
+    minimum_slang_optimization: bool,
+    loop_inversion: bool,
+    spirv_via_glsl: bool,
+
+    fn entries(config: Config) [4]slang.CompilerOptionEntry {
+        return .{
+            .optimization(config.level),
+            .minimum_slang_optimization(config.minimum_slang_optimization),
+            .loop_inversion(config.loop_inversion),
+            if (config.spirv_via_glsl) .emit_spirv_via_glsl(true) else .emit_spirv_directly(true),
+        };
+    }
+};
+
+const Row = struct {
+    config: Config,
+    target: usize,
+    link_ns: u64,
+    codegen_ns: u64,
+    stats: CodeStats,
+    pareto: bool = false,
+
+    fn compileNs(row: Row) u64 {
+        return row.link_ns + row.codegen_ns;
+    }
+};
+
+const CodeStats = struct {
+    bytes: usize = 0,
+    /// Instructions for SPIR-V, lines for text targets
+    instructions: usize = 0,
+    functions: usize = 0,
+    blocks: usize = 0,
+
+    fn add(stats: *CodeStats, other: CodeStats) void {
+        stats.bytes += other.bytes;
+        stats.instructions += other.instructions;
+        stats.functions += other.functions;
+        stats.blocks += other.blocks;
+    }
+};
+
+pub fn main() !void {
+    var arena_state = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    const args = try std.process.argsAlloc(arena);
+    var input: ?[:0]const u8 = null;
+    var levels: std.ArrayList(slang.OptimizationLevel) = .empty;
+    var repeat: usize = 3;
+    var glsl = true;
+    var slang_args: std.ArrayList([*:0]const u8) = .empty;
+
+    var i: usize = 1;
+    while (i < args.len) : (i += 1) {
+        const arg = args[i];
+        if (std.mem.eql(u8, arg, "-levels")) {
+            var it = std.mem.tokenizeScalar(u8, value(args, &i), ',');
+            while (it.next()) |name| {
+                try levels.append(arena, std.meta.stringToEnum(slang.OptimizationLevel, name) orelse {
+                    fatal("unknown optimization level '{s}'", .{name});
+                });
+            }
+        } else if (std.mem.eql(u8, arg, "-repeat")) {
+            const count = value(args, &i);
+            repeat = std.fmt.parseInt(usize, count, 10) catch fatal("invalid repeat count '{s}'", .{count});
+            if (repeat == 0) fatal("-repeat has to be at least 1", .{});
+        } else if (std.mem.eql(u8, arg, "-no-glsl")) {
+            glsl = false;
+        } else if (input == null and !std.mem.startsWith(u8, arg, "-")) {
+            input = arg;
+        } else {
+            try slang_args.append(arena, arg.ptr);
+        }
+    }
+    const input_path = input orelse fatal("no input file", .{});
+    if (levels.items.len == 0) try levels.appendSlice(arena, std.enums.values(slang.OptimizationLevel));
+
+    var global_session = try slang.createGlobalSession(.{});
+    defer global_session.release();
+    var parsed = try global_session.borrow().parseCommandLineArguments(slang_args.items);
+    defer parsed.deinit();
+    const targets = parsed.session_desc.targets;
+    if (targets.len == 0) fatal("no target, pass one with -target", .{});
+    var session = try global_session.borrow().createSession(parsed.session_desc);
+    defer session.release();
+
+    const source = std.fs.cwd().readFileAllocOptions(arena, input_path, max_file_size, null, .of(u8), 0) catch |err| {
+        fatal("unable to read '{s}': {s}", .{ input_path, @errorName(err) });
+    };
+    var module = session.borrow().loadModuleFromSource(input_path, input_path, source, null) orelse {
+        fatal("unable to load '{s}'", .{input_path});
+    };
+    defer module.release();
+
+    var components: std.ArrayList(*slang.IComponentType) = .empty;
+    try components.append(arena, @ptrCast(module.borrow()));
+    defer for (components.items[1..]) |component| component.release();
+    for (0..@intCast(module.borrow().getDefinedEntryPointCount())) |index| {
+        var entry_point = try module.borrow().getDefinedEntryPoint(@intCast(index));
+        try components.append(arena, @ptrCast(entry_point.leak()));
+    }
+    const entry_point_count = components.items.len - 1;
+    if (entry_point_count == 0) fatal("'{s}' has no entry points marked with [shader(...)]", .{input_path});
+    var program = try session.borrow().createCompositeComponentType(components.items, null);
+    defer program.release();
+
+    var has_spirv = false;
+    for (targets) |target| has_spirv = has_spirv or isSpirv(target.format);
+
+    var configs: std.ArrayList(Config) = .empty;
+    for (levels.items) |level| {
+        for ([_]bool{ false, true }) |minimum_slang_optimization| {
+            for ([_]bool{ false, true }) |loop_inversion| {
+                for ([_]bool{ false, true }) |spirv_via_glsl| {
+                    if (spirv_via_glsl and !(has_spirv and glsl)) continue;
+                    try configs.append(arena, .{
+                        .level = level,
+                        .minimum_slang_optimization = minimum_slang_optimization,
+                        .loop_inversion = loop_inversion,
+                        .spirv_via_glsl = spirv_via_glsl,
+                    });
+                }
+            }
+        }
+    }
+
+    var rows: std.ArrayList(Row) = .empty;
+    const link_times = try arena.alloc(u64, repeat);
+    const codegen_times = try arena.alloc([]u64, targets.len);
+    for (codegen_times) |*times| times.* = try arena.alloc(u64, repeat);
+    const stats = try arena.alloc(CodeStats, targets.len);
+
+    for (configs.items) |config| {
+        const entries = config.entries();
+        const failed = runs: for (0..repeat) |run| {
+            var timer = try std.time.Timer.start();
+            var linked = program.borrow().linkWithOptions(&entries, null) catch break :runs true;
+            defer linked.release();
+            link_times[run] = timer.read();
+
+            for (codegen_times, stats, 0..) |times, *target_stats, target| {
+                target_stats.* = .{};
+                timer.reset();
+                for (0..entry_point_count) |entry_point| {
+                    var code = linked.borrow().getEntryPointCode(@intCast(entry_point), @intCast(target), null) catch break :runs true;
+                    defer code.release();
+                    target_stats.add(codeStats(targets[target].format, code.borrow().getBuffer()));
+                }
+                times[run] = timer.read();
+            }
+        } else false;
+        if (failed) {
+            var name_buffer: [64]u8 = undefined;
+            std.log.warn("{s} failed", .{configName(&name_buffer, config)});
+            continue;
+        }
+
+        for (stats, codegen_times, 0..) |target_stats, times, target| {
+            try rows.append(arena, .{
+                .config = config,
+                .target = target,
+                .link_ns = median(link_times),
+                .codegen_ns = median(times),
+                .stats = target_stats,
+            });
+        }
+    }
+    markParetoFront(rows.items);
+
+    var stdout_buffer: [4096]u8 = undefined;
+    var stdout_writer = std.fs.File.stdout().writer(&stdout_buffer);
+    const stdout = &stdout_writer.interface;
+    for (targets, 0..) |target, target_index| {
+        try stdout.print("\n{t}, {d} entry points, median of {d}\n", .{ target.format, entry_point_count, repeat });
+        try stdout.print("  {s:<44} {s:>10} {s:>10} {s:>10} {s:>12} {s:>9} {s:>8}\n", .{
+            "options", "link", "codegen", "size", "instructions", "functions", "blocks",
+        });
+        for (rows.items) |row| {
+            if (row.target != target_index) continue;
+            var name_buffer: [64]u8 = undefined;
+            try stdout.print("{s} {s:<44} {D:>10} {D:>10} {Bi:>10.1} {d:>12} {d:>9} {d:>8}\n", .{
+                if (row.pareto) "*" else " ",
+                configName(&name_buffer, row.config),
+                row.link_ns,
+                row.codegen_ns,
+                row.stats.bytes,
+                row.stats.instructions,
+                row.stats.functions,
+                row.stats.blocks,
+            });
+        }
+    }
+    try stdout.flush();
+}
+
+fn markParetoFront(rows: []Row) void {
+    for (rows) |*row| {
+        row.pareto = for (rows) |other| {
+            if (other.target != row.target) continue;
+            const not_worse = other.compileNs() <= row.compileNs() and other.stats.bytes <= row.stats.bytes;
+            const better = other.compileNs() < row.compileNs() or other.stats.bytes < row.stats.bytes;
+            if (not_worse and better) break false;
+        } else true;
+    }
+}
+
+fn median(times: []u64) u64 {
+    std.sort.pdq(u64, times, {}, std.sort.asc(u64));
+    return times[times.len / 2];
+}
+
+fn isSpirv(format: slang.CompileTarget) bool {
+    return format == .spirv or format == .wgsl_spirv;
+}
+
+fn isText(format: slang.CompileTarget) bool {
+    return switch (format) {
+        .glsl, .hlsl, .spirv_asm, .dxil_asm, .dxbc_asm, .c_source, .cpp_source, .cuda_source, .metal, .wgsl, .wgsl_spirv_asm => true,
+        else => false,
+    };
+}
+
+fn codeStats(format: slang.CompileTarget, code: []const u8) CodeStats {
+    var stats = CodeStats{ .bytes = code.len };
+    if (isText(format)) {
+        stats.instructions = std.mem.count(u8, code, "\n");
+    } else if (isSpirv(format)) {
+        countSpirv(&stats, code);
+    }
+    return stats;
+}
+
+fn countSpirv(stats: *CodeStats, code: []const u8) void {
+    const header_words = 5;
+    const op_function = 54;
+    const op_label = 248;
+    const magic = 0x07230203;
+    if (code.len < header_words * 4 or code.len % 4 != 0) return;
+    if (std.mem.readInt(u32, code[0..4], .little) != magic) return;
+
+    var offset: usize = header_words * 4;
+    while (offset < code.len) {
+        const word = std.mem.readInt(u32, code[offset..][0..4], .little);
+        const word_count: usize = word >> 16;
+        if (word_count == 0) return;
+        stats.instructions += 1;
+        switch (word & 0xffff) {
+            op_function => stats.functions += 1,
+            op_label => stats.blocks += 1,
+            else => {},
+        }
+        offset += word_count * 4;
+    }
+}
+
+fn configName(buffer: *[64]u8, config: Config) []const u8 {
+    return std.fmt.bufPrint(buffer, "{t}{s}{s}{s}", .{
+        config.level,
+        if (config.minimum_slang_optimization) " min-opt" else "",
+        if (config.loop_inversion) " loop-inversion" else "",
+        if (config.spirv_via_glsl) " via-glsl" else "",
+    }) catch unreachable;
+}
+
+fn value(args: []const [:0]const u8, i: *usize) [:0]const u8 {
+    if (i.* + 1 == args.len) fatal("missing value for {s}", .{args[i.*]});
+    i.* += 1;
+    return args[i.*];
+}
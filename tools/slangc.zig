@@ -0,0 +1,530 @@
+//! A `slangc` compatible front end that compiles many inputs in parallel.
+//!
+//! Usage: slangc [options] <inputs...>
+//!
+//! Arguments of the form `@path` are replaced by the arguments read from the file at `path`.
+//! Inputs are recognized by their `.slang` or `.hlsl` extension. The options below are handled
+//! here, everything else is passed on to `IGlobalSession.parseCommandLineArguments`, which has
+//! to produce exactly one target.
+//!
+//!   -o <path>           Output file, only allowed with a single input. The default is the input
+//!                       path with the extension of the target.
+//!   -entry <name>       Entry point to compile, can be repeated. The default is every entry
+//!                       point marked with `[shader(...)]`.
+//!   -stage <stage>      Stage of the preceding `-entry`.
+//!   -depfile <path>     Write a Makefile style dependency file for all outputs.
+//!   -cache-dir <path>   Reuse the outputs of earlier runs with the same arguments, as long as
+//!                       none of the files they depend on changed.
+//!   -j <n>              Number of worker threads, the default is the number of cpus.
+//!
+//! Every worker creates its own global session, so the workers don't share any slang state.
+
+const std = @import("std");
+const slang = @import("slang");
+
+const fatal = std.process.fatal;
+const Blake3 = std.crypto.hash.Blake3;
+
+const max_file_size = 256 * 1024 * 1024;
+const max_response_file_depth = 16;
+
+const Options = struct {
+    inputs: std.ArrayList([:0]const u8) = .empty,
+    slang_args: std.ArrayList([*:0]const u8) = .empty,
+    entry_points: std.ArrayList(EntryPoint) = .empty,
+    output: ?[]const u8 = null,
+    depfile: ?[]const u8 = null,
+    cache_dir: ?[]const u8 = null,
+    jobs: ?usize = null,
+};
+
+const EntryPoint = struct {
+    name: [:0]const u8,
+    stage: ?slang.Stage = null,
+};
+
+const Job = struct {
+    input: [:0]const u8,
+    output: []const u8,
+    /// Every file the output was produced from, including the input. Allocated with the gpa.
+    dependencies: []const []const u8 = &.{},
+    status: Status = .pending,
+
+    const Status = enum { pending, cached, compiled, failed };
+};
+
+pub fn main() !void {
+    var gpa_state: std.heap.DebugAllocator(.{}) = .init;
+    defer _ = gpa_state.deinit();
+    const gpa = gpa_state.allocator();
+
+    var arena_state = std.heap.ArenaAllocator.init(gpa);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    const args = try std.process.argsAlloc(arena);
+    var expanded: std.ArrayList([:0]const u8) = .empty;
+    try expandResponseFiles(arena, args[1..], &expanded, 0);
+    const options = try parseArgs(arena, expanded.items);
+
+    if (options.inputs.items.len == 0) fatal("no input files", .{});
+    if (options.output != null and options.inputs.items.len != 1) {
+        fatal("-o can only be used with a single input, got {d}", .{options.inputs.items.len});
+    }
+
+    // Parsing the arguments on the main thread first reports bad arguments only once, the
+    // session is then used by the main thread as one of the workers
+    var main_worker = Worker.init(options.slang_args.items) catch |err| {
+        fatal("unable to create a session from the arguments: {s}", .{@errorName(err)});
+    };
+    defer main_worker.deinit();
+    const target = main_worker.parsed.session_desc.targets[0].format;
+
+    const jobs = try arena.alloc(Job, options.inputs.items.len);
+    for (jobs, options.inputs.items) |*job, input| {
+        job.* = Job{
+            .input = input,
+            .output = options.output orelse try outputPath(arena, input, target),
+        };
+    }
+    defer for (jobs) |job| freeDependencies(gpa, job.dependencies);
+
+    var compiler = Compiler{
+        .gpa = gpa,
+        .options = &options,
+        .jobs = jobs,
+    };
+    if (options.cache_dir) |cache_dir| {
+        compiler.cache = Cache.init(cache_dir, &options) catch |err| {
+            fatal("unable to open the cache directory '{s}': {s}", .{ cache_dir, @errorName(err) });
+        };
+    }
+    defer if (compiler.cache) |*cache| cache.dir.close();
+
+    const cpu_count = options.jobs orelse std.Thread.getCpuCount() catch 1;
+    const thread_count = @max(1, @min(cpu_count, jobs.len));
+    const threads = try arena.alloc(std.Thread, thread_count - 1);
+    var spawned: usize = 0;
+    for (threads) |*thread| {
+        thread.* = std.Thread.spawn(.{}, Compiler.spawnedWorker, .{&compiler}) catch break;
+        spawned += 1;
+    }
+    compiler.work(&main_worker);
+    for (threads[0..spawned]) |thread| thread.join();
+
+    var failed: usize = 0;
+    for (jobs) |job| {
+        switch (job.status) {
+            .cached, .compiled => {},
+            .pending, .failed => failed += 1,
+        }
+    }
+
+    if (options.depfile) |depfile| {
+        writeDepfile(depfile, jobs) catch |err| {
+            fatal("unable to write the depfile '{s}': {s}", .{ depfile, @errorName(err) });
+        };
+    }
+    if (failed != 0) fatal("{d} of {d} inputs failed to compile", .{ failed, jobs.len });
+}
+
+fn expandResponseFiles(arena: std.mem.Allocator, args: []const [:0]const u8, out: *std.ArrayList([:0]const u8), depth: usize) !void {
+    for (args) |arg| {
+        if (arg.len < 2 or arg[0] != '@') {
+            try out.append(arena, arg);
+            continue;
+        }
+
+        const path = arg[1..];
+        if (depth == max_response_file_depth) fatal("response files are nested too deeply at '{s}'", .{path});
+        const contents = std.fs.cwd().readFileAlloc(arena, path, max_file_size) catch |err| {
+            fatal("unable to read the response file '{s}': {s}", .{ path, @errorName(err) });
+        };
+
+        var iterator = try std.process.ArgIteratorGeneral(.{ .comments = true, .single_quotes = true }).init(arena, contents);
+        var nested: std.ArrayList([:0]const u8) = .empty;
+        while (iterator.next()) |nested_arg| try nested.append(arena, nested_arg);
+        try expandResponseFiles(arena, nested.items, out, depth + 1);
+    }
+}
+
+fn parseArgs(arena: std.mem.Allocator, args: []const [:0]const u8) !Options {
+    var options = Options{};
+    var i: usize = 0;
+    while (i < args.len) : (i += 1) {
+        const arg = args[i];
+        if (std.mem.eql(u8, arg, "-o")) {
+            options.output = value(args, &i);
+        } else if (std.mem.eql(u8, arg, "-entry")) {
+            try options.entry_points.append(arena, .{ .name = value(args, &i) });
+        } else if (std.mem.eql(u8, arg, "-stage")) {
+            const name = value(args, &i);
+            if (options.entry_points.items.len == 0) fatal("-stage has to follow an -entry", .{});
+            const stage: slang.Stage = if (std.mem.eql(u8, name, "pixel")) .fragment else std.meta.stringToEnum(slang.Stage, name) orelse {
+                fatal("unknown stage '{s}'", .{name});
+            };
+            options.entry_points.items[options.entry_points.items.len - 1].stage = stage;
+        } else if (std.mem.eql(u8, arg, "-depfile")) {
+            options.depfile = value(args, &i);
+        } else if (std.mem.eql(u8, arg, "-cache-dir")) {
+            options.cache_dir = value(args, &i);
+        } else if (std.mem.eql(u8, arg, "-j")) {
+            const count = value(args, &i);
+            options.jobs = std.fmt.parseInt(usize, count, 10) catch fatal("invalid job count '{s}'", .{count});
+        } else if (isInput(arg)) {
+            try options.inputs.append(arena, arg);
+        } else {
+            try options.slang_args.append(arena, arg.ptr);
+        }
+    }
+    return options;
+}
+
+fn value(args: []const [:0]const u8, i: *usize) [:0]const u8 {
+    if (i.* + 1 == args.len) fatal("missing value for {s}", .{args[i.*]});
+    i.* += 1;
+    return args[i.*];
+}
+
+fn isInput(arg: []const u8) bool {
+    if (std.mem.startsWith(u8, arg, "-")) return false;
+    const extension = std.fs.path.extension(arg);
+    return std.mem.eql(u8, extension, ".slang") or std.mem.eql(u8, extension, ".hlsl");
+}
+
+fn outputPath(arena: std.mem.Allocator, input: []const u8, target: slang.CompileTarget) ![]const u8 {
+    const extension = switch (target) {
+        .spirv, .wgsl_spirv => ".spv",
+        .spirv_asm, .wgsl_spirv_asm => ".spv.asm",
+        .dxil => ".dxil",
+        .dxil_asm => ".dxil.asm",
+        .dxbc => ".dxbc",
+        .dxbc_asm => ".dxbc.asm",
+        .hlsl => ".hlsl",
+        .glsl => ".glsl",
+        .metal => ".metal",
+        .metal_lib => ".metallib",
+        .wgsl => ".wgsl",
+        .c_source => ".c",
+        .cpp_source, .host_cpp_source => ".cpp",
+        .cuda_source => ".cu",
+        .ptx => ".ptx",
+        else => ".bin",
+    };
+    const stem = input[0 .. input.len - std.fs.path.extension(input).len];
+    return std.mem.concat(arena, u8, &.{ stem, extension });
+}
+
+const Worker = struct {
+    global_session: slang.Owned(slang.IGlobalSession),
+    parsed: slang.ParseCommandLineArgumentsResult,
+    session: slang.Owned(slang.ISession),
+
+    fn init(slang_args: []const [*:0]const u8) !Worker {
+        var global_session = try slang.createGlobalSession(.{});
+        errdefer global_session.release();
+
+        var parsed = try global_session.borrow().parseCommandLineArguments(slang_args);
+        errdefer parsed.deinit();
+        if (parsed.session_desc.targets.len != 1) {
+            std.log.err("expected exactly one -target, got {d}", .{parsed.session_desc.targets.len});
+            return error.InvalidTargetCount;
+        }
+
+        return Worker{
+            .global_session = global_session,
+            .parsed = parsed,
+            .session = try global_session.borrow().createSession(parsed.session_desc),
+        };
+    }
+
+    fn deinit(self: *Worker) void {
+        self.session.release();
+        self.parsed.deinit();
+        self.global_session.release();
+    }
+};
+
+const Compiler = struct {
+    gpa: std.mem.Allocator,
+    options: *const Options,
+    jobs: []Job,
+    next_job: std.atomic.Value(usize) = .init(0),
+    cache: ?Cache = null,
+
+    fn spawnedWorker(self: *Compiler) void {
+        // Jobs that are left over when every worker fails are reported as failed by main
+        var worker = Worker.init(self.options.slang_args.items) catch |err| {
+            std.log.err("unable to create a session for a worker: {s}", .{@errorName(err)});
+            return;
+        };
+        defer worker.deinit();
+        self.work(&worker);
+    }
+
+    fn work(self: *Compiler, worker: *Worker) void {
+        while (true) {
+            const index = self.next_job.fetchAdd(1, .monotonic);
+            if (index >= self.jobs.len) return;
+
+            const job = &self.jobs[index];
+            job.status = self.run(worker, job) catch |err| blk: {
+                std.log.err("{s}: {s}", .{ job.input, @errorName(err) });
+                break :blk .failed;
+            };
+        }
+    }
+
+    fn run(self: *Compiler, worker: *Worker, job: *Job) !Job.Status {
+        const key = if (self.cache) |cache| cache.manifestKey(job.input) else undefined;
+        if (self.cache) |cache| {
+            if (try cache.lookup(self.gpa, key, job)) |code| {
+                defer self.gpa.free(code);
+                try writeOutput(job.output, code);
+                return .cached;
+            }
+        }
+
+        const source = try std.fs.cwd().readFileAllocOptions(self.gpa, job.input, max_file_size, null, .of(u8), 0);
+        defer self.gpa.free(source);
+
+        var module = worker.session.borrow().loadModuleFromSource(job.input, job.input, source, null) orelse return error.ModuleLoadFailed;
+        defer module.release();
+
+        var components: std.ArrayList(*slang.IComponentType) = .empty;
+        try components.append(self.gpa, @ptrCast(module.borrow()));
+        defer {
+            for (components.items[1..]) |component| component.release();
+            components.deinit(self.gpa);
+        }
+
+        if (self.options.entry_points.items.len == 0) {
+            const count = module.borrow().getDefinedEntryPointCount();
+            for (0..@intCast(count)) |i| {
+                try components.ensureUnusedCapacity(self.gpa, 1);
+                var entry_point = try module.borrow().getDefinedEntryPoint(@intCast(i));
+                components.appendAssumeCapacity(@ptrCast(entry_point.leak()));
+            }
+        } else for (self.options.entry_points.items) |desc| {
+            try components.ensureUnusedCapacity(self.gpa, 1);
+            var entry_point = if (desc.stage) |stage|
+                try module.borrow().findAndCheckEntryPoint(desc.name, stage, null)
+            else
+                try module.borrow().findEntryPointByName(desc.name);
+            components.appendAssumeCapacity(@ptrCast(entry_point.leak()));
+        }
+
+        var program = try worker.session.borrow().createCompositeComponentType(components.items, null);
+        defer program.release();
+        var linked_program = try program.borrow().link(null);
+        defer linked_program.release();
+        var code = try linked_program.borrow().getTargetCode(0, null);
+        defer code.release();
+
+        var dependencies: std.ArrayList([]const u8) = .empty;
+        defer freeDependencyList(self.gpa, &dependencies);
+        for (0..@intCast(module.borrow().getDependencyFileCount())) |i| {
+            const path = std.mem.span(module.borrow().getDependencyFilePath(@intCast(i)));
+            try dependencies.ensureUnusedCapacity(self.gpa, 1);
+            dependencies.appendAssumeCapacity(try self.gpa.dupe(u8, path));
+        }
+        job.dependencies = try dependencies.toOwnedSlice(self.gpa);
+
+        try writeOutput(job.output, code.borrow().getBuffer());
+        if (self.cache) |cache| {
+            cache.store(self.gpa, key, job.dependencies, code.borrow().getBuffer()) catch |err| {
+                std.log.warn("{s}: unable to store the output in the cache: {s}", .{ job.input, @errorName(err) });
+            };
+        }
+        return .compiled;
+    }
+};
+
+/// Outputs are stored under a key that covers the compiler version, the arguments and the
+/// contents of every dependency. The dependencies are only known after compiling, so the
+/// lookup goes through a manifest keyed by the arguments and the input path alone, which lists
+/// the dependencies with the hashes of their contents:
+///
+///   manifests/<key>   "<object key>\n" followed by "<content hash> <path>\n" per dependency
+///   objects/<key>     the compiled code
+const Cache = struct {
+    dir: std.fs.Dir,
+    /// Hash of everything that is the same for all inputs of this run
+    base: Blake3,
+
+    const Key = [Blake3.digest_length]u8;
+    const KeyHex = [2 * Blake3.digest_length]u8;
+
+    fn init(path: []const u8, options: *const Options) !Cache {
+        var dir = try std.fs.cwd().makeOpenPath(path, .{});
+        errdefer dir.close();
+        try dir.makePath("manifests");
+        try dir.makePath("objects");
+
+        var base = Blake3.init(.{});
+        hashString(&base, std.mem.span(slang.getBuildTagString()));
+        hashLength(&base, options.slang_args.items.len);
+        for (options.slang_args.items) |arg| hashString(&base, std.mem.span(arg));
+        hashLength(&base, options.entry_points.items.len);
+        for (options.entry_points.items) |entry_point| {
+            hashString(&base, entry_point.name);
+            const stage: i32 = if (entry_point.stage) |stage| @intFromEnum(stage) else -1;
+            base.update(std.mem.asBytes(&stage));
+        }
+        return Cache{ .dir = dir, .base = base };
+    }
+
+    fn manifestKey(self: Cache, input: []const u8) Key {
+        var hasher = self.base;
+        hashString(&hasher, input);
+        var key: Key = undefined;
+        hasher.final(&key);
+        return key;
+    }
+
+    /// Returns the cached code and sets the dependencies of `job`, or returns null when the
+    /// input was never compiled with these arguments or one of its dependencies changed.
+    fn lookup(self: Cache, gpa: std.mem.Allocator, key: Key, job: *Job) !?[]u8 {
+        var path_buffer: [16 + @sizeOf(KeyHex)]u8 = undefined;
+        const manifest = self.dir.readFileAlloc(gpa, try manifestPath(&path_buffer, key), max_file_size) catch |err| switch (err) {
+            error.FileNotFound => return null,
+            else => |e| return e,
+        };
+        defer gpa.free(manifest);
+
+        var lines = std.mem.splitScalar(u8, manifest, '\n');
+        const object_hex = lines.first();
+        if (object_hex.len != @sizeOf(KeyHex)) return null;
+
+        var dependencies: std.ArrayList([]const u8) = .empty;
+        defer freeDependencyList(gpa, &dependencies);
+
+        while (lines.next()) |line| {
+            if (line.len == 0) continue;
+            if (line.len <= @sizeOf(KeyHex) + 1) return null;
+            const path = line[@sizeOf(KeyHex) + 1 ..];
+            const content_hash = hashFile(path) catch |err| switch (err) {
+                error.FileNotFound => return null,
+                else => |e| return e,
+            };
+            if (!std.mem.eql(u8, line[0..@sizeOf(KeyHex)], &std.fmt.bytesToHex(content_hash, .lower))) return null;
+            try dependencies.ensureUnusedCapacity(gpa, 1);
+            dependencies.appendAssumeCapacity(try gpa.dupe(u8, path));
+        }
+
+        const object_path = try std.fmt.bufPrint(&path_buffer, "objects/{s}", .{object_hex});
+        const code = self.dir.readFileAlloc(gpa, object_path, max_file_size) catch |err| switch (err) {
+            error.FileNotFound => return null,
+            else => |e| return e,
+        };
+        job.dependencies = try dependencies.toOwnedSlice(gpa);
+        return code;
+    }
+
+    fn store(self: Cache, gpa: std.mem.Allocator, key: Key, dependencies: []const []const u8, code: []const u8) !void {
+        var object_hasher = Blake3.init(.{});
+        object_hasher.update(&key);
+
+        var manifest: std.Io.Writer.Allocating = .init(gpa);
+        defer manifest.deinit();
+        try manifest.writer.writeAll("0" ** @sizeOf(KeyHex) ++ "\n");
+        for (dependencies) |path| {
+            const content_hash = try hashFile(path);
+            object_hasher.update(&content_hash);
+            try manifest.writer.print("{s} {s}\n", .{ &std.fmt.bytesToHex(content_hash, .lower), path });
+        }
+
+        var object_key: Key = undefined;
+        object_hasher.final(&object_key);
+        const object_hex = std.fmt.bytesToHex(object_key, .lower);
+        @memcpy(manifest.written()[0..@sizeOf(KeyHex)], &object_hex);
+
+        // The object goes first, so a manifest never points to a missing object
+        var path_buffer: [16 + @sizeOf(KeyHex)]u8 = undefined;
+        try writeAtomic(self.dir, try std.fmt.bufPrint(&path_buffer, "objects/{s}", .{&object_hex}), code);
+        try writeAtomic(self.dir, try manifestPath(&path_buffer, key), manifest.written());
+    }
+
+    fn manifestPath(buffer: []u8, key: Key) ![]const u8 {
+        return std.fmt.bufPrint(buffer, "manifests/{s}", .{&std.fmt.bytesToHex(key, .lower)});
+    }
+};
+
+fn hashFile(path: []const u8) !Cache.Key {
+    const file = try std.fs.cwd().openFile(path, .{});
+    defer file.close();
+
+    var hasher = Blake3.init(.{});
+    var buffer: [64 * 1024]u8 = undefined;
+    while (true) {
+        const len = try file.read(&buffer);
+        if (len == 0) break;
+        hasher.update(buffer[0..len]);
+    }
+    var hash: Cache.Key = undefined;
+    hasher.final(&hash);
+    return hash;
+}
+
+fn hashLength(hasher: *Blake3, len: usize) void {
+    hasher.update(std.mem.asBytes(&@as(u64, len)));
+}
+
+fn hashString(hasher: *Blake3, string: []const u8) void {
+    hashLength(hasher, string.len);
+    hasher.update(string);
+}
+
+fn writeOutput(path: []const u8, code: []const u8) !void {
+    return writeAtomic(std.fs.cwd(), path, code);
+}
+
+/// Writes through a temporary file, so readers never see a partially written file.
+fn writeAtomic(dir: std.fs.Dir, path: []const u8, data: []const u8) !void {
+    var buffer: [4096]u8 = undefined;
+    var file = try dir.atomicFile(path, .{ .write_buffer = &buffer });
+    defer file.deinit();
+    try file.file_writer.interface.writeAll(data);
+    try file.finish();
+}
+
+fn freeDependencies(gpa: std.mem.Allocator, dependencies: []const []const u8) void {
+    for (dependencies) |path| gpa.free(path);
+    gpa.free(dependencies);
+}
+
+/// Frees whatever is left in the list, which is nothing once it was moved out with `toOwnedSlice`.
+fn freeDependencyList(gpa: std.mem.Allocator, dependencies: *std.ArrayList([]const u8)) void {
+    for (dependencies.items) |path| gpa.free(path);
+    dependencies.deinit(gpa);
+}
+
+fn writeDepfile(path: []const u8, jobs: []const Job) !void {
+    var file = try std.fs.cwd().createFile(path, .{});
+    defer file.close();
+
+    var buffer: [4096]u8 = undefined;
+    var file_writer = file.writer(&buffer);
+    const writer = &file_writer.interface;
+    for (jobs) |job| {
+        try writeDepfilePath(writer, job.output);
+        try writer.writeAll(":");
+        for (job.dependencies) |dependency| {
+            try writer.writeAll(" \\\n  ");
+            try writeDepfilePath(writer, dependency);
+        }
+        try writer.writeAll("\n");
+    }
+    try writer.flush();
+}
+
+fn writeDepfilePath(writer: *std.Io.Writer, path: []const u8) !void {
+    for (path) |c| {
+        switch (c) {
+            ' ', '#' => try writer.writeByte('\\'),
+            '$' => try writer.writeByte('$'),
+            else => {},
+        }
+        try writer.writeByte(c);
+    }
+}